@@ -3,4 +3,13 @@
 #include "HoopSnake.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogHoopSnake);
+
+LLM_DEFINE_TAG(HoopSnake);
+LLM_DEFINE_TAG(HoopSnake_Snakes);
+LLM_DEFINE_TAG(HoopSnake_Victims);
+LLM_DEFINE_TAG(HoopSnake_BiteConstraints);
+LLM_DEFINE_TAG(HoopSnake_SnakeAudio);
+LLM_DEFINE_TAG(HoopSnake_SnakeEffects);
+
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, HoopSnake, "HoopSnake" );
@@ -3,4 +3,16 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "HAL/LowLevelMemTracker.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogHoopSnake, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("HoopSnake"), STATGROUP_HoopSnake, STATCAT_Advanced);
+
+// Low level memory tracker tags, shown under HoopSnake with -llm. Assets streamed in asynchronously are tracked by the loader, not these.
+LLM_DECLARE_TAG_API(HoopSnake_Snakes, HOOPSNAKE_API);
+LLM_DECLARE_TAG_API(HoopSnake_Victims, HOOPSNAKE_API);
+LLM_DECLARE_TAG_API(HoopSnake_BiteConstraints, HOOPSNAKE_API);
+LLM_DECLARE_TAG_API(HoopSnake_SnakeAudio, HOOPSNAKE_API);
+LLM_DECLARE_TAG_API(HoopSnake_SnakeEffects, HOOPSNAKE_API);
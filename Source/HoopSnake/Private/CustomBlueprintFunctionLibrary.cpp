@@ -2,10 +2,154 @@
 
 
 #include "CustomBlueprintFunctionLibrary.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "Physics/PhysicsInterfaceCore.h"
+#include "Engine/World.h"
+#include "HoopSnake.h"
+
+DECLARE_CYCLE_STAT(TEXT("Change Physics Bodies"), STAT_ChangePhysicsBodies, STATGROUP_HoopSnake);
+
+namespace CustomBlueprintFunctionLibrary
+{
+	/** Run a function with the mesh's physics scene write locked, so the per body calls inside it don't each take the lock themselves */
+	static void ExecuteWrite(USkeletalMeshComponent* SkeletalMesh, TFunctionRef<void()> Func)
+	{
+		UWorld* World = SkeletalMesh->GetWorld();
+		FPhysScene* Scene = World ? World->GetPhysicsScene() : nullptr;
+		if (!Scene || !FPhysicsCommand::ExecuteWrite(Scene, Func))
+		{
+			Func();
+		}
+	}
+
+	/** Set the collision on every shape of a body, updating its filter data once at the end rather than once per shape. Assumes the scene is locked. */
+	static void SetBodyCollision_AssumesLocked(FBodyInstance* Body, ECollisionEnabled::Type CollisionType, TArray<FPhysicsShapeHandle>& Shapes)
+	{
+		Shapes.Reset();
+		const int32 NumShapes = Body->GetAllShapes_AssumesLocked(Shapes);
+		for (int32 ShapeIndex = 0; ShapeIndex < NumShapes; ++ShapeIndex)
+		{
+			Body->SetShapeCollisionEnabled(ShapeIndex, CollisionType, false);
+		}
+		Body->UpdatePhysicsFilterData();
+	}
+
+	/** Apply the collision and blend weight parts of a change to a body. Assumes the scene is locked. */
+	static void ApplyBodyChanges_AssumesLocked(FBodyInstance* Body, const FPhysicsBodyChanges& Changes, TArray<FPhysicsShapeHandle>& Shapes)
+	{
+		if (Changes.bChangeCollision)
+		{
+			SetBodyCollision_AssumesLocked(Body, Changes.Collision, Shapes);
+		}
+
+		if (Changes.bChangePhysicsBlendWeight)
+		{
+			Body->PhysicsBlendWeight = Changes.PhysicsBlendWeight;
+		}
+	}
+}
 
 void UCustomBlueprintFunctionLibrary::ChangeCollisionOnPhysicsBody(USkeletalMeshComponent* skeletalMesh, FName boneName, ECollisionEnabled::Type CollisionType)
 {
-	skeletalMesh->GetBodyInstance(boneName)->SetShapeCollisionEnabled(0, CollisionType);
+	if (!skeletalMesh)
+	{
+		return;
+	}
+
+	if (FBodyInstance* Body = skeletalMesh->GetBodyInstance(boneName))
+	{
+		Body->SetShapeCollisionEnabled(0, CollisionType);
+	}
+}
+
+int32 UCustomBlueprintFunctionLibrary::ChangeCollisionOnPhysicsBodies(USkeletalMeshComponent* SkeletalMesh, const TArray<FName>& BoneNames, ECollisionEnabled::Type CollisionType)
+{
+	FPhysicsBodyChanges Changes;
+	Changes.bChangeCollision = true;
+	Changes.Collision = CollisionType;
+	return ChangePhysicsBodies(SkeletalMesh, BoneNames, Changes);
+}
+
+int32 UCustomBlueprintFunctionLibrary::ChangePhysicsBodies(USkeletalMeshComponent* SkeletalMesh, const TArray<FName>& BoneNames, const FPhysicsBodyChanges& Changes)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ChangePhysicsBodies);
+
+	if (!SkeletalMesh)
+	{
+		return 0;
+	}
+
+	// Find the bodies before locking, missing bones are skipped.
+	TArray<FBodyInstance*, TInlineAllocator<32>> Bodies;
+	for (const FName& BoneName : BoneNames)
+	{
+		if (FBodyInstance* Body = SkeletalMesh->GetBodyInstance(BoneName))
+		{
+			Bodies.Add(Body);
+		}
+	}
+
+	if (Bodies.IsEmpty())
+	{
+		return 0;
+	}
+
+	CustomBlueprintFunctionLibrary::ExecuteWrite(SkeletalMesh, [&Bodies, &Changes]()
+	{
+		TArray<FPhysicsShapeHandle> Shapes;
+		for (FBodyInstance* Body : Bodies)
+		{
+			CustomBlueprintFunctionLibrary::ApplyBodyChanges_AssumesLocked(Body, Changes, Shapes);
+
+			if (Changes.bChangeSimulatePhysics)
+			{
+				Body->SetInstanceSimulatePhysics(Changes.bSimulatePhysics, false, true);
+			}
+		}
+	});
+
+	// Per body blend weights are ignored while the whole mesh is blending, same as when the engine sets them.
+	if (Changes.bChangePhysicsBlendWeight)
+	{
+		SkeletalMesh->bBlendPhysics = false;
+	}
+
+	return Bodies.Num();
+}
+
+int32 UCustomBlueprintFunctionLibrary::ChangePhysicsBodiesBelow(USkeletalMeshComponent* SkeletalMesh, FName BoneName, const FPhysicsBodyChanges& Changes, bool bIncludeSelf)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ChangePhysicsBodies);
+
+	if (!SkeletalMesh)
+	{
+		return 0;
+	}
+
+	int32 NumBodies = 0;
+	CustomBlueprintFunctionLibrary::ExecuteWrite(SkeletalMesh, [SkeletalMesh, BoneName, &Changes, bIncludeSelf, &NumBodies]()
+	{
+		TArray<FPhysicsShapeHandle> Shapes;
+		NumBodies = SkeletalMesh->ForEachBodyBelow(BoneName, bIncludeSelf, false, [&Changes, &Shapes](FBodyInstance* Body)
+		{
+			CustomBlueprintFunctionLibrary::ApplyBodyChanges_AssumesLocked(Body, Changes, Shapes);
+		});
+
+		// The mesh's own version also keeps its end of physics update registered to match.
+		if (NumBodies > 0 && Changes.bChangeSimulatePhysics)
+		{
+			SkeletalMesh->SetAllBodiesBelowSimulatePhysics(BoneName, Changes.bSimulatePhysics, bIncludeSelf);
+		}
+	});
+
+	if (NumBodies > 0 && Changes.bChangePhysicsBlendWeight)
+	{
+		SkeletalMesh->bBlendPhysics = false;
+	}
+
+	return NumBodies;
 }
 
 FVector UCustomBlueprintFunctionLibrary::GetConstraintReferencePosition(EConstraintFrame::Type Frame, UPhysicsConstraintComponent* Constraint)
@@ -18,4 +162,93 @@ FVector UCustomBlueprintFunctionLibrary::GetConstraintReferencePosition(EConstra
 	{
 		return Constraint->ConstraintInstance.Pos2;
 	}
-}
\ No newline at end of file
+}
+
+void UCustomBlueprintFunctionLibrary::BenchmarkPhysicsBodyChanges(USkeletalMeshComponent* SkeletalMesh, int32 Iterations)
+{
+	if (!SkeletalMesh || SkeletalMesh->Bodies.IsEmpty() || Iterations <= 0)
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Physics body benchmark needs a mesh with bodies and at least one iteration."));
+		return;
+	}
+
+	TArray<FName> BoneNames;
+	for (const FBodyInstance* Body : SkeletalMesh->Bodies)
+	{
+		if (Body && Body->BodySetup.IsValid())
+		{
+			BoneNames.Add(Body->BodySetup->BoneName);
+		}
+	}
+
+	// Remember every shape's collision so the mesh can be put back exactly as it was.
+	TArray<TArray<ECollisionEnabled::Type>> SavedCollision;
+	int32 NumShapes = 0;
+	CustomBlueprintFunctionLibrary::ExecuteWrite(SkeletalMesh, [SkeletalMesh, &SavedCollision, &NumShapes]()
+	{
+		TArray<FPhysicsShapeHandle> Shapes;
+		for (FBodyInstance* Body : SkeletalMesh->Bodies)
+		{
+			TArray<ECollisionEnabled::Type>& BodyCollision = SavedCollision.AddDefaulted_GetRef();
+			if (!Body)
+			{
+				continue;
+			}
+
+			Shapes.Reset();
+			const int32 BodyShapes = Body->GetAllShapes_AssumesLocked(Shapes);
+			for (int32 ShapeIndex = 0; ShapeIndex < BodyShapes; ++ShapeIndex)
+			{
+				BodyCollision.Add(Body->GetShapeCollisionEnabled(ShapeIndex));
+			}
+			NumShapes += BodyShapes;
+		}
+	});
+
+	// Alternate between two states so every call has something to change.
+	auto CollisionFor = [](int32 Iteration) { return Iteration % 2 == 0 ? ECollisionEnabled::QueryOnly : ECollisionEnabled::QueryAndPhysics; };
+
+	// Both passes change every shape on every body. The per bone pass locks the scene and updates filter data once per bone, the batched pass once in total.
+	TArray<FName> SingleBone;
+	SingleBone.SetNum(1);
+
+	const double PerBoneStart = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		for (const FName& BoneName : BoneNames)
+		{
+			SingleBone[0] = BoneName;
+			ChangeCollisionOnPhysicsBodies(SkeletalMesh, SingleBone, CollisionFor(Iteration));
+		}
+	}
+	const double PerBoneSeconds = FPlatformTime::Seconds() - PerBoneStart;
+
+	const double BatchedStart = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		ChangeCollisionOnPhysicsBodies(SkeletalMesh, BoneNames, CollisionFor(Iteration));
+	}
+	const double BatchedSeconds = FPlatformTime::Seconds() - BatchedStart;
+
+	CustomBlueprintFunctionLibrary::ExecuteWrite(SkeletalMesh, [SkeletalMesh, &SavedCollision]()
+	{
+		for (int32 BodyIndex = 0; BodyIndex < SkeletalMesh->Bodies.Num(); ++BodyIndex)
+		{
+			FBodyInstance* Body = SkeletalMesh->Bodies[BodyIndex];
+			if (!Body || SavedCollision[BodyIndex].IsEmpty())
+			{
+				continue;
+			}
+
+			for (int32 ShapeIndex = 0; ShapeIndex < SavedCollision[BodyIndex].Num(); ++ShapeIndex)
+			{
+				Body->SetShapeCollisionEnabled(ShapeIndex, SavedCollision[BodyIndex][ShapeIndex], false);
+			}
+			Body->UpdatePhysicsFilterData();
+		}
+	});
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Physics body benchmark: %s, %d bodies, %d shapes, %d iterations"), *SkeletalMesh->GetName(), BoneNames.Num(), NumShapes, Iterations);
+	UE_LOG(LogHoopSnake, Display, TEXT("  Per bone: %.3f us/pass"), PerBoneSeconds * 1e6 / Iterations);
+	UE_LOG(LogHoopSnake, Display, TEXT("  Batched:  %.3f us/pass"), BatchedSeconds * 1e6 / Iterations);
+}
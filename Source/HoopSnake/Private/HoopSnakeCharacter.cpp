@@ -3,6 +3,14 @@
 
 #include "HoopSnakeCharacter.h"
 #include "GameFramework/SpringArmComponent.h"
+#include "SnakeCameraBoomComponent.h"
+#include "SnakeJawComponent.h"
+#include "SnakeMeshComponent.h"
+#include "SnakeMovementComponent.h"
+#include "SnakeTickSubsystem.h"
+#include "CustomBlueprintFunctionLibrary.h"
+#include "SnakeInputLatencyTracker.h"
+#include "SnakeKillcamRecorder.h"
 #include "Camera/CameraComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Engine/LocalPlayer.h"
@@ -21,10 +29,45 @@
 #include "Camera/CameraShakeSourceComponent.h"
 #include "NiagaraFunctionLibrary.h"
 #include "NiagaraComponent.h"
+#include "NiagaraSystem.h"
+#include "InputMappingContext.h"
+#include "InputAction.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+#include "Engine/StaticMesh.h"
+#include "SnakeArchetype.h"
+#include "MainGameInstance.h"
+#include "ProximityGridSubsystem.h"
+#include "SnakeAIController.h"
+#include "HoopSnake.h"
+#include "Misc/App.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Animation/AnimInstance.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "PhysicsEngine/ConstraintInstance.h"
+#include "Serialization/ArchiveCountMem.h"
+
+DECLARE_CYCLE_STAT(TEXT("Snake Prewarm"), STAT_SnakePrewarm, STATGROUP_HoopSnake);
+DECLARE_CYCLE_STAT(TEXT("Snake Toggle Hoop"), STAT_SnakeToggleHoop, STATGROUP_HoopSnake);
+DECLARE_CYCLE_STAT(TEXT("Snake Trigger Attack"), STAT_SnakeTriggerAttack, STATGROUP_HoopSnake);
+DECLARE_CYCLE_STAT(TEXT("Snake Attempt Bite"), STAT_SnakeAttemptBite, STATGROUP_HoopSnake);
+
+const FName AHoopSnakeCharacter::RagdollPoseName = TEXT("RagdollPose");
+
+static TAutoConsoleVariable<bool> CVarSnakeLowLatencyInput(
+	TEXT("hoopsnake.LowLatencyInput"),
+	false,
+	TEXT("Take the player's hoop action as soon as it starts, and attack straight away instead of waiting for the animation's attack window."));
+
+// Number of frames to watch for hitches after a mode transition
+static constexpr int32 TransitionWatchFrameCount = 3;
 
 // Sets default values
-AHoopSnakeCharacter::AHoopSnakeCharacter()
+AHoopSnakeCharacter::AHoopSnakeCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<USnakeMeshComponent>(ACharacter::MeshComponentName).SetDefaultSubobjectClass<USnakeMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
+	LLM_SCOPE_BYTAG(HoopSnake_Snakes);
+
  	// Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 
@@ -33,6 +76,9 @@ AHoopSnakeCharacter::AHoopSnakeCharacter()
 	bUseControllerRotationYaw = true;
 	bUseControllerRotationRoll = false;
 
+	// Snakes that aren't possessed by a player drive themselves.
+	AIControllerClass = ASnakeAIController::StaticClass();
+
 	// Speed values for character input
 	DefaultSpeed = 300.0f;
 	HoopSpeed = 1000.0f;
@@ -56,7 +102,7 @@ AHoopSnakeCharacter::AHoopSnakeCharacter()
 	GetCharacterMovement()->bOrientRotationToMovement = false;
 
 	// Create a camera boom (pulls in towards the player if there is a collision)
-	CameraBoom = CreateDefaultSubobject<USpringArmComponent>(TEXT("CameraBoom"));
+	CameraBoom = CreateDefaultSubobject<USnakeCameraBoomComponent>(TEXT("CameraBoom"));
 	CameraBoom->SetupAttachment(RootComponent);
 	CameraBoom->TargetArmLength = 100.0f; // The camera follows at this distance behind the character	
 	CameraBoom->bUsePawnControlRotation = true; // Rotate the arm based on the controller
@@ -74,17 +120,22 @@ AHoopSnakeCharacter::AHoopSnakeCharacter()
 	CameraShakeComponent = CreateDefaultSubobject<UCameraShakeSourceComponent>(TEXT("CameraShakeComponent"));
 	CameraShakeComponent->SetupAttachment(FollowCamera);
 
-	// Create niagara component for speed lines, ** NOTE: defaults set in blueprint
+	// Speed lines. The system comes from the archetype, and once started the instance stays resident, paused and hidden outside hoop mode.
 	SpeedLineEffect = CreateDefaultSubobject<UNiagaraComponent>(TEXT("SpeedLineEffect"));
 	SpeedLineEffect->SetupAttachment(GetCapsuleComponent());
+	SpeedLineEffect->bAutoActivate = false;
+	SpeedLineEffect->SetVisibility(false);
 
-	// Create head meshes. Mesh properties set in blueprint.
-	UpperJaw = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("UpperJaw"));
-	LowerJaw = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("LowerJaw"));
+	// Create head meshes. The meshes themselves come from the archetype.
+	UpperJaw = CreateDefaultSubobject<USnakeJawComponent>(TEXT("UpperJaw"));
+	LowerJaw = CreateDefaultSubobject<USnakeJawComponent>(TEXT("LowerJaw"));
+	LowerJaw->bLowerJaw = true;
 
-	// Attach head to mesh.
+	// Attach head to mesh. The head meshes are rotated 90 degrees in yaw to line up with the rope mesh's bones.
 	UpperJaw->SetupAttachment(GetMesh(), "HeadSocket");
 	LowerJaw->SetupAttachment(GetMesh(), "HeadSocket");
+	UpperJaw->SetRelativeRotation(FRotator(0.0f, 90.0f, 0.0f));
+	LowerJaw->SetRelativeRotation(FRotator(0.0f, 90.0f, 0.0f));
 
 	// Defaults
 	bHoopModeEnabled = false;
@@ -95,6 +146,9 @@ AHoopSnakeCharacter::AHoopSnakeCharacter()
 	RagdollMovementForce = 300.0f;
 	RagdollMovementThreshold = 10.0f;
 	HeadBoneName = "Bone"; // bone name from random rope mesh I found, update if a proper snake mesh is found
+
+	// The head body is kept as it is when the ragdoll is reduced, so bites and lunges behave the same.
+	GetSnakeMesh()->PreservedBoneName = HeadBoneName;
 	AttackForceForward = 2500.0f;
 	AttackForceUp = 2000.0f;
 	ResetDelay = 0.5f;
@@ -113,18 +167,79 @@ AHoopSnakeCharacter::AHoopSnakeCharacter()
 	CurrentTilt = 0.0f;
 	DesiredTilt = 0.0f;
 	TiltModifier = 300.0f;
+	bSteerInputPending = false;
+	SteerControlRotation = FRotator::ZeroRotator;
 	TiltInterpSpeed = 7.5f;
 
+	SpeedLineIntensityParameter = "SpeedIntensity";
+	SpeedLineFullSignificanceDistance = 1500.0f;
+	SpeedLineCullDistance = 6000.0f;
+	AppliedSpeedLineIntensity = 0.0f;
+	bSpeedLinesShown = false;
+
 	PreviousForward = FVector(0);
-	
+
+	CachedHeadSocketTransform = FTransform::Identity;
+	CachedHeadBoneLocation = FVector(0);
+
+	// The archetype every snake uses unless the blueprint picks another one.
+	ArchetypeId = FPrimaryAssetId(USnakeArchetype::PrimaryAssetType, TEXT("DA_HoopSnake"));
+	Archetype = nullptr;
+	ArchetypeRequestTime = 0.0;
+	bInputBound = false;
+	bUsingDefaultArchetype = false;
+	bCombatRequested = false;
+	bCombatLoaded = false;
+	BoundInputComponent = nullptr;
+
+	bPrewarmRequested = false;
+	bAssetsPrewarmed = false;
+	TimedTransition = NAME_None;
+	TransitionFramesToWatch = 0;
+	WorstTransitionFrameTime = 0.0f;
 }
 
 // Called when the game starts or when spawned
 void AHoopSnakeCharacter::BeginPlay()
 {
+	LLM_SCOPE_BYTAG(HoopSnake_Snakes);
+
 	Super::BeginPlay();
 	
 	GetMesh()->OnComponentHit.AddDynamic(this, &AHoopSnakeCharacter::OnMeshHit);
+
+	// Head bone may have been changed in blueprint.
+	GetSnakeMesh()->PreservedBoneName = HeadBoneName;
+
+	// Input, meshes and effects come from the archetype, which streams in rather than loading with the pawn.
+	LoadArchetype();
+
+	// Let victims and other systems find this snake without scanning the world.
+	if (UProximityGridSubsystem* ProximityGrid = GetWorld()->GetSubsystem<UProximityGridSubsystem>())
+	{
+		ProximityGrid->Register(this, EProximityKind::Snake);
+	}
+
+	// Per frame updates run batched with every other snake, unless batching is turned off.
+	if (USnakeTickSubsystem* SnakeTick = GetWorld()->GetSubsystem<USnakeTickSubsystem>())
+	{
+		SnakeTick->RegisterSnake(this);
+	}
+}
+
+void AHoopSnakeCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UProximityGridSubsystem* ProximityGrid = GetWorld()->GetSubsystem<UProximityGridSubsystem>())
+	{
+		ProximityGrid->Unregister(this);
+	}
+
+	if (USnakeTickSubsystem* SnakeTick = GetWorld()->GetSubsystem<USnakeTickSubsystem>())
+	{
+		SnakeTick->UnregisterSnake(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
@@ -132,33 +247,125 @@ void AHoopSnakeCharacter::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	// Update camera properties, including the boom arm it is attached to
-	UpdateCamera(DeltaTime);
+	// The same three steps the snake tick subsystem runs for every snake at once when batching is on.
+	FSnakeTickState State;
+	GatherTickState(State, DeltaTime);
+	State.Compute();
+	ApplyTickState(State);
+}
+
+void AHoopSnakeCharacter::NotifyControllerChanged()
+{
+	Super::NotifyControllerChanged();
+
+	if (USnakeTickSubsystem* SnakeTick = GetWorld()->GetSubsystem<USnakeTickSubsystem>())
+	{
+		SnakeTick->SetSnakeController(this, PreviousController, Controller);
+	}
+}
+
+void AHoopSnakeCharacter::GatherTickState(FSnakeTickState& State, float DeltaTime)
+{
+	// Report hitches caused by the last mode transition
+	UpdateTransitionTiming();
+
+	// Read the head's position once for the camera, capsule and noise below.
+	CacheHeadTransforms();
+
+	// Snakes away from every player's camera ragdoll with fewer bodies. The player's own snake always gets the full ragdoll.
+	GetSnakeMesh()->UpdatePhysicsLOD(IsPlayerControlled(), DeltaTime);
+
+	State.Snake = this;
+	State.DeltaTime = DeltaTime;
+	State.bHoopModeEnabled = bHoopModeEnabled;
+	State.bSimulatingPhysics = GetMesh()->IsSimulatingPhysics();
+	State.Forward = GetCapsuleComponent()->GetForwardVector();
+	State.PreviousForward = PreviousForward;
+	State.Velocity = GetCharacterMovement()->Velocity;
+
+	// Use bone velocity for speed if simulating physics, otherwise use character movement velocity.
+	State.Speed = State.bSimulatingPhysics ? GetMesh()->GetBoneLinearVelocity(HeadBoneName).Length() : State.Velocity.Length();
+	State.HoopSpeed = HoopSpeed;
+
+	State.DesiredTilt = DesiredTilt;
+	State.CurrentTilt = CurrentTilt;
+	State.TiltModifier = TiltModifier;
+	State.TiltInterpSpeed = TiltInterpSpeed;
+
+	// Only worth finding the cameras while there are speed lines to show.
+	State.SpeedLineSignificance = (bSpeedLinesShown && bHoopModeEnabled) ? GetSpeedLineSignificance() : 0.0f;
+
+	// Nobody looks through an AI snake's camera, so don't spend anything on it.
+	State.bUpdateCamera = IsPlayerControlled();
+	if (State.bUpdateCamera)
+	{
+		State.CameraTargets = GetCameraTargets();
+		State.CameraState = CameraBoom->GetCameraState(FollowCamera);
+		State.CameraInterpSpeed = CameraInterpSpeed;
+		State.CameraTolerance = CameraBoom->ConvergenceTolerance;
+	}
+}
+
+void AHoopSnakeCharacter::ApplyTickState(const FSnakeTickState& State)
+{
+	// Update camera properties, including the boom arm it is attached to. The boom skips writes once everything has settled.
+	if (State.bUpdateCamera)
+	{
+		CameraBoom->ApplyCameraState(State.CameraState, State.CameraTargets, FollowCamera, CachedHeadSocketTransform);
+	}
 
-	if (bHoopModeEnabled)
+	// A steer has only taken effect once it has actually turned the hoop, not just on the next tick in hoop mode.
+	if (bSteerInputPending && State.bHoopModeEnabled && (State.DesiredTilt != DesiredTilt || !GetControlRotation().Equals(SteerControlRotation)))
 	{
-		// Moves the character forward and applies tilt to the mesh.
-		ApplyHoopMovement(DeltaTime);
+		bSteerInputPending = false;
+		MarkInputEffect("Steer");
+	}
+
+	DesiredTilt = State.DesiredTilt;
+	CurrentTilt = State.CurrentTilt;
+
+	if (State.bHoopModeEnabled)
+	{
+		// Apply forward input every tick when in hoop mode, and tilt the mesh into turns.
+		AddMovementInput(State.Forward, 5.0f);
+		GetMesh()->SetRelativeRotation(FRotator(0.0f, 0.0f, CurrentTilt));
 	}
 	else
 	{
-		// No tilt when not in hoop mode.
-		CurrentTilt = 0;
+		bSteerInputPending = false;
 	}
 
-	// Updates some properties that are used by the animation blueprint.
-	UpdateAnimationProperties();
+	// Properties used by the animation blueprint.
+	RotateRate = State.RotateRate;
+	bIsRotating = State.bIsRotating;
+	bReverseSlither = State.bReverseSlither;
 
-	if (GetMesh()->IsSimulatingPhysics())
+	// Pose the jaw from the animation's jaw curve, or from the angle gameplay last asked for.
+	const UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance();
+	UpperJaw->UpdateJaw(AnimInstance);
+	LowerJaw->UpdateJaw(AnimInstance);
+
+	if (State.bSimulatingPhysics)
 	{
 		// Move capsule to where mesh is when ragdolling, but with no collision. Useful for AI tracking stuff that uses the character's root location (the capsule location).
-		GetCapsuleComponent()->SetWorldLocation(GetMesh()->GetSocketLocation(HeadBoneName));
+		GetCapsuleComponent()->SetWorldLocation(CachedHeadBoneLocation);
 		GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
 		GetCapsuleComponent()->SetCollisionResponseToChannel(ECollisionChannel::ECC_Pawn, ECollisionResponse::ECR_Ignore);
 	}
 
-	// Make noise if moving
-	MovementNoise();
+	// Only touch the effect's parameters when the intensity has visibly changed, or has just reached zero.
+	const bool bSpeedLinesChanged = !FMath::IsNearlyEqual(State.SpeedLineIntensity, AppliedSpeedLineIntensity, 0.01f) || (State.SpeedLineIntensity == 0.0f && AppliedSpeedLineIntensity != 0.0f);
+	if (bSpeedLinesShown && bSpeedLinesChanged)
+	{
+		SpeedLineEffect->SetVariableFloat(SpeedLineIntensityParameter, State.SpeedLineIntensity);
+		AppliedSpeedLineIntensity = State.SpeedLineIntensity;
+	}
+
+	// Make noise if moving, to alert AI controlled characters.
+	if (State.bMakeNoise)
+	{
+		MakeNoise(State.NoiseVolume, this, CachedHeadBoneLocation);
+	}
 
 	// Set previous forward for next tick.
 	PreviousForward = GetCapsuleComponent()->GetForwardVector();
@@ -169,38 +376,60 @@ void AHoopSnakeCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInput
 {
 	Super::SetupPlayerInputComponent(PlayerInputComponent);
 
+	// Actions are bound once the archetype holding them has loaded, which may be before or after this.
+	BoundInputComponent = PlayerInputComponent;
+	bInputBound = false;
+	BindInputActions();
+}
+
+void AHoopSnakeCharacter::BindInputActions()
+{
+	if (bInputBound || !Archetype || !BoundInputComponent)
+	{
+		return;
+	}
+
+	UInputMappingContext* MappingContext = Archetype->DefaultMappingContext.Get();
+	UInputAction* MoveInput = Archetype->MoveAction.Get();
+	UInputAction* LookInput = Archetype->LookAction.Get();
+	UInputAction* HoopInput = Archetype->HoopAction.Get();
+	UInputAction* ResetInput = Archetype->ResetAction.Get();
+	UInputAction* PauseInput = Archetype->PauseAction.Get();
+
 	// Add Input Mapping Context
 	if (APlayerController* PlayerController = Cast<APlayerController>(GetController()))
 	{
 		if (UEnhancedInputLocalPlayerSubsystem* Subsystem = ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(PlayerController->GetLocalPlayer()))
 		{
-			Subsystem->AddMappingContext(DefaultMappingContext, 0);
+			Subsystem->AddMappingContext(MappingContext, 0);
 		}
 	}
 
 	// Set up action bindings
-	if (UEnhancedInputComponent* EnhancedInputComponent = Cast<UEnhancedInputComponent>(PlayerInputComponent)) {
+	if (UEnhancedInputComponent* EnhancedInputComponent = Cast<UEnhancedInputComponent>(BoundInputComponent)) {
 
 		// Moving
-		EnhancedInputComponent->BindAction(MoveAction, ETriggerEvent::Triggered, this, &AHoopSnakeCharacter::Move);
+		EnhancedInputComponent->BindAction(MoveInput, ETriggerEvent::Triggered, this, &AHoopSnakeCharacter::Move);
 
 		// Looking
-		EnhancedInputComponent->BindAction(LookAction, ETriggerEvent::Triggered, this, &AHoopSnakeCharacter::Look);
+		EnhancedInputComponent->BindAction(LookInput, ETriggerEvent::Triggered, this, &AHoopSnakeCharacter::Look);
 
 		// Hoop toggle
-		EnhancedInputComponent->BindAction(HoopAction, ETriggerEvent::Triggered, this, &AHoopSnakeCharacter::ToggleHoop);
+		EnhancedInputComponent->BindAction(HoopInput, ETriggerEvent::Started, this, &AHoopSnakeCharacter::HoopActionStarted);
+		EnhancedInputComponent->BindAction(HoopInput, ETriggerEvent::Triggered, this, &AHoopSnakeCharacter::HoopActionTriggered);
 
 		// Reset
-		EnhancedInputComponent->BindAction(ResetAction, ETriggerEvent::Triggered, this, &AHoopSnakeCharacter::Reset);
+		EnhancedInputComponent->BindAction(ResetInput, ETriggerEvent::Triggered, this, &AHoopSnakeCharacter::Reset);
 
 		// Pause
-		EnhancedInputComponent->BindAction(PauseAction, ETriggerEvent::Triggered, this, &AHoopSnakeCharacter::Pause);
+		EnhancedInputComponent->BindAction(PauseInput, ETriggerEvent::Triggered, this, &AHoopSnakeCharacter::Pause);
+
+		bInputBound = true;
 	}
 	else
 	{
-		//UE_LOG(LogTemplateCharacter, Error, TEXT("'%s' Failed to find an Enhanced Input component! This template is built to use the Enhanced Input system. If you intend to use the legacy system, then you will need to update this C++ file."), *GetNameSafe(this));
+		UE_LOG(LogHoopSnake, Error, TEXT("'%s' Failed to find an Enhanced Input component! This template is built to use the Enhanced Input system. If you intend to use the legacy system, then you will need to update this C++ file."), *GetNameSafe(this));
 	}
-
 }
 
 void AHoopSnakeCharacter::Move(const FInputActionValue& Value)
@@ -251,11 +480,77 @@ void AHoopSnakeCharacter::Look(const FInputActionValue& Value)
 		// add yaw and pitch input to controller
 		AddControllerYawInput(LookAxisVector.X);
 		AddControllerPitchInput(LookAxisVector.Y);
+
+		// Looking steers the hoop
+		if (bHoopModeEnabled && !LookAxisVector.IsZero())
+		{
+			MarkInputHandled("Steer", true);
+
+			// Control rotation only picks the input up when the controller next updates, so compare against where it is now.
+			if (!bSteerInputPending)
+			{
+				bSteerInputPending = true;
+				SteerControlRotation = GetControlRotation();
+			}
+		}
+	}
+}
+
+void AHoopSnakeCharacter::HoopActionStarted(const FInputActionValue& Value)
+{
+	if (IsLowLatencyInput())
+	{
+		MarkInputHandled(bHoopModeEnabled ? FName("Attack") : FName("EnterHoop"));
+		ToggleHoop(Value);
+	}
+}
+
+void AHoopSnakeCharacter::HoopActionTriggered(const FInputActionValue& Value)
+{
+	// Already taken when the action started.
+	if (!IsLowLatencyInput())
+	{
+		MarkInputHandled(bHoopModeEnabled ? FName("Attack") : FName("EnterHoop"));
+		ToggleHoop(Value);
+	}
+}
+
+bool AHoopSnakeCharacter::IsLowLatencyInput() const
+{
+	return IsPlayerControlled() && CVarSnakeLowLatencyInput.GetValueOnGameThread();
+}
+
+void AHoopSnakeCharacter::MarkInputHandled(FName Action, bool bAxisInput) const
+{
+	if (!USnakeInputLatencyTracker::IsTracking() || !IsPlayerControlled())
+	{
+		return;
+	}
+
+	if (USnakeInputLatencyTracker* Tracker = GetWorld()->GetSubsystem<USnakeInputLatencyTracker>())
+	{
+		Tracker->MarkHandled(Action, bAxisInput);
+	}
+}
+
+void AHoopSnakeCharacter::MarkInputEffect(FName Action) const
+{
+	// AI snakes go through the same gameplay code, but never through the player's input.
+	if (!USnakeInputLatencyTracker::IsTracking() || !IsPlayerControlled())
+	{
+		return;
+	}
+
+	if (USnakeInputLatencyTracker* Tracker = GetWorld()->GetSubsystem<USnakeInputLatencyTracker>())
+	{
+		Tracker->MarkEffect(Action);
 	}
 }
 
 void AHoopSnakeCharacter::ToggleHoop(const FInputActionValue& Value)
 {
+	SCOPE_CYCLE_COUNTER(STAT_SnakeToggleHoop);
+
 	// Can only enter or exit hoop mode when not ragdolling
 	if (!GetMesh()->IsSimulatingPhysics())
 	{
@@ -265,6 +560,12 @@ void AHoopSnakeCharacter::ToggleHoop(const FInputActionValue& Value)
 			{
 				// Animation blueprint tracks this value, and sends a message to the snake via interface once the animation is within the correct frame range to attack.
 				bAttackQueued = true; 
+
+				// Low latency input doesn't wait for the animation.
+				if (IsLowLatencyInput())
+				{
+					Execute_TriggerAttack(this);
+				}
 			}
 		}
 		else // Enter hoop mode
@@ -272,27 +573,33 @@ void AHoopSnakeCharacter::ToggleHoop(const FInputActionValue& Value)
 			// Animation blueprint will use this to transition animation to hoop rolling.
 			bHoopModeEnabled = true; 
 
+			// An attack can only come out of hoop mode, so make sure the sounds and constraint it needs are on their way.
+			LoadArchetypeCombat();
+
 			// Adjust speed of character
 			GetCharacterMovement()->MaxWalkSpeed = HoopSpeed;
 
-			// Play camera shake.
-			if(CameraShakeComponent->CameraShake)
+			// Play camera shake. Only on this snake's own player, the shake source would otherwise shake every player's camera.
+			APlayerController* PlayerController = GetSnakePlayerController();
+			if (CameraShakeComponent->CameraShake && PlayerController && PlayerController->PlayerCameraManager)
 			{
-				CameraShakeComponent->StartCameraShake(CameraShakeComponent->CameraShake);
+				PlayerController->PlayerCameraManager->StartCameraShakeFromSource(CameraShakeComponent->CameraShake, CameraShakeComponent);
 			}
 
 			// Emit particles
-			SpeedLineEffect->Activate(true);
+			SetSpeedLinesActive(true);
 
 			// Push crosshair widget to the HUD if it implements the HUDInterface
-			AHUD* HUD = UGameplayStatics::GetPlayerController(GetWorld(), 0)->GetHUD();
-			if (HUD->GetClass()->ImplementsInterface(UHUDInterface::StaticClass()))
+			if (AHUD* HUD = GetSnakeHUD())
 			{
 				IHUDInterface::Execute_PushCrosshair(HUD);
 			}
 
+			BeginTransitionTiming("EnterHoop");
+
 			// Add impulse to movement so that hoop immediately travels at top speed.
 			GetCharacterMovement()->AddImpulse(GetCapsuleComponent()->GetForwardVector() * HoopSpeed, true);
+			MarkInputEffect("EnterHoop");
 
 			// Set previous forward direction for use when calculating hoop tilt.
 			PreviousForward = GetCapsuleComponent()->GetForwardVector();
@@ -304,6 +611,14 @@ void AHoopSnakeCharacter::ToggleHoop(const FInputActionValue& Value)
 
 void AHoopSnakeCharacter::Reset()
 {
+	// Reset doubles as skipping the killcam, and the snake shouldn't reset behind it while it plays.
+	USnakeKillcamRecorder* Killcam = IsPlayerControlled() ? GetWorld()->GetSubsystem<USnakeKillcamRecorder>() : nullptr;
+	if (Killcam && Killcam->IsPlaying())
+	{
+		Killcam->StopKillcam();
+		return;
+	}
+
 	// Only reset when ragdolling
 	if (GetMesh()->IsSimulatingPhysics())
 	{
@@ -313,11 +628,13 @@ void AHoopSnakeCharacter::Reset()
 		* This results in the mesh root being in the incorrect orientation and position when transitioning from pose to animation.
 		* A root bone similar to the Unreal mannequin would be needed, with that root bone being set to never simulate physics.
 		* Useful video: https://www.youtube.com/watch?v=0H6w3YtLr2Y */
-		GetMesh()->GetAnimInstance()->SavePoseSnapshot("RagdollPose");
+		{
+			LLM_SCOPE_BYTAG(HoopSnake_Snakes);
+			GetMesh()->GetAnimInstance()->SavePoseSnapshot(RagdollPoseName);
+		}
 
 		// Since we can't smoothly transition between ragdoll and animation using the above method, fade to black while we reset the snake.
-		AHUD* HUD = UGameplayStatics::GetPlayerController(GetWorld(), 0)->GetHUD();
-		if (HUD->GetClass()->ImplementsInterface(UHUDInterface::StaticClass()))
+		if (AHUD* HUD = GetSnakeHUD())
 		{
 			IHUDInterface::Execute_PushFadeToBlack(HUD);
 		}
@@ -332,6 +649,12 @@ void AHoopSnakeCharacter::Reset()
 	}
 }
 
+void AHoopSnakeCharacter::SetJawOpenAngle(float Angle)
+{
+	UpperJaw->SetJawOpenAngle(Angle);
+	LowerJaw->SetJawOpenAngle(Angle);
+}
+
 void AHoopSnakeCharacter::FinishReset()
 {
 	// Stop simulating physics
@@ -342,7 +665,7 @@ void AHoopSnakeCharacter::FinishReset()
 	GetCharacterMovement()->MaxWalkSpeed = DefaultSpeed;
 
 	// Enable collision on head (it is usually disabled when attaching to victims)
-	GetMesh()->GetBodyInstance(HeadBoneName)->SetShapeCollisionEnabled(0, ECollisionEnabled::Type::QueryAndPhysics);
+	UCustomBlueprintFunctionLibrary::ChangeCollisionOnPhysicsBody(GetMesh(), HeadBoneName, ECollisionEnabled::Type::QueryAndPhysics);
 
 	// Move capsule into position and re-enable collision.
 	GetCapsuleComponent()->SetWorldLocation(GetMesh()->GetBoneLocation(HeadBoneName));
@@ -354,8 +677,7 @@ void AHoopSnakeCharacter::FinishReset()
 	CameraBoom->AttachToComponent(GetCapsuleComponent(), FAttachmentTransformRules::SnapToTargetIncludingScale);
 	GetMesh()->SetRelativeLocation(MeshOffset);
 	GetMesh()->SetRelativeRotation(FRotator(0.0f));
-	UpperJaw->SetRelativeRotation(FRotator(0.0f, 90.0f, 0.0f));
-	LowerJaw->SetRelativeRotation(FRotator(0.0f, 90.0f, 0.0f));
+	SetJawOpenAngle(0.0f);
 
 	// Reset bools
 	bHoopToggle = false;
@@ -377,6 +699,8 @@ void AHoopSnakeCharacter::FinishReset()
 
 void AHoopSnakeCharacter::TriggerAttack_Implementation()
 {
+	SCOPE_CYCLE_COUNTER(STAT_SnakeTriggerAttack);
+
 	if (bAttackQueued)
 	{
 		// Unqueue attack
@@ -387,7 +711,7 @@ void AHoopSnakeCharacter::TriggerAttack_Implementation()
 
 		// Stop camera shake and particles
 		CameraShakeComponent->StopAllCameraShakes(false);
-		SpeedLineEffect->Deactivate();
+		SetSpeedLinesActive(false);
 
 		// Detach mesh from capsule, this fixes some issues with accurately getting the mesh/bone positions. Should be re-attached upon reset.
 		GetMesh()->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
@@ -398,73 +722,52 @@ void AHoopSnakeCharacter::TriggerAttack_Implementation()
 		// Force based on the camera look direction so that player can aim the lunge.
 		FVector LaunchForce = (GetFollowCamera()->GetForwardVector() * AttackForceForward) + FVector(0.0f, 0.0f, AttackForceUp);
 		GetMesh()->AddImpulse(LaunchForce, HeadBoneName);
+		MarkInputEffect("Attack");
 
-		// Open snake's mouth. When proper snake mesh is found, this will be changed to an animation instead of just snapping open instantly.
-		UpperJaw->SetRelativeRotation(FRotator(-45.0f, 90.0f, 0.0f));
-		LowerJaw->SetRelativeRotation(FRotator(45.0f, 90.0f, 0.0f));
+		// Open snake's mouth. Snaps open instantly unless the animation blueprint drives the jaw curve.
+		SetJawOpenAngle(45.0f);
 
 		// Attach camera to snake
 		GetCameraBoom()->AttachToComponent(GetMesh(), FAttachmentTransformRules::SnapToTargetIncludingScale, "HeadSocket");
 
 		// Pop crosshair widget from HUD
-		AHUD* HUD = UGameplayStatics::GetPlayerController(GetWorld(), 0)->GetHUD();
-		if (HUD->GetClass()->ImplementsInterface(UHUDInterface::StaticClass()))
+		if (AHUD* HUD = GetSnakeHUD())
 		{
 			IHUDInterface::Execute_PopWidget(HUD);
 		}
 
 		// Play some sounds at start of attack
-		UGameplayStatics::PlaySoundAtLocation(GetWorld(), WhooshSound, GetMesh()->GetBoneLocation(HeadBoneName));
-		UGameplayStatics::PlaySoundAtLocation(GetWorld(), HissSound, GetMesh()->GetBoneLocation(HeadBoneName));
+		PlayCombatSound(&USnakeArchetype::WhooshSound, GetMesh()->GetBoneLocation(HeadBoneName));
+		PlayCombatSound(&USnakeArchetype::HissSound, GetMesh()->GetBoneLocation(HeadBoneName));
 
 		// Disable movement through character movement component (can still move while ragdolling, but that doesn't use movement component). Should be re-enabled upon reset.
 		GetCharacterMovement()->DisableMovement();
+
+		BeginTransitionTiming("Attack");
 	}
 }
 
 void AHoopSnakeCharacter::ClearHUD()
 {
 	// Pop all widgets from the HUD via interface
-	AHUD* HUD = UGameplayStatics::GetPlayerController(GetWorld(), 0)->GetHUD();
-	if (HUD->GetClass()->ImplementsInterface(UHUDInterface::StaticClass()))
+	if (AHUD* HUD = GetSnakeHUD())
 	{
 		IHUDInterface::Execute_PopAllWidgets(HUD);
 	}
 }
 
-void AHoopSnakeCharacter::MovementNoise()
+void AHoopSnakeCharacter::Pause()
 {
-	float Speed;
-	float Volume;
-
-	// Use bone velocity for speed if simulating physics, otherwise use character movement velocity.
-	if (GetMesh()->IsSimulatingPhysics())
-	{
-		Speed = GetMesh()->GetBoneLinearVelocity(HeadBoneName).Length();
-	}
-	else
-	{
-		Speed = GetCharacterMovement()->Velocity.Length();
-	}
-	
-	// Only make a noise if moving.
-	if (Speed > 10.0f)
+	// Only players can pause, AI snakes never have a pause menu to show.
+	if (!GetSnakePlayerController())
 	{
-		// Volume is determined by speed. 0 speed = no noise. Travelling at full speed in hoop mode = max noise.
-		Volume = UKismetMathLibrary::MapRangeClamped(Speed, 0.0f, HoopSpeed, 0.0f, 1.0f);
-		MakeNoise(Volume, this, GetMesh()->GetBoneLocation(HeadBoneName));
+		return;
 	}
-}
-
-void AHoopSnakeCharacter::Pause()
-{
-	APlayerController* PlayerController = UGameplayStatics::GetPlayerController(GetWorld(), 0);
 
 	// Toggle pause state.
 	UGameplayStatics::SetGamePaused(GetWorld(), !UGameplayStatics::IsGamePaused(GetWorld()));
 
-	AHUD* HUD = PlayerController->GetHUD();
-	if (HUD->GetClass()->ImplementsInterface(UHUDInterface::StaticClass()))
+	if (AHUD* HUD = GetSnakeHUD())
 	{
 		// Create pause menu widget via the HUD if game is set to paused
 		if (UGameplayStatics::IsGamePaused(GetWorld()))
@@ -491,6 +794,8 @@ void AHoopSnakeCharacter::OnMeshHit(UPrimitiveComponent* HitComponent, AActor* O
 
 void AHoopSnakeCharacter::AttemptBite(const FHitResult& Hit)
 {
+	SCOPE_CYCLE_COUNTER(STAT_SnakeAttemptBite);
+
 	// Can only bite when not being forced to ragdoll by external object, and when not already biting something
 	if (!bIsForcedRagdoll && !bIsBiting)
 	{
@@ -503,7 +808,7 @@ void AHoopSnakeCharacter::AttemptBite(const FHitResult& Hit)
 			if (!HitSkeleton->IsSimulatingPhysics())
 			{
 				HitSkeleton->SetSimulatePhysics(true);
-				UGameplayStatics::PlaySoundAtLocation(GetWorld(), ImpactSound, Hit.ImpactPoint);
+				PlayCombatSound(&USnakeArchetype::ImpactSound, Hit.ImpactPoint);
 			}
 
 			// Hoop snakes can only bite with their head (I hope)
@@ -530,13 +835,15 @@ void AHoopSnakeCharacter::AttemptBite(const FHitResult& Hit)
 					FVector FrameOffset = UKismetMathLibrary::InverseTransformLocation(HitSkeleton->GetBoneTransform(Hit.BoneName), ImpactPoint);
 					
 					// Setup constraint
-					APhysicsConstraintActor* Constraint = GetWorld()->SpawnActor<APhysicsConstraintActor>(BiteConstraintClass, ImpactPoint, FRotator(0.0f));
-					
-					// So we can easily access and destroy constraint
-					Constraint->SetOwner(this);
+					LLM_SCOPE_BYTAG(HoopSnake_BiteConstraints);
+					const TSubclassOf<APhysicsConstraintActor> ConstraintClass = GetBiteConstraintClass();
+					APhysicsConstraintActor* Constraint = ConstraintClass ? GetWorld()->SpawnActor<APhysicsConstraintActor>(ConstraintClass, ImpactPoint, FRotator(0.0f)) : nullptr;
 
 					if (Constraint)
 					{
+						// So we can easily access and destroy constraint
+						Constraint->SetOwner(this);
+
 						UPhysicsConstraintComponent* ConstraintComp = Constraint->GetConstraintComp();
 						ConstraintComp->SetConstrainedComponents(GetMesh(), HeadBoneName, Hit.GetComponent(), Hit.BoneName);
 						ConstraintComp->SetConstraintReferencePosition(EConstraintFrame::Type::Frame1, FVector(0.0f)); // frame 1 has no offset
@@ -544,21 +851,22 @@ void AHoopSnakeCharacter::AttemptBite(const FHitResult& Hit)
 						// ** TO DO: also orient snake head to face the bone it is attaching to
 
 						// Disable collision on snake head so it doesn't constantly collide with the victim
-						GetMesh()->GetBodyInstance(HeadBoneName)->SetShapeCollisionEnabled(0, ECollisionEnabled::Type::NoCollision);
+						UCustomBlueprintFunctionLibrary::ChangeCollisionOnPhysicsBody(GetMesh(), HeadBoneName, ECollisionEnabled::Type::NoCollision);
 
 						// Add impulse to hit body
 						FVector Impulse = GetMesh()->GetBoneLinearVelocity(HeadBoneName).Length() * HeadBoneForward * 20.0f;
 						Hit.GetComponent()->AddImpulse(Impulse, Hit.BoneName);
 
 						// Play sounds
-						UGameplayStatics::PlaySoundAtLocation(GetWorld(), ImpactSound, GetMesh()->GetBoneLocation(HeadBoneName));
-						UGameplayStatics::PlaySoundAtLocation(GetWorld(), BiteSound, GetMesh()->GetBoneLocation(HeadBoneName));
+						PlayCombatSound(&USnakeArchetype::ImpactSound, GetMesh()->GetBoneLocation(HeadBoneName));
+						PlayCombatSound(&USnakeArchetype::BiteSound, GetMesh()->GetBoneLocation(HeadBoneName));
 
 						bIsBiting = true;
 
-						// Jaw rotation for biting.
-						UpperJaw->SetRelativeRotation(FRotator(-30.0f, 90.0f, 0.0f));
-						LowerJaw->SetRelativeRotation(FRotator(30.0f, 90.0f, 0.0f));
+						// Jaw angle for biting.
+						SetJawOpenAngle(30.0f);
+
+						OnBite.Broadcast(this, HitSkeleton->GetOwner());
 					}
 				}
 			}
@@ -599,8 +907,8 @@ void AHoopSnakeCharacter::RagdollMovement(FVector ForwardDirection, FVector Righ
 				}
 			}
 
-			// Apply impulse when trying to move while biting, spreading force across all bones
-			GetMesh()->AddImpulseToAllBodiesBelow(ForceDirection * (RagdollMovementForce / GetMesh()->GetNumBones()) * 10.0f);
+			// Apply impulse when trying to move while biting, spreading force across all bones. Scaled up when the ragdoll has fewer bodies, so the total stays the same.
+			GetMesh()->AddImpulseToAllBodiesBelow(ForceDirection * (RagdollMovementForce / GetMesh()->GetNumBones()) * GetSnakeMesh()->GetBodyImpulseScale() * 10.0f);
 
 			// Apply impulse to the other body too, but just the attached bone
 			if (OtherBody)
@@ -610,8 +918,8 @@ void AHoopSnakeCharacter::RagdollMovement(FVector ForwardDirection, FVector Righ
 			}
 
 			// Play SFX
-			//UGameplayStatics::PlaySound2D(GetWorld(), WhooshSound);
-			UGameplayStatics::PlaySoundAtLocation(GetWorld(), WhooshSound, GetMesh()->GetComponentLocation());
+			//UGameplayStatics::PlaySound2D(GetWorld(), GetCombatSound(&USnakeArchetype::WhooshSound));
+			PlayCombatSound(&USnakeArchetype::WhooshSound, GetMesh()->GetComponentLocation());
 
 			// Start cooldown
 			TriggerRagdollMovementCooldown();
@@ -626,7 +934,7 @@ void AHoopSnakeCharacter::RagdollMovement(FVector ForwardDirection, FVector Righ
 			GetMesh()->AddImpulse(ForceDirection * RagdollMovementForce * 10.0f);
 
 			// Play SFX
-			UGameplayStatics::PlaySound2D(GetWorld(), WhooshSound);
+			PlayCombatSound2D(&USnakeArchetype::WhooshSound);
 
 			// Start cooldown
 			TriggerRagdollMovementCooldown();
@@ -651,112 +959,466 @@ void AHoopSnakeCharacter::TriggerRagdollMovementCooldown()
 	GetWorld()->GetTimerManager().SetTimer(Handle, FTimerDelegate::CreateLambda([&] { bIsMovementOnCooldown = false; }), MovementCooldownDuration + CooldownTimerVariation, false);
 }
 
-void AHoopSnakeCharacter::UpdateCamera(float DeltaTime)
+FSnakeCameraTargets AHoopSnakeCharacter::GetCameraTargets() const
 {
-	// Interpolate towards the desired field of view value.
-	float TargetFOV = bHoopModeEnabled ? HoopFOV : DefaultFOV;
-	FollowCamera->FieldOfView = UKismetMathLibrary::FInterpTo(FollowCamera->FieldOfView, TargetFOV, DeltaTime, CameraInterpSpeed);
+	FSnakeCameraTargets Targets;
+	Targets.FieldOfView = bHoopModeEnabled ? HoopFOV : DefaultFOV;
+	Targets.ArmLength = bHoopModeEnabled ? HoopArmLength : DefaultArmLength;
+	Targets.SocketOffset = bHoopModeEnabled ? HoopCameraOffset : DefaultCameraOffset;
 
-	// Interpolate towards the desired boom arm length.
-	float TargetArmLength = bHoopModeEnabled ? HoopArmLength : DefaultArmLength;
-	CameraBoom->TargetArmLength = UKismetMathLibrary::FInterpTo(CameraBoom->TargetArmLength, TargetArmLength, DeltaTime, CameraInterpSpeed);
-
-	// Interpolate towards the desired camera offset.
-	FVector TargetOffset = bHoopModeEnabled ? HoopCameraOffset : DefaultCameraOffset;
-	CameraBoom->SocketOffset = UKismetMathLibrary::VInterpTo(CameraBoom->SocketOffset, TargetOffset, DeltaTime, CameraInterpSpeed);
-	
 	/* Boom offset is handled differently when simulating physics.
 	 * Offsetting using relative location would result in the boom arm rolling with the ragdolling mesh and colliding with the ground.
-	 * Instead relative location must be reset to 0, and the offset is applied to its world position so it remains in place above the mesh.
+	 * Instead the offset is applied to its world position so it remains in place above the mesh.
 	 * No need to interpolate these values currently as camera lag will smooth transition. */
 	if (GetMesh()->IsSimulatingPhysics())
 	{
-		// Reset boom's relative location.
-		CameraBoom->SetRelativeLocation(FVector(0));
-
-		// Apply world offset to boom.
-		FVector NewPosition = GetMesh()->GetSocketLocation("HeadSocket") + RagdollBoomPosition;
-		CameraBoom->SetWorldLocation(NewPosition);
+		Targets.BoomLocation = CachedHeadSocketTransform.GetLocation() + RagdollBoomPosition;
+		Targets.bBoomLocationIsWorld = true;
 	}
 	else // when not simulating physics...
 	{
-		// Apply relative offset to boom.
-		FVector NewPosition = bHoopModeEnabled ? HoopBoomPosition : DefaultBoomPosition;
-		CameraBoom->SetRelativeLocation(NewPosition);
+		Targets.BoomLocation = bHoopModeEnabled ? HoopBoomPosition : DefaultBoomPosition;
 	}
+
+	return Targets;
 }
 
-void AHoopSnakeCharacter::ApplyHoopMovement(float DeltaTime)
+void AHoopSnakeCharacter::CacheHeadTransforms()
 {
-	// Apply forward input every tick when in hoop mode.
-	AddMovementInput(GetCapsuleComponent()->GetForwardVector(), 5.0f);
-
-	// Multiply dot product by modifier to get tilt amount. Modifier is negated to ensure it tilts in the correct direction.
-	DesiredTilt = TurningDotProduct() * -TiltModifier;
-
-	// Interpolate towards the desired tilt
-	CurrentTilt = UKismetMathLibrary::FInterpTo(CurrentTilt, DesiredTilt, DeltaTime, TiltInterpSpeed);
-	GetMesh()->SetRelativeRotation(FRotator(0.0f, 0.0f, CurrentTilt));
+	CachedHeadSocketTransform = GetMesh()->GetSocketTransform("HeadSocket");
+	CachedHeadBoneLocation = GetMesh()->GetBoneLocation(HeadBoneName);
 }
 
-void AHoopSnakeCharacter::UpdateAnimationProperties()
+void AHoopSnakeCharacter::ForceRagdoll()
 {
-	RotateRate = TurningDotProduct();
-
-	// If rotate rate is roughly zero, we are not rotating. Otherwise we are rotating.
-	bIsRotating = !(UKismetMathLibrary::NearlyEqual_FloatFloat(RotateRate, 0.0f)); 
-
-	FVector Forward = GetCapsuleComponent()->GetForwardVector();
-	FVector NormalizedVelocity = UKismetMathLibrary::Normal(GetCharacterMovement()->Velocity);
-
-	// Compare velocity and forward vector to determine if we're moving forward.
-	bool bIsMovingForward = (UKismetMathLibrary::Dot_VectorVector(Forward, NormalizedVelocity) > 0.1f);
-
-	// Compare velocity and cross of forward vector to determine if we're moving right.
-	bool bIsMovingRight = (UKismetMathLibrary::Dot_VectorVector(UKismetMathLibrary::Cross_VectorVector(Forward, UKismetMathLibrary::Vector_Up()), NormalizedVelocity) * -1 > 0.1f);
+	ForceRagdollWithVelocity(GetCharacterMovement()->Velocity);
+}
 
-	// Reverse slither animation when not moving forward or right.
-	if (bIsMovingForward || bIsMovingRight) 
-	{
-		bReverseSlither = false;
-	}
-	else
+void AHoopSnakeCharacter::ForceRagdollWithVelocity(const FVector& Velocity)
+{
+	// The movement component's impact prediction and the obstacle's own hit event can both report the same impact.
+	if (bIsForcedRagdoll)
 	{
-		bReverseSlither = true;
+		return;
 	}
-	
-}
 
-void AHoopSnakeCharacter::ForceRagdoll()
-{
 	// Track that mesh was forced to ragdoll, unqueue any attacks and exit hoop mode
 	bIsForcedRagdoll = true;
 	bAttackQueued = false;
 	bHoopModeEnabled = false;
 
-	// Simulate physics and adjust attachments
+	// Simulate physics and adjust attachments. Only bodies that were kinematic pick up the hoop's velocity, a snake that is already ragdolling keeps its own.
+	const bool bWasSimulating = GetMesh()->IsSimulatingPhysics();
 	GetMesh()->SetSimulatePhysics(true);
+	if (!bWasSimulating)
+	{
+		GetMesh()->SetAllPhysicsLinearVelocity(Velocity);
+	}
 	GetMesh()->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
 	GetCameraBoom()->AttachToComponent(GetMesh(), FAttachmentTransformRules::SnapToTargetIncludingScale, "HeadSocket");
 
+	// Movement is re-enabled on reset, as after an attack.
+	GetCharacterMovement()->DisableMovement();
+
 	// Stop camera shake and particles
 	CameraShakeComponent->StopAllCameraShakes(false);
-	SpeedLineEffect->Deactivate();
+	SetSpeedLinesActive(false);
 
 	// Pop crosshair widget from HUD
-	AHUD* HUD = UGameplayStatics::GetPlayerController(GetWorld(), 0)->GetHUD();
-	if (HUD->GetClass()->ImplementsInterface(UHUDInterface::StaticClass()))
+	if (AHUD* HUD = GetSnakeHUD())
 	{
 		IHUDInterface::Execute_PopWidget(HUD);
 	}
 }
 
-float AHoopSnakeCharacter::TurningDotProduct()
+void AHoopSnakeCharacter::RestoreToTransform(const FTransform& Transform)
 {
-	/* Dot product of previous and current forwards would tell us when we're turning, but not which direction.
-	 * So we use cross product of previous forward and up vector against the current forward so that direction can be determined from the dot product. */
-	FVector PreviousCrossUp = UKismetMathLibrary::Cross_VectorVector(PreviousForward, UKismetMathLibrary::Vector_Up());
-	float CrossDotCurrent = UKismetMathLibrary::Dot_VectorVector(PreviousCrossUp, GetCapsuleComponent()->GetForwardVector());
+	// Any reset already on its way would fade and move the snake again after this.
+	GetWorldTimerManager().ClearAllTimersForObject(this);
+
+	// Out of hoop mode, without the attack it may have queued
+	bHoopModeEnabled = false;
+	bAttackQueued = false;
+	CameraShakeComponent->StopAllCameraShakes(true);
+	SetSpeedLinesActive(false);
+
+	// The same as the end of a ragdoll reset: stop simulating, reattach everything and drop any bite constraint. Also resets movement.
+	FinishReset();
+
+	SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+	GetCharacterMovement()->StopMovementImmediately();
+	PreviousForward = GetCapsuleComponent()->GetForwardVector();
+	CurrentTilt = 0.0f;
+	DesiredTilt = 0.0f;
+
+	if (Controller)
+	{
+		Controller->SetControlRotation(Transform.Rotator());
+	}
+
+	ClearHUD();
+}
+
+USnakeMeshComponent* AHoopSnakeCharacter::GetSnakeMesh() const
+{
+	return CastChecked<USnakeMeshComponent>(GetMesh());
+}
+
+APlayerController* AHoopSnakeCharacter::GetSnakePlayerController() const
+{
+	return Cast<APlayerController>(GetController());
+}
+
+AHUD* AHoopSnakeCharacter::GetSnakeHUD() const
+{
+	// Each snake talks to its own player's HUD, so several snakes can share a world. AI snakes have no HUD.
+	APlayerController* PlayerController = GetSnakePlayerController();
+	AHUD* HUD = PlayerController ? PlayerController->GetHUD() : nullptr;
+
+	if (HUD && HUD->GetClass()->ImplementsInterface(UHUDInterface::StaticClass()))
+	{
+		return HUD;
+	}
+
+	return nullptr;
+}
+
+void AHoopSnakeCharacter::PrewarmAssets()
+{
+	SCOPE_CYCLE_COUNTER(STAT_SnakePrewarm);
+
+	// Nothing to warm up until the archetype's core bundle arrives. OnArchetypeCoreLoaded calls back in here when it does.
+	bPrewarmRequested = true;
+
+	if (bAssetsPrewarmed || !Archetype)
+	{
+		return;
+	}
+
+	bAssetsPrewarmed = true;
+
+	// Make sure the camera shake class is fully constructed before it's first started.
+	if (CameraShakeComponent->CameraShake)
+	{
+		CameraShakeComponent->CameraShake->GetDefaultObject();
+	}
+
+	/* Start the speed line system instance now and pause it, so entering hoop mode only has to unpause it.
+	 * Its PSOs are requested below along with the other meshes the player sees when switching modes. */
+	StartSpeedLineInstance();
+
+	// Precache pipeline states for everything rendered in hoop and ragdoll states. Ragdolling uses the same skinned mesh as the animated snake.
+	GetMesh()->PrecachePSOs();
+	UpperJaw->PrecachePSOs();
+	LowerJaw->PrecachePSOs();
+	SpeedLineEffect->PrecachePSOs();
+
+	// Pull in the combat bundle now rather than waiting for hoop mode. Its sounds are primed once it arrives.
+	LoadArchetypeCombat();
+}
+
+void AHoopSnakeCharacter::LoadArchetype()
+{
+	ArchetypeRequestTime = FPlatformTime::Seconds();
+	ArchetypeCoreHandle = ArchetypeId.IsValid() ? UAssetManager::Get().LoadPrimaryAsset(ArchetypeId, { USnakeArchetype::CoreBundle }, FStreamableDelegate::CreateUObject(this, &AHoopSnakeCharacter::OnArchetypeCoreLoaded)) : nullptr;
+
+	// No handle, or a completed one, means everything was already in memory or there's no such asset.
+	if (!ArchetypeCoreHandle.IsValid() || ArchetypeCoreHandle->HasLoadCompleted())
+	{
+		OnArchetypeCoreLoaded();
+	}
+}
+
+void AHoopSnakeCharacter::OnArchetypeCoreLoaded()
+{
+	LLM_SCOPE_BYTAG(HoopSnake_Snakes);
+
+	if (Archetype)
+	{
+		return;
+	}
+
+	USnakeArchetype* LoadedArchetype = ArchetypeId.IsValid() ? UAssetManager::Get().GetPrimaryAssetObject<USnakeArchetype>(ArchetypeId) : nullptr;
+	if (!LoadedArchetype && !bUsingDefaultArchetype)
+	{
+		// The class defaults point at the shipped content, so stream their core bundle the same way instead.
+		UE_LOG(LogHoopSnake, Warning, TEXT("%s couldn't find snake archetype %s, using the archetype class defaults."), *GetName(), *ArchetypeId.ToString());
+		bUsingDefaultArchetype = true;
+		ArchetypeCoreHandle = LoadDefaultArchetypeBundle(USnakeArchetype::CoreBundle);
+		if (ArchetypeCoreHandle.IsValid() && !ArchetypeCoreHandle->HasLoadCompleted())
+		{
+			return;
+		}
+	}
+
+	Archetype = LoadedArchetype ? LoadedArchetype : GetMutableDefault<USnakeArchetype>();
+
+	UE_LOG(LogHoopSnake, Log, TEXT("%s: archetype %s core bundle ready after %.2f ms"), *GetName(), *GetNameSafe(Archetype), (FPlatformTime::Seconds() - ArchetypeRequestTime) * 1000.0);
+	if (UMainGameInstance* GameInstance = GetGameInstance<UMainGameInstance>())
+	{
+		GameInstance->MarkStartupMilestone(TEXT("SnakeCoreBundleLoaded"));
+	}
+
+	// Apply the archetype's meshes and effects to the components that use them.
+	if (UStaticMesh* Mesh = Archetype->UpperJawMesh.Get())
+	{
+		UpperJaw->SetStaticMesh(Mesh);
+	}
+
+	if (UStaticMesh* Mesh = Archetype->LowerJawMesh.Get())
+	{
+		LowerJaw->SetStaticMesh(Mesh);
+	}
+
+	if (UNiagaraSystem* System = Archetype->SpeedLineSystem.Get())
+	{
+		SpeedLineEffect->SetAsset(System);
+	}
+
+	BindInputActions();
+
+	if (bPrewarmRequested)
+	{
+		PrewarmAssets();
+	}
+
+	// Every attack comes out of hoop mode, which takes a moment to get into, so the combat bundle is normally in long before the first bite.
+	LoadArchetypeCombat();
+}
+
+TSharedPtr<FStreamableHandle> AHoopSnakeCharacter::LoadDefaultArchetypeBundle(FName Bundle)
+{
+	TArray<FSoftObjectPath> Assets;
+	GetDefault<USnakeArchetype>()->GetBundleAssets(Bundle, Assets);
+
+	const FStreamableDelegate Delegate = Bundle == USnakeArchetype::CoreBundle
+		? FStreamableDelegate::CreateUObject(this, &AHoopSnakeCharacter::OnArchetypeCoreLoaded)
+		: FStreamableDelegate::CreateUObject(this, &AHoopSnakeCharacter::OnArchetypeCombatLoaded);
+
+	return UAssetManager::GetStreamableManager().RequestAsyncLoad(Assets, Delegate);
+}
+
+void AHoopSnakeCharacter::SetSpeedLinesActive(bool bActive)
+{
+	LLM_SCOPE_BYTAG(HoopSnake_SnakeEffects);
+
+	if (!bActive)
+	{
+		// Freeze and hide the instance rather than deactivating it, so it never has to be rebuilt.
+		if (bSpeedLinesShown)
+		{
+			SpeedLineEffect->SetPaused(true);
+			SpeedLineEffect->SetVisibility(false);
+			bSpeedLinesShown = false;
+		}
+		AppliedSpeedLineIntensity = 0.0f;
+		return;
+	}
+
+	// Nobody would see the lines of a snake this far from every camera.
+	if (bSpeedLinesShown || !SpeedLineEffect->GetAsset() || GetSpeedLineSignificance() <= 0.0f)
+	{
+		return;
+	}
+
+	// Only does anything the first time, when the snake wasn't prewarmed.
+	StartSpeedLineInstance();
+
+	// Start from nothing, the batched tick brings the intensity up with the hoop's speed.
+	SpeedLineEffect->SetVariableFloat(SpeedLineIntensityParameter, 0.0f);
+	AppliedSpeedLineIntensity = 0.0f;
+	SpeedLineEffect->SetVisibility(true);
+	SpeedLineEffect->SetPaused(false);
+	bSpeedLinesShown = true;
+}
+
+void AHoopSnakeCharacter::StartSpeedLineInstance()
+{
+	if (!SpeedLineEffect->GetAsset() || SpeedLineEffect->IsActive())
+	{
+		return;
+	}
+
+	SpeedLineEffect->SetVariableFloat(SpeedLineIntensityParameter, 0.0f);
+	SpeedLineEffect->Activate(true);
+	SpeedLineEffect->SetPaused(true);
+}
+
+float AHoopSnakeCharacter::GetSpeedLineSignificance() const
+{
+	// The player always sees their own speed lines at full strength.
+	if (IsPlayerControlled())
+	{
+		return 1.0f;
+	}
+
+	// Everyone else's fade out with distance from the nearest player's camera.
+	const FVector Location = GetActorLocation();
+	float ClosestDistanceSquared = FMath::Square(SpeedLineCullDistance);
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController && PlayerController->PlayerCameraManager)
+		{
+			ClosestDistanceSquared = FMath::Min(ClosestDistanceSquared, FVector::DistSquared(PlayerController->PlayerCameraManager->GetCameraLocation(), Location));
+		}
+	}
+
+	return FMath::GetMappedRangeValueClamped(FVector2f(SpeedLineFullSignificanceDistance, SpeedLineCullDistance), FVector2f(1.0f, 0.0f), FMath::Sqrt(ClosestDistanceSquared));
+}
+
+void AHoopSnakeCharacter::LoadArchetypeCombat()
+{
+	if (bCombatRequested || !Archetype)
+	{
+		return;
+	}
+
+	bCombatRequested = true;
+
+	ArchetypeCombatHandle = bUsingDefaultArchetype
+		? LoadDefaultArchetypeBundle(USnakeArchetype::CombatBundle)
+		: UAssetManager::Get().ChangeBundleStateForPrimaryAssets({ ArchetypeId }, { USnakeArchetype::CombatBundle }, {}, false, FStreamableDelegate::CreateUObject(this, &AHoopSnakeCharacter::OnArchetypeCombatLoaded));
+
+	if (!ArchetypeCombatHandle.IsValid() || ArchetypeCombatHandle->HasLoadCompleted())
+	{
+		OnArchetypeCombatLoaded();
+	}
+}
+
+void AHoopSnakeCharacter::OnArchetypeCombatLoaded()
+{
+	if (bCombatLoaded)
+	{
+		return;
+	}
+
+	bCombatLoaded = true;
+
+	UE_LOG(LogHoopSnake, Log, TEXT("%s: archetype %s combat bundle ready after %.2f ms"), *GetName(), *GetNameSafe(Archetype), (FPlatformTime::Seconds() - ArchetypeRequestTime) * 1000.0);
+	if (UMainGameInstance* GameInstance = GetGameInstance<UMainGameInstance>())
+	{
+		GameInstance->MarkStartupMilestone(TEXT("SnakeCombatBundleLoaded"));
+	}
+
+	if (!bPrewarmRequested)
+	{
+		return;
+	}
+
+	// Prime the sound cues so their wave data is ready before the first attack plays them.
+	LLM_SCOPE_BYTAG(HoopSnake_SnakeAudio);
+	for (USoundCue* Sound : { GetCombatSound(&USnakeArchetype::WhooshSound), GetCombatSound(&USnakeArchetype::HissSound), GetCombatSound(&USnakeArchetype::ImpactSound), GetCombatSound(&USnakeArchetype::BiteSound) })
+	{
+		if (Sound)
+		{
+			Sound->PrimeSoundCue();
+		}
+	}
+
+	// Make sure the bite constraint class is fully constructed before it's first spawned.
+	if (UClass* ConstraintClass = Archetype->BiteConstraintClass.Get())
+	{
+		ConstraintClass->GetDefaultObject();
+	}
+}
+
+USoundCue* AHoopSnakeCharacter::GetCombatSound(TSoftObjectPtr<USoundCue> USnakeArchetype::* Sound) const
+{
+	// A missing sound is better than a hitch, so don't load synchronously here.
+	return Archetype ? (Archetype->*Sound).Get() : nullptr;
+}
+
+void AHoopSnakeCharacter::PlayCombatSound(TSoftObjectPtr<USoundCue> USnakeArchetype::* Sound, const FVector& Location) const
+{
+	LLM_SCOPE_BYTAG(HoopSnake_SnakeAudio);
+	UGameplayStatics::PlaySoundAtLocation(GetWorld(), GetCombatSound(Sound), Location);
+}
+
+void AHoopSnakeCharacter::PlayCombatSound2D(TSoftObjectPtr<USoundCue> USnakeArchetype::* Sound) const
+{
+	LLM_SCOPE_BYTAG(HoopSnake_SnakeAudio);
+	UGameplayStatics::PlaySound2D(GetWorld(), GetCombatSound(Sound));
+}
+
+TSubclassOf<APhysicsConstraintActor> AHoopSnakeCharacter::GetBiteConstraintClass() const
+{
+	LLM_SCOPE_BYTAG(HoopSnake_BiteConstraints);
+
+	// Loading it here would hitch in the middle of an attack. The bundle is requested with the core one, so this should never trip.
+	if (!ensureMsgf(bCombatLoaded, TEXT("%s bit before its archetype's combat bundle loaded"), *GetName()))
+	{
+		return nullptr;
+	}
+
+	return Archetype->BiteConstraintClass.Get();
+}
+
+void AHoopSnakeCharacter::BeginTransitionTiming(FName TransitionName)
+{
+	TimedTransition = TransitionName;
+	TransitionFramesToWatch = TransitionWatchFrameCount;
+	WorstTransitionFrameTime = 0.0f;
+}
+
+void AHoopSnakeCharacter::UpdateTransitionTiming()
+{
+	if (TransitionFramesToWatch <= 0)
+	{
+		return;
+	}
+
+	// A hitch in the transition frame shows up in the delta time of the frame after it, so the watch window starts on the next tick.
+	WorstTransitionFrameTime = FMath::Max(WorstTransitionFrameTime, FApp::GetDeltaTime());
+
+	if (--TransitionFramesToWatch == 0)
+	{
+		UE_LOG(LogHoopSnake, Log, TEXT("%s: worst frame time after %s transition was %.2f ms (prewarmed: %s)"),
+			*GetName(), *TimedTransition.ToString(), WorstTransitionFrameTime * 1000.0f, bAssetsPrewarmed ? TEXT("yes") : TEXT("no"));
+
+		TimedTransition = NAME_None;
+	}
+}
+
+FSnakeMemoryFootprint AHoopSnakeCharacter::GetMemoryFootprint() const
+{
+	FSnakeMemoryFootprint Footprint;
+
+	TInlineComponentArray<UActorComponent*> Components(this);
+	for (UActorComponent* Component : Components)
+	{
+		FArchiveCountMem CountMem(Component);
+		Footprint.Components += CountMem.GetMax();
+		++Footprint.NumComponents;
+
+		// Bodies aren't properties, so they aren't in the count above. The trace mesh has bodies too.
+		if (const USkeletalMeshComponent* SkeletalMesh = Cast<USkeletalMeshComponent>(Component))
+		{
+			for (FBodyInstance* Body : SkeletalMesh->Bodies)
+			{
+				if (Body)
+				{
+					FResourceSizeEx BodySize(EResourceSizeMode::Exclusive);
+					Body->GetBodyInstanceResourceSizeEx(BodySize);
+					Footprint.PhysicsBodies += sizeof(FBodyInstance) + BodySize.GetTotalMemoryBytes();
+					++Footprint.NumBodies;
+				}
+			}
+			Footprint.PhysicsBodies += SkeletalMesh->Constraints.Num() * sizeof(FConstraintInstance);
+		}
+	}
+
+	if (const UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance())
+	{
+		FArchiveCountMem CountMem(AnimInstance);
+		Footprint.AnimInstance = CountMem.GetMax();
+
+		// Kept from the last reset for as long as the snake lives.
+		if (const FPoseSnapshot* Snapshot = AnimInstance->GetPoseSnapshot(RagdollPoseName))
+		{
+			Footprint.PoseSnapshots += sizeof(FPoseSnapshot) + Snapshot->LocalTransforms.GetAllocatedSize() + Snapshot->BoneNames.GetAllocatedSize();
+		}
+	}
 
-	return CrossDotCurrent;
+	return Footprint;
 }
@@ -2,4 +2,294 @@
 
 
 #include "MainGameInstance.h"
+#include "HoopSnake.h"
+#include "HoopSnakeCharacter.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/GameUserSettings.h"
+#include "Engine/Engine.h"
+#include "WorldPartition/WorldPartitionSubsystem.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectGlobals.h"
+#include "Misc/App.h"
+#include "Kismet/GameplayStatics.h"
 
+namespace StartupMilestones
+{
+	static const FName EngineInit = TEXT("EngineInit");
+	static const FName MapLoaded = TEXT("MapLoaded");
+	static const FName InitialStreamingComplete = TEXT("InitialStreamingComplete");
+	static const FName FirstPlayableFrame = TEXT("FirstPlayableFrame");
+}
+
+UMainGameInstance::UMainGameInstance()
+{
+	bWriteStartupReport = true;
+	bFastBoot = false;
+	FastBootRestoreTimeout = 15.0f;
+	ReloadTimeout = 60.0f;
+	FastBootStartTime = 0.0;
+	bAutoDetectScalability = true;
+	bReachedFirstPlayableFrame = false;
+	bStartupReportWritten = false;
+	ReloadStartTime = 0.0;
+	ReloadMapLoadedTime = 0.0;
+	ReloadStreamedTime = 0.0;
+}
+
+void UMainGameInstance::Init()
+{
+	Super::Init();
+
+	// By the time the game instance initialises the engine is up, so this is the cost of getting here from process start.
+	MarkStartupMilestone(StartupMilestones::EngineInit);
+
+	if (bAutoDetectScalability)
+	{
+		AutoDetectScalability();
+	}
+
+	if (bFastBoot)
+	{
+		ApplyFastBoot();
+	}
+
+	PostLoadMapHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &UMainGameInstance::OnPostLoadMap);
+	StartupTickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UMainGameInstance::TickStartup));
+}
+
+void UMainGameInstance::Shutdown()
+{
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapHandle);
+	FTSTicker::GetCoreTicker().RemoveTicker(StartupTickHandle);
+	FTSTicker::GetCoreTicker().RemoveTicker(ReloadTickHandle);
+
+	// Still write whatever we have if the game was closed before it became playable.
+	WriteStartupReport();
+	RestoreDeferredSubsystems();
+
+	Super::Shutdown();
+}
+
+void UMainGameInstance::MarkStartupMilestone(FName Milestone)
+{
+	if (Milestones.ContainsByPredicate([Milestone](const FStartupMilestone& Existing) { return Existing.Name == Milestone; }))
+	{
+		return;
+	}
+
+	const double Seconds = FPlatformTime::Seconds() - GStartTime;
+	Milestones.Add({ Milestone, Seconds });
+
+	UE_LOG(LogHoopSnake, Log, TEXT("Startup milestone %s reached at %.3f s"), *Milestone.ToString(), Seconds);
+}
+
+void UMainGameInstance::WriteStartupReport()
+{
+	if (!bWriteStartupReport || bStartupReportWritten || Milestones.IsEmpty())
+	{
+		return;
+	}
+
+	bStartupReportWritten = true;
+
+	FString Report = TEXT("Milestone,SecondsSinceProcessStart,SecondsSincePrevious\n");
+	double Previous = 0.0;
+	for (const FStartupMilestone& Milestone : Milestones)
+	{
+		Report += FString::Printf(TEXT("%s,%.4f,%.4f\n"), *Milestone.Name.ToString(), Milestone.Seconds, Milestone.Seconds - Previous);
+		Previous = Milestone.Seconds;
+	}
+
+	const FString ReportPath = FPaths::ProfilingDir() / TEXT("StartupReport.csv");
+	if (FFileHelper::SaveStringToFile(Report, *ReportPath))
+	{
+		UE_LOG(LogHoopSnake, Log, TEXT("Startup report written to %s"), *ReportPath);
+	}
+	else
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Failed to write startup report to %s"), *ReportPath);
+	}
+}
+
+void UMainGameInstance::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	if (LoadedWorld == GetWorld())
+	{
+		MarkStartupMilestone(StartupMilestones::MapLoaded);
+
+		if (ReloadStartTime > 0.0 && ReloadMapLoadedTime == 0.0)
+		{
+			ReloadMapLoadedTime = FPlatformTime::Seconds();
+		}
+	}
+}
+
+bool UMainGameInstance::IsWorldPlayable(UWorld* World, bool& bOutStreamingComplete) const
+{
+	bOutStreamingComplete = false;
+	if (!World || !World->HasBegunPlay())
+	{
+		return false;
+	}
+
+	// Non partitioned maps have nothing to stream, so they're done as soon as play begins.
+	const UWorldPartitionSubsystem* WorldPartition = World->GetSubsystem<UWorldPartitionSubsystem>();
+	bOutStreamingComplete = !World->IsPartitionedWorld() || (WorldPartition && WorldPartition->IsAllStreamingCompleted());
+
+	// Playable once the local player's snake has its input bound.
+	const APlayerController* PlayerController = GetFirstLocalPlayerController(World);
+	const AHoopSnakeCharacter* Snake = PlayerController ? Cast<AHoopSnakeCharacter>(PlayerController->GetPawn()) : nullptr;
+	return Snake && Snake->IsInputBound();
+}
+
+bool UMainGameInstance::TickStartup(float DeltaTime)
+{
+	bool bStreamingComplete = false;
+	const bool bPlayable = IsWorldPlayable(GetWorld(), bStreamingComplete);
+
+	if (bStreamingComplete)
+	{
+		MarkStartupMilestone(StartupMilestones::InitialStreamingComplete);
+	}
+
+	/* Don't hold the deferred console variables on a controllable snake alone. Maps with no player snake, or one without input,
+	 * would never get them back. Once streaming is done the boot is over, and the timeout covers a world that never gets there. */
+	if (!SavedCVarValues.IsEmpty() && (bPlayable || bStreamingComplete || FPlatformTime::Seconds() - FastBootStartTime >= FastBootRestoreTimeout))
+	{
+		RestoreDeferredSubsystems();
+	}
+
+	if (!bPlayable)
+	{
+		return true;
+	}
+
+	MarkStartupMilestone(StartupMilestones::FirstPlayableFrame);
+	bReachedFirstPlayableFrame = true;
+
+	WriteStartupReport();
+
+	return false;
+}
+
+void UMainGameInstance::ReloadLevelTimed()
+{
+	if (ReloadTickHandle.IsValid())
+	{
+		return;
+	}
+
+	ReloadStartTime = FPlatformTime::Seconds();
+	ReloadMapLoadedTime = 0.0;
+	ReloadStreamedTime = 0.0;
+
+	UGameplayStatics::OpenLevel(this, FName(*UGameplayStatics::GetCurrentLevelName(this)));
+	ReloadTickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UMainGameInstance::TickReload));
+}
+
+bool UMainGameInstance::TickReload(float DeltaTime)
+{
+	// The travel failed, or the map never gets a playable snake. Stop waiting rather than tick forever.
+	const double Elapsed = FPlatformTime::Seconds() - ReloadStartTime;
+	if (Elapsed >= ReloadTimeout)
+	{
+		const TCHAR* Stage = ReloadMapLoadedTime == 0.0 ? TEXT("the map to load") : ReloadStreamedTime == 0.0 ? TEXT("streaming to finish") : TEXT("the world to become playable");
+		UE_LOG(LogHoopSnake, Error, TEXT("Level reload: gave up after %.1f s waiting for %s"), Elapsed, Stage);
+
+		ReloadStartTime = 0.0;
+		ReloadTickHandle.Reset();
+		return false;
+	}
+
+	// The old world is still around until the travel happens.
+	if (ReloadMapLoadedTime == 0.0)
+	{
+		return true;
+	}
+
+	bool bStreamingComplete = false;
+	const bool bPlayable = IsWorldPlayable(GetWorld(), bStreamingComplete);
+
+	if (bStreamingComplete && ReloadStreamedTime == 0.0)
+	{
+		ReloadStreamedTime = FPlatformTime::Seconds();
+	}
+
+	if (!bPlayable || ReloadStreamedTime == 0.0)
+	{
+		return true;
+	}
+
+	const double PlayableTime = FPlatformTime::Seconds();
+	UE_LOG(LogHoopSnake, Display, TEXT("Level reload:"));
+	UE_LOG(LogHoopSnake, Display, TEXT("  map loaded        %8.2f ms"), (ReloadMapLoadedTime - ReloadStartTime) * 1000.0);
+	UE_LOG(LogHoopSnake, Display, TEXT("  streaming done    %8.2f ms"), (ReloadStreamedTime - ReloadStartTime) * 1000.0);
+	UE_LOG(LogHoopSnake, Display, TEXT("  playable          %8.2f ms"), (PlayableTime - ReloadStartTime) * 1000.0);
+
+	ReloadStartTime = 0.0;
+	ReloadTickHandle.Reset();
+	return false;
+}
+
+void UMainGameInstance::ApplyFastBoot()
+{
+	FastBootStartTime = FPlatformTime::Seconds();
+
+	for (const FDeferredConsoleVariable& Deferred : FastBootDeferredCVars)
+	{
+		IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(*Deferred.Name);
+		if (!CVar)
+		{
+			UE_LOG(LogHoopSnake, Warning, TEXT("Fast boot: unknown console variable %s"), *Deferred.Name);
+			continue;
+		}
+
+		SavedCVarValues.Add(Deferred.Name, CVar->GetString());
+		CVar->Set(*Deferred.BootValue, ECVF_SetByCode);
+	}
+}
+
+void UMainGameInstance::RestoreDeferredSubsystems()
+{
+	if (!SavedCVarValues.IsEmpty())
+	{
+		UE_LOG(LogHoopSnake, Log, TEXT("Fast boot: restoring %d deferred console variables at %.3f s"), SavedCVarValues.Num(), FPlatformTime::Seconds() - GStartTime);
+	}
+
+	for (const TPair<FString, FString>& Saved : SavedCVarValues)
+	{
+		if (IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(*Saved.Key))
+		{
+			CVar->Set(*Saved.Value, ECVF_SetByCode);
+		}
+	}
+
+	SavedCVarValues.Empty();
+}
+
+void UMainGameInstance::AutoDetectScalability()
+{
+	UGameUserSettings* Settings = GEngine ? GEngine->GetGameUserSettings() : nullptr;
+
+	// Nothing to measure without a renderer, e.g. under -nullrhi or on a server.
+	if (!Settings || !FApp::CanEverRender())
+	{
+		return;
+	}
+
+	// A previous launch already benchmarked, and anything the player has changed since then should stick.
+	if (Settings->GetLastCPUBenchmarkResult() >= 0.0f && Settings->GetLastGPUBenchmarkResult() >= 0.0f)
+	{
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	Settings->RunHardwareBenchmark();
+	Settings->ApplyHardwareBenchmarkResults();
+
+	UE_LOG(LogHoopSnake, Log, TEXT("Scalability: benchmark took %.2f s, CPU %.0f, GPU %.0f, overall level %d"),
+		FPlatformTime::Seconds() - StartTime, Settings->GetLastCPUBenchmarkResult(), Settings->GetLastGPUBenchmarkResult(), Settings->GetOverallScalabilityLevel());
+}
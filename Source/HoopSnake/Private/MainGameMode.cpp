@@ -2,4 +2,1064 @@
 
 
 #include "MainGameMode.h"
+#include "HoopSnakeCharacter.h"
+#include "MainGameInstance.h"
+#include "HUDInterface.h"
+#include "GameFramework/HUD.h"
+#include "GameFramework/PlayerController.h"
+#include "VictimAIManager.h"
+#include "ProximityGridSubsystem.h"
+#include "SnakePhysicsProfiler.h"
+#include "SnakeTickSubsystem.h"
+#include "SnakeKillcamRecorder.h"
+#include "SnakeScalabilitySubsystem.h"
+#include "CustomBlueprintFunctionLibrary.h"
+#include "SnakeInputLatencyTracker.h"
+#include "SnakeOcclusionSubsystem.h"
+#include "SnakeObstacleSubsystem.h"
+#include "SnakeHUD.h"
+#include "SnakeSimulationSubsystem.h"
+#include "SnakeAIController.h"
+#include "HoopSnake.h"
+#include "VictimAIController.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "PhysicsEngine/PhysicsConstraintActor.h"
+#include "PhysicsEngine/PhysicsConstraintComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "TimerManager.h"
+#include "HAL/IConsoleManager.h"
+#include "EngineUtils.h"
+#include "Engine/Level.h"
+#include "Misc/CommandLine.h"
 
+DECLARE_DWORD_COUNTER_STAT(TEXT("Victim Pool Size"), STAT_VictimPoolSize, STATGROUP_HoopSnake);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Ragdolled Victims"), STAT_RagdolledVictims, STATGROUP_HoopSnake);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Live Victim Bodies"), STAT_LiveVictimBodies, STATGROUP_HoopSnake);
+
+/** Snake counts the snake tick benchmark compares the two tick paths at */
+static const int32 SnakeTickBenchCounts[] = { 1, 16, 128 };
+
+AMainGameMode::AMainGameMode()
+{
+	// Native HUD pushing pooled widgets onto the CommonUI stack
+	HUDClass = ASnakeHUD::StaticClass();
+
+	bPrewarmSnakes = true;
+
+	VictimClass = nullptr;
+	VictimSpawnRadius = 3000.0f;
+
+	bPoolVictims = true;
+	VictimSettleTime = 4.0f;
+	VictimSettleSpeed = 20.0f;
+	VictimRespawnDelay = 2.0f;
+	VictimPoolScanInterval = 0.5f;
+	VictimSpawnPointTag = "VictimSpawn";
+	VictimPoolHits = 0;
+	VictimPoolMisses = 0;
+	RagdolledVictims = 0;
+	LiveVictimBodies = 0;
+
+	SnakeClass = nullptr;
+	SnakeSpawnRadius = 3000.0f;
+
+	BenchMaxSnakes = 0;
+	BenchStep = 0;
+	BenchSecondsPerStep = 0.0f;
+	BenchStepTime = 0.0;
+	BenchTotalFrameTime = 0.0;
+	BenchWorstFrameTime = 0.0;
+	BenchFrameCount = 0;
+	BenchTickRun = 0;
+	BenchFramesPerRun = 0;
+}
+
+void AMainGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	// A blueprint HUD that doesn't derive from the native one can't push pooled widgets or draw the victims' alert overlay.
+	if (!HUDClass || !HUDClass->IsChildOf(ASnakeHUD::StaticClass()))
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Game mode: HUD class %s isn't a %s, victim alerts and pooled widgets won't be shown."), *GetNameSafe(HUDClass), *ASnakeHUD::StaticClass()->GetName());
+	}
+}
+
+void AMainGameMode::StartPlay()
+{
+	Super::StartPlay();
+
+	if (bPoolVictims)
+	{
+		UGameplayStatics::GetAllActorsWithTag(GetWorld(), VictimSpawnPointTag, VictimSpawnPoints);
+		GetWorldTimerManager().SetTimer(VictimPoolTimerHandle, this, &AMainGameMode::UpdateVictimPool, VictimPoolScanInterval, true);
+	}
+
+	if (bPrewarmSnakes)
+	{
+		// Snakes placed in the level or spawned before play started won't go through FinishRestartPlayer.
+		for (TActorIterator<AHoopSnakeCharacter> It(GetWorld()); It; ++It)
+		{
+			PrewarmSnake(*It);
+		}
+	}
+
+	// Remember how the level started, so ResetWorld can put it back without reloading.
+	for (ULevel* Level : GetWorld()->GetLevels())
+	{
+		CaptureWorldSnapshot(Level);
+	}
+	SnapshotLevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &AMainGameMode::OnLevelAddedToWorld);
+	SnapshotLevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &AMainGameMode::OnLevelRemovedFromWorld);
+
+	// Headless tuning and soak runs, e.g. -nullrhi -nosound -SnakeSim=3600 -SimSnakes=16 -SimSet=AttackForceForward=1500
+	float SimSeconds = 0.0f;
+	if (FParse::Value(FCommandLine::Get(), TEXT("SnakeSim="), SimSeconds))
+	{
+		int32 SimSnakes = 8;
+		int32 SimVictims = 32;
+		FString SimOverrides;
+		FParse::Value(FCommandLine::Get(), TEXT("SimSnakes="), SimSnakes);
+		FParse::Value(FCommandLine::Get(), TEXT("SimVictims="), SimVictims);
+		FParse::Value(FCommandLine::Get(), TEXT("SimSet="), SimOverrides, false);
+
+		StartSnakeSim(SimSeconds, SimSnakes, SimVictims, SimOverrides, true);
+	}
+}
+
+void AMainGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StopSnakeBenchmark();
+
+	FWorldDelegates::LevelAddedToWorld.Remove(SnapshotLevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(SnapshotLevelRemovedHandle);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AMainGameMode::FinishRestartPlayer(AController* NewPlayer, const FRotator& StartRotation)
+{
+	Super::FinishRestartPlayer(NewPlayer, StartRotation);
+
+	if (UMainGameInstance* GameInstance = GetGameInstance<UMainGameInstance>())
+	{
+		GameInstance->MarkStartupMilestone(TEXT("PawnSpawned"));
+	}
+
+	if (!bPrewarmSnakes || !NewPlayer)
+	{
+		return;
+	}
+
+	PrewarmSnake(Cast<AHoopSnakeCharacter>(NewPlayer->GetPawn()));
+
+	// Create the crosshair, fade and pause widgets now rather than on their first push.
+	if (APlayerController* PlayerController = Cast<APlayerController>(NewPlayer))
+	{
+		AHUD* HUD = PlayerController->GetHUD();
+		if (HUD && HUD->GetClass()->ImplementsInterface(UHUDInterface::StaticClass()))
+		{
+			IHUDInterface::Execute_PrewarmWidgets(HUD);
+		}
+	}
+}
+
+void AMainGameMode::PrewarmSnake(AHoopSnakeCharacter* Snake)
+{
+	if (Snake)
+	{
+		Snake->PrewarmAssets();
+	}
+}
+
+FVector AMainGameMode::GetStressTestOrigin() const
+{
+	// Spawn around whichever player came first, or the world origin when there are only AI snakes.
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APawn* PlayerPawn = It->IsValid() ? (*It)->GetPawn() : nullptr)
+		{
+			return PlayerPawn->GetActorLocation();
+		}
+	}
+
+	return FVector::ZeroVector;
+}
+
+void AMainGameMode::SpawnVictims(int32 Count)
+{
+	if (!VictimClass && VictimPool.IsEmpty())
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("SpawnVictims needs a victim class. Set VictimClass under [/Script/HoopSnake.MainGameMode] in DefaultGame.ini."));
+		return;
+	}
+
+	const FVector Origin = GetStressTestOrigin();
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		const FVector2D Offset = FMath::RandPointInCircle(VictimSpawnRadius);
+		const FVector Location = Origin + FVector(Offset.X, Offset.Y, 100.0f);
+		const FRotator Rotation(0.0f, FMath::FRandRange(0.0f, 360.0f), 0.0f);
+
+		AcquireVictim(FTransform(Rotation, Location));
+	}
+}
+
+ACharacter* AMainGameMode::AcquireVictim(const FTransform& SpawnTransform)
+{
+	// Reuse a pooled victim if there is one. Its actor, components and physics state already exist.
+	while (!VictimPool.IsEmpty())
+	{
+		AVictimAIController* VictimController = VictimPool.Pop(EAllowShrinking::No);
+		ACharacter* Victim = VictimController ? VictimController->GetPawn<ACharacter>() : nullptr;
+		if (!Victim)
+		{
+			continue;
+		}
+
+		++VictimPoolHits;
+
+		Victim->SetActorLocationAndRotation(SpawnTransform.GetLocation(), SpawnTransform.GetRotation(), false, nullptr, ETeleportType::ResetPhysics);
+		SetVictimActive(Victim, true);
+		VictimController->SetPooled(false);
+
+		return Victim;
+	}
+
+	if (!VictimClass)
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Victim pool is empty and there is no victim class to spawn more from."));
+		return nullptr;
+	}
+
+	++VictimPoolMisses;
+
+	LLM_SCOPE_BYTAG(HoopSnake_Victims);
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	ACharacter* Victim = GetWorld()->SpawnActor<ACharacter>(VictimClass, SpawnTransform.GetLocation(), SpawnTransform.Rotator(), SpawnParams);
+	if (Victim && !Victim->GetController())
+	{
+		Victim->SpawnDefaultController();
+	}
+
+	return Victim;
+}
+
+void AMainGameMode::ReleaseVictim(AVictimAIController* VictimController)
+{
+	ACharacter* Victim = VictimController ? VictimController->GetPawn<ACharacter>() : nullptr;
+	if (!Victim || VictimController->IsPooled())
+	{
+		return;
+	}
+
+	// Decide where it comes back before it gets moved out of the way.
+	const FTransform SpawnTransform = PickVictimSpawnTransform(VictimController);
+
+	ResetVictimRagdoll(Victim);
+	SetVictimActive(Victim, false);
+	VictimController->SetPooled(true);
+	VictimPool.Add(VictimController);
+
+	// Bring a victim back at a spawn point after a while, which will usually be this one straight out of the pool.
+	FTimerHandle RespawnHandle;
+	GetWorldTimerManager().SetTimer(RespawnHandle, FTimerDelegate::CreateUObject(this, &AMainGameMode::RespawnVictim, SpawnTransform), VictimRespawnDelay, false);
+}
+
+void AMainGameMode::RespawnVictim(FTransform SpawnTransform)
+{
+	AcquireVictim(SpawnTransform);
+}
+
+FTransform AMainGameMode::PickVictimSpawnTransform(const AVictimAIController* VictimController) const
+{
+	if (!VictimSpawnPoints.IsEmpty())
+	{
+		if (const AActor* SpawnPoint = VictimSpawnPoints[FMath::RandRange(0, VictimSpawnPoints.Num() - 1)])
+		{
+			return SpawnPoint->GetActorTransform();
+		}
+	}
+
+	// No spawn points in the level, send it back to where it started.
+	return VictimController->GetHomeTransform();
+}
+
+void AMainGameMode::ResetVictimRagdoll(ACharacter* Victim)
+{
+	// Victims can have more than one skeletal mesh, any of them may have been bitten.
+	TInlineComponentArray<USkeletalMeshComponent*> Meshes(Victim);
+	for (USkeletalMeshComponent* Mesh : Meshes)
+	{
+		if (Mesh->IsSimulatingPhysics())
+		{
+			Mesh->SetSimulatePhysics(false);
+		}
+	}
+
+	// Put the main mesh back where the class has it, simulating may have detached it from the capsule.
+	USkeletalMeshComponent* Mesh = Victim->GetMesh();
+	const ACharacter* DefaultVictim = Victim->GetClass()->GetDefaultObject<ACharacter>();
+	if (Mesh->GetAttachParent() != Victim->GetCapsuleComponent())
+	{
+		Mesh->AttachToComponent(Victim->GetCapsuleComponent(), FAttachmentTransformRules::SnapToTargetNotIncludingScale);
+	}
+	Mesh->SetRelativeTransform(DefaultVictim->GetMesh()->GetRelativeTransform(), false, nullptr, ETeleportType::ResetPhysics);
+
+	// Go back to the animated pose rather than blending out of the ragdoll.
+	for (USkeletalMeshComponent* Each : Meshes)
+	{
+		Each->ResetAnimInstanceDynamics(ETeleportType::ResetPhysics);
+		Each->RefreshBoneTransforms();
+	}
+}
+
+void AMainGameMode::SetVictimActive(ACharacter* Victim, bool bActive)
+{
+	Victim->SetActorHiddenInGame(!bActive);
+	Victim->SetActorEnableCollision(bActive);
+
+	// Pooled victims shouldn't animate or fall, and shouldn't be woken up by anything.
+	TInlineComponentArray<USkeletalMeshComponent*> Meshes(Victim);
+	for (USkeletalMeshComponent* Mesh : Meshes)
+	{
+		Mesh->SetComponentTickEnabled(bActive);
+	}
+
+	UCharacterMovementComponent* Movement = Victim->GetCharacterMovement();
+	if (bActive)
+	{
+		Movement->SetComponentTickEnabled(true);
+		Movement->SetMovementMode(MOVE_Walking);
+	}
+	else
+	{
+		Movement->StopMovementImmediately();
+		Movement->DisableMovement();
+		Movement->SetComponentTickEnabled(false);
+	}
+}
+
+bool AMainGameMode::IsVictimHeld(const ACharacter* Victim) const
+{
+	// A snake biting a victim holds it with a constraint, don't pull it out from under the snake.
+	for (TActorIterator<APhysicsConstraintActor> It(GetWorld()); It; ++It)
+	{
+		UPrimitiveComponent* FirstComponent, * SecondComponent;
+		FName FirstBone, SecondBone;
+		It->GetConstraintComp()->GetConstrainedComponents(FirstComponent, FirstBone, SecondComponent, SecondBone);
+
+		if ((FirstComponent && FirstComponent->GetOwner() == Victim) || (SecondComponent && SecondComponent->GetOwner() == Victim))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void AMainGameMode::UpdateVictimPool()
+{
+	const UVictimAIManager* Manager = GetWorld()->GetSubsystem<UVictimAIManager>();
+	if (!Manager)
+	{
+		return;
+	}
+
+	RagdolledVictims = 0;
+	LiveVictimBodies = 0;
+
+	TArray<AVictimAIController*, TInlineAllocator<16>> SettledVictims;
+	for (AVictimAIController* VictimController : Manager->GetVictims())
+	{
+		const ACharacter* Victim = VictimController ? VictimController->GetPawn<ACharacter>() : nullptr;
+		if (!Victim)
+		{
+			continue;
+		}
+
+		const USkeletalMeshComponent* Mesh = Victim->GetMesh();
+		if (!Mesh->IsSimulatingPhysics())
+		{
+			VictimController->RagdollSettledTime = 0.0f;
+			continue;
+		}
+
+		++RagdolledVictims;
+		for (const FBodyInstance* Body : Mesh->Bodies)
+		{
+			if (Body && Body->IsInstanceSimulatingPhysics())
+			{
+				++LiveVictimBodies;
+			}
+		}
+
+		// Knocked out victims have settled once their ragdoll has been slow for long enough.
+		if (Mesh->GetPhysicsLinearVelocity().SizeSquared() > FMath::Square(VictimSettleSpeed))
+		{
+			VictimController->RagdollSettledTime = 0.0f;
+			continue;
+		}
+
+		VictimController->RagdollSettledTime += VictimPoolScanInterval;
+		if (VictimController->RagdollSettledTime >= VictimSettleTime && !IsVictimHeld(Victim))
+		{
+			SettledVictims.Add(VictimController);
+		}
+	}
+
+	// Released separately, pooling a victim takes it out of the manager's list.
+	for (AVictimAIController* VictimController : SettledVictims)
+	{
+		ReleaseVictim(VictimController);
+	}
+
+	SET_DWORD_STAT(STAT_VictimPoolSize, VictimPool.Num());
+	SET_DWORD_STAT(STAT_RagdolledVictims, RagdolledVictims);
+	SET_DWORD_STAT(STAT_LiveVictimBodies, LiveVictimBodies);
+}
+
+void AMainGameMode::VictimPoolStats()
+{
+	const int32 Requests = VictimPoolHits + VictimPoolMisses;
+	const float HitRate = Requests > 0 ? (100.0f * VictimPoolHits) / Requests : 0.0f;
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Victim pool: %d pooled, %d hits, %d misses (%.1f%% hit rate), %d ragdolled victims, %d live bodies"),
+		VictimPool.Num(), VictimPoolHits, VictimPoolMisses, HitRate, RagdolledVictims, LiveVictimBodies);
+}
+
+void AMainGameMode::VictimAIStats()
+{
+	if (const UVictimAIManager* Manager = GetWorld()->GetSubsystem<UVictimAIManager>())
+	{
+		UE_LOG(LogHoopSnake, Display, TEXT("Victim AI: %d victims, manager tick %.3f ms"), Manager->GetNumVictims(), Manager->GetAverageTickMilliseconds());
+	}
+}
+
+void AMainGameMode::BenchProximity(int32 NumQueries, float Radius)
+{
+	if (const UProximityGridSubsystem* ProximityGrid = GetWorld()->GetSubsystem<UProximityGridSubsystem>())
+	{
+		ProximityGrid->RunBenchmark(NumQueries, Radius);
+	}
+}
+
+void AMainGameMode::BenchBodyChanges(int32 Iterations)
+{
+	if (const ACharacter* Snake = Cast<ACharacter>(UGameplayStatics::GetPlayerPawn(this, 0)))
+	{
+		UCustomBlueprintFunctionLibrary::BenchmarkPhysicsBodyChanges(Snake->GetMesh(), Iterations);
+	}
+}
+
+void AMainGameMode::InputLatencyStats()
+{
+	if (USnakeInputLatencyTracker* Tracker = GetWorld()->GetSubsystem<USnakeInputLatencyTracker>())
+	{
+		Tracker->LogStats();
+	}
+}
+
+void AMainGameMode::SnakeMemory()
+{
+	FSnakeMemoryFootprint Total;
+	int32 NumSnakes = 0;
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Snake memory, in KB:"));
+	for (TActorIterator<AHoopSnakeCharacter> It(GetWorld()); It; ++It)
+	{
+		const FSnakeMemoryFootprint Footprint = It->GetMemoryFootprint();
+		UE_LOG(LogHoopSnake, Display, TEXT("  %-32s components %8.1f (%d)  anim %8.1f  bodies %8.1f (%d)  snapshots %6.1f  total %8.1f"),
+			*It->GetName(), Footprint.Components / 1024.0, Footprint.NumComponents, Footprint.AnimInstance / 1024.0,
+			Footprint.PhysicsBodies / 1024.0, Footprint.NumBodies, Footprint.PoseSnapshots / 1024.0, Footprint.GetTotal() / 1024.0);
+
+		Total.Components += Footprint.Components;
+		Total.AnimInstance += Footprint.AnimInstance;
+		Total.PhysicsBodies += Footprint.PhysicsBodies;
+		Total.PoseSnapshots += Footprint.PoseSnapshots;
+		++NumSnakes;
+	}
+
+	UE_LOG(LogHoopSnake, Display, TEXT("  %d snakes: components %.1f  anim %.1f  bodies %.1f  snapshots %.1f  total %.1f"),
+		NumSnakes, Total.Components / 1024.0, Total.AnimInstance / 1024.0, Total.PhysicsBodies / 1024.0, Total.PoseSnapshots / 1024.0, Total.GetTotal() / 1024.0);
+
+	if (const USnakeKillcamRecorder* Recorder = GetWorld()->GetSubsystem<USnakeKillcamRecorder>())
+	{
+		UE_LOG(LogHoopSnake, Display, TEXT("  Killcam buffers: %.1f"), Recorder->GetBufferBytes() / 1024.0);
+	}
+}
+
+void AMainGameMode::OcclusionStats()
+{
+	if (const USnakeOcclusionSubsystem* Occlusion = GetWorld()->GetSubsystem<USnakeOcclusionSubsystem>())
+	{
+		Occlusion->LogStats();
+	}
+}
+
+void AMainGameMode::BenchObstacles(int32 Multiplier, int32 FramesPerRun)
+{
+	if (USnakeObstacleSubsystem* ObstacleSubsystem = GetWorld()->GetSubsystem<USnakeObstacleSubsystem>())
+	{
+		ObstacleSubsystem->RunBenchmark(FMath::Max(Multiplier, 1), FramesPerRun);
+	}
+}
+
+void AMainGameMode::ResetWorld()
+{
+	const double StartTime = FPlatformTime::Seconds();
+	RestoreWorldSnapshot();
+
+	UE_LOG(LogHoopSnake, Display, TEXT("World reset in %.2f ms"), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+void AMainGameMode::BenchReset(int32 Iterations)
+{
+	Iterations = FMath::Max(Iterations, 1);
+
+	double TotalTime = 0.0;
+	double WorstTime = 0.0;
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		RestoreWorldSnapshot();
+
+		const double Time = FPlatformTime::Seconds() - StartTime;
+		TotalTime += Time;
+		WorstTime = FMath::Max(WorstTime, Time);
+	}
+
+	UE_LOG(LogHoopSnake, Display, TEXT("World reset, %d iterations:"), Iterations);
+	UE_LOG(LogHoopSnake, Display, TEXT("  average           %8.2f ms"), TotalTime / Iterations * 1000.0);
+	UE_LOG(LogHoopSnake, Display, TEXT("  worst             %8.2f ms"), WorstTime * 1000.0);
+	UE_LOG(LogHoopSnake, Display, TEXT("  snakes %d, victims %d, physics props %d, constraints %d"), SnapshotSnakes.Num(), SnapshotVictims.Num(), SnapshotPhysicsActors.Num(), SnapshotConstraints.Num());
+}
+
+void AMainGameMode::BenchReload()
+{
+	if (UMainGameInstance* GameInstance = GetGameInstance<UMainGameInstance>())
+	{
+		GameInstance->ReloadLevelTimed();
+	}
+}
+
+void AMainGameMode::SnakeSim(float SimSeconds, int32 NumSnakes, int32 NumVictims, const FString& Overrides)
+{
+	StartSnakeSim(SimSeconds, NumSnakes, NumVictims, Overrides, false);
+}
+
+void AMainGameMode::StartSnakeSim(float SimSeconds, int32 NumSnakes, int32 NumVictims, const FString& Overrides, bool bExitWhenDone)
+{
+	USnakeSimulationSubsystem* Simulation = GetWorld()->GetSubsystem<USnakeSimulationSubsystem>();
+	if (!Simulation)
+	{
+		return;
+	}
+
+	// Without victims there is nothing to bite, and the report would record a bite rate of zero as if it were a result.
+	if (NumVictims > 0 && !VictimClass)
+	{
+		UE_LOG(LogHoopSnake, Error, TEXT("StartSnakeSim needs a victim class to spawn %d victims. Set VictimClass under [/Script/HoopSnake.MainGameMode] in DefaultGame.ini."), NumVictims);
+		if (bExitWhenDone)
+		{
+			FPlatformMisc::RequestExitWithStatus(false, 1);
+		}
+		return;
+	}
+
+	// AI snakes run the hoop, attack and bite cycle on their own, and the victim pool keeps bringing victims back for them.
+	SpawnVictims(NumVictims);
+	SpawnSnakes(NumSnakes);
+
+	Simulation->StartSimulation(SimSeconds, Overrides, bExitWhenDone);
+}
+
+void AMainGameMode::CaptureWorldSnapshot(ULevel* Level)
+{
+	if (!Level)
+	{
+		return;
+	}
+
+	for (AActor* Actor : Level->Actors)
+	{
+		if (!IsValid(Actor) || SnapshotActors.Contains(Actor))
+		{
+			continue;
+		}
+
+		const ACharacter* Character = Cast<ACharacter>(Actor);
+		UPrimitiveComponent* RootPrimitive = Cast<UPrimitiveComponent>(Actor->GetRootComponent());
+		APhysicsConstraintActor* ConstraintActor = Cast<APhysicsConstraintActor>(Actor);
+
+		if (Cast<AHoopSnakeCharacter>(Actor))
+		{
+			SnapshotSnakes.Add({ Actor, Actor->GetActorTransform() });
+		}
+		// Victims may not have been possessed yet, so go by the controller they will get.
+		else if (Character && Character->AIControllerClass && Character->AIControllerClass->IsChildOf<AVictimAIController>())
+		{
+			SnapshotVictims.Add({ Actor, Actor->GetActorTransform() });
+		}
+		else if (RootPrimitive && RootPrimitive->IsSimulatingPhysics())
+		{
+			SnapshotPhysicsActors.Add({ Actor, Actor->GetActorTransform(), !RootPrimitive->RigidBodyIsAwake() });
+		}
+		else if (ConstraintActor && ConstraintActor->GetConstraintComp())
+		{
+			SnapshotConstraints.Add({ ConstraintActor->GetConstraintComp(), ConstraintActor->GetConstraintComp()->IsBroken() });
+		}
+		else
+		{
+			continue;
+		}
+
+		SnapshotActors.Add(Actor);
+	}
+}
+
+void AMainGameMode::OnLevelAddedToWorld(ULevel* Level, UWorld* InWorld)
+{
+	if (InWorld == GetWorld())
+	{
+		CaptureWorldSnapshot(Level);
+	}
+}
+
+void AMainGameMode::OnLevelRemovedFromWorld(ULevel* Level, UWorld* InWorld)
+{
+	if (InWorld != GetWorld())
+	{
+		return;
+	}
+
+	// The level's actors aren't garbage collected yet, so go by the level they were in as well. A null level means every level is going.
+	auto IsGone = [Level](const AActor* Actor) { return !IsValid(Actor) || !Level || Actor->GetLevel() == Level; };
+
+	for (auto It = SnapshotActors.CreateIterator(); It; ++It)
+	{
+		if (IsGone(It->Get()))
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	auto IsSnapshotGone = [&IsGone](const FSnakeActorSnapshot& Snapshot) { return IsGone(Snapshot.Actor.Get()); };
+	SnapshotSnakes.RemoveAll(IsSnapshotGone);
+	SnapshotVictims.RemoveAll(IsSnapshotGone);
+	SnapshotPhysicsActors.RemoveAll(IsSnapshotGone);
+	SnapshotConstraints.RemoveAll([&IsGone](const FSnakeConstraintSnapshot& Snapshot)
+	{
+		const UPhysicsConstraintComponent* Constraint = Snapshot.Constraint.Get();
+		return !Constraint || IsGone(Constraint->GetOwner());
+	});
+}
+
+void AMainGameMode::RestoreWorldSnapshot()
+{
+	// Benchmark snakes go with everything else spawned since the snapshot.
+	StopSnakeBenchmark();
+
+	// The killcam's ghosts would play over the restored world, and a pending one would start after it.
+	if (USnakeKillcamRecorder* Killcam = GetWorld()->GetSubsystem<USnakeKillcamRecorder>())
+	{
+		Killcam->StopKillcam();
+	}
+
+	// Pending victim respawns would bring pooled victims back on top of the restored ones.
+	GetWorldTimerManager().ClearAllTimersForObject(this);
+	if (bPoolVictims)
+	{
+		GetWorldTimerManager().SetTimer(VictimPoolTimerHandle, this, &AMainGameMode::UpdateVictimPool, VictimPoolScanInterval, true);
+	}
+	VictimPool.Reset();
+
+	// Bite constraints, and anything else holding bodies together that the level didn't start with.
+	for (TActorIterator<APhysicsConstraintActor> It(GetWorld()); It; ++It)
+	{
+		if (!SnapshotActors.Contains(*It))
+		{
+			It->Destroy();
+		}
+	}
+
+	// Snakes and victims spawned since, along with their controllers. The players' own pawns are always kept.
+	for (TActorIterator<ACharacter> It(GetWorld()); It; ++It)
+	{
+		ACharacter* Character = *It;
+		if (SnapshotActors.Contains(Character) || Character->IsPlayerControlled())
+		{
+			continue;
+		}
+
+		if (Cast<AHoopSnakeCharacter>(Character) || Cast<AVictimAIController>(Character->GetController()))
+		{
+			if (AController* CharacterController = Character->GetController())
+			{
+				CharacterController->Destroy();
+			}
+			Character->Destroy();
+		}
+	}
+
+	for (const FSnakeActorSnapshot& Snapshot : SnapshotSnakes)
+	{
+		if (AHoopSnakeCharacter* Snake = Cast<AHoopSnakeCharacter>(Snapshot.Actor.Get()))
+		{
+			Snake->RestoreToTransform(Snapshot.Transform);
+
+			// Otherwise an AI snake carries on attacking or recovering from wherever it was.
+			if (ASnakeAIController* SnakeController = Cast<ASnakeAIController>(Snake->GetController()))
+			{
+				SnakeController->ResetState();
+			}
+		}
+	}
+
+	// The same steps as taking a victim out of the pool, at the place it started.
+	for (const FSnakeActorSnapshot& Snapshot : SnapshotVictims)
+	{
+		ACharacter* Victim = Cast<ACharacter>(Snapshot.Actor.Get());
+		if (!Victim)
+		{
+			continue;
+		}
+
+		ResetVictimRagdoll(Victim);
+		Victim->SetActorTransform(Snapshot.Transform, false, nullptr, ETeleportType::ResetPhysics);
+		SetVictimActive(Victim, true);
+
+		if (AVictimAIController* VictimController = Cast<AVictimAIController>(Victim->GetController()))
+		{
+			VictimController->SetPooled(false);
+			VictimController->StopMovement();
+			VictimController->ResetAwareness();
+		}
+	}
+
+	// Props are put back at rest, and asleep again if they started that way so they don't all simulate until they settle.
+	for (const FSnakeActorSnapshot& Snapshot : SnapshotPhysicsActors)
+	{
+		AActor* Actor = Snapshot.Actor.Get();
+		UPrimitiveComponent* RootPrimitive = Actor ? Cast<UPrimitiveComponent>(Actor->GetRootComponent()) : nullptr;
+		if (!RootPrimitive)
+		{
+			continue;
+		}
+
+		Actor->SetActorTransform(Snapshot.Transform, false, nullptr, ETeleportType::ResetPhysics);
+		RootPrimitive->SetAllPhysicsLinearVelocity(FVector::ZeroVector);
+		RootPrimitive->SetAllPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+
+		if (Snapshot.bAsleep)
+		{
+			RootPrimitive->PutAllRigidBodiesToSleep();
+		}
+	}
+
+	// Joints that broke during the run are made again.
+	for (const FSnakeConstraintSnapshot& Snapshot : SnapshotConstraints)
+	{
+		UPhysicsConstraintComponent* Constraint = Snapshot.Constraint.Get();
+		if (Constraint && Constraint->IsBroken() && !Snapshot.bBroken)
+		{
+			Constraint->TermComponentConstraint();
+			Constraint->InitComponentConstraint();
+		}
+	}
+
+	// Clear every player's HUD, a snake that wasn't theirs may have pushed something.
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		AHUD* HUD = PlayerController ? PlayerController->GetHUD() : nullptr;
+		if (HUD && HUD->GetClass()->ImplementsInterface(UHUDInterface::StaticClass()))
+		{
+			IHUDInterface::Execute_PopAllWidgets(HUD);
+		}
+	}
+}
+
+void AMainGameMode::SnakePhysicsProfile(FName Preset, float SecondsPerPreset)
+{
+	if (USnakePhysicsProfiler* Profiler = GetWorld()->GetSubsystem<USnakePhysicsProfiler>())
+	{
+		Profiler->StartProfiling(Preset, SecondsPerPreset);
+	}
+}
+
+void AMainGameMode::SnakePhysicsProfileStop()
+{
+	if (USnakePhysicsProfiler* Profiler = GetWorld()->GetSubsystem<USnakePhysicsProfiler>())
+	{
+		Profiler->StopProfiling();
+	}
+}
+
+AHoopSnakeCharacter* AMainGameMode::SpawnAISnake(const FVector& Origin)
+{
+	TSubclassOf<AHoopSnakeCharacter> ClassToSpawn = SnakeClass;
+	if (!ClassToSpawn && DefaultPawnClass && DefaultPawnClass->IsChildOf(AHoopSnakeCharacter::StaticClass()))
+	{
+		ClassToSpawn = *DefaultPawnClass;
+	}
+
+	if (!ClassToSpawn)
+	{
+		return nullptr;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	const FVector2D Offset = FMath::RandPointInCircle(SnakeSpawnRadius);
+	const FVector Location = Origin + FVector(Offset.X, Offset.Y, 100.0f);
+	const FRotator Rotation(0.0f, FMath::FRandRange(0.0f, 360.0f), 0.0f);
+
+	LLM_SCOPE_BYTAG(HoopSnake_Snakes);
+	AHoopSnakeCharacter* Snake = GetWorld()->SpawnActor<AHoopSnakeCharacter>(ClassToSpawn, Location, Rotation, SpawnParams);
+	if (Snake)
+	{
+		// Uses the snake's AI controller class, so it plays itself.
+		if (!Snake->GetController())
+		{
+			Snake->SpawnDefaultController();
+		}
+
+		if (bPrewarmSnakes)
+		{
+			PrewarmSnake(Snake);
+		}
+	}
+
+	return Snake;
+}
+
+void AMainGameMode::SpawnSnakes(int32 Count)
+{
+	const FVector Origin = GetStressTestOrigin();
+
+	int32 NumSpawned = 0;
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		if (SpawnAISnake(Origin))
+		{
+			++NumSpawned;
+		}
+	}
+
+	if (NumSpawned < Count)
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("SpawnSnakes spawned %d of %d snakes. Is a snake class set?"), NumSpawned, Count);
+	}
+}
+
+void AMainGameMode::BenchSnakes(int32 MaxSnakes, int32 Step, float SecondsPerStep)
+{
+	StopSnakeBenchmark();
+
+	BenchMaxSnakes = FMath::Max(MaxSnakes, 1);
+	BenchStep = FMath::Clamp(Step, 1, BenchMaxSnakes);
+	BenchSecondsPerStep = FMath::Max(SecondsPerStep, 0.5f);
+
+	// Sample the world as it is first, so every step can be compared against no extra snakes.
+	BenchStepTime = 0.0;
+	BenchTotalFrameTime = 0.0;
+	BenchWorstFrameTime = 0.0;
+	BenchFrameCount = 0;
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Snake benchmark: up to %d snakes, %d at a time, %.1fs per step"), BenchMaxSnakes, BenchStep, BenchSecondsPerStep);
+
+	BenchTickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &AMainGameMode::TickSnakeBenchmark));
+}
+
+bool AMainGameMode::TickSnakeBenchmark(float DeltaTime)
+{
+	BenchStepTime += DeltaTime;
+
+	// Skip the frames right after spawning, they include spawning and loading rather than the snakes' running cost.
+	if (BenchStepTime > 0.5)
+	{
+		BenchTotalFrameTime += DeltaTime;
+		BenchWorstFrameTime = FMath::Max(BenchWorstFrameTime, (double)DeltaTime);
+		++BenchFrameCount;
+	}
+
+	if (BenchStepTime < BenchSecondsPerStep)
+	{
+		return true;
+	}
+
+	const int32 NumSnakes = BenchSnakeList.Num();
+	const double AverageMilliseconds = BenchFrameCount > 0 ? (BenchTotalFrameTime / BenchFrameCount) * 1000.0 : 0.0;
+	UE_LOG(LogHoopSnake, Display, TEXT("Snake benchmark: %3d snakes, avg frame %.2f ms, worst frame %.2f ms, %d frames"), NumSnakes, AverageMilliseconds, BenchWorstFrameTime * 1000.0, BenchFrameCount);
+
+	if (NumSnakes >= BenchMaxSnakes)
+	{
+		UE_LOG(LogHoopSnake, Display, TEXT("Snake benchmark finished"));
+		BenchTickHandle.Reset();
+		StopSnakeBenchmark();
+		return false;
+	}
+
+	// Next step.
+	const FVector Origin = GetStressTestOrigin();
+	const int32 NumToSpawn = FMath::Min(BenchStep, BenchMaxSnakes - NumSnakes);
+	for (int32 Index = 0; Index < NumToSpawn; ++Index)
+	{
+		// Count failed spawns too, so a missing snake class can't stall the benchmark.
+		BenchSnakeList.Add(SpawnAISnake(Origin));
+	}
+
+	BenchStepTime = 0.0;
+	BenchTotalFrameTime = 0.0;
+	BenchWorstFrameTime = 0.0;
+	BenchFrameCount = 0;
+
+	return true;
+}
+
+void AMainGameMode::SimulateFrameBudget(float BaseMilliseconds, float PeakMilliseconds, int32 NumFrames)
+{
+	if (const USnakeScalabilitySubsystem* Scalability = GetWorld()->GetSubsystem<USnakeScalabilitySubsystem>())
+	{
+		Scalability->RunSyntheticFrames(BaseMilliseconds, PeakMilliseconds, FMath::Max(NumFrames, 1));
+	}
+}
+
+void AMainGameMode::Killcam()
+{
+	if (USnakeKillcamRecorder* Recorder = GetWorld()->GetSubsystem<USnakeKillcamRecorder>())
+	{
+		Recorder->PlayKillcam();
+	}
+}
+
+void AMainGameMode::BenchSnakeTick(int32 FramesPerRun)
+{
+	StopSnakeBenchmark();
+
+	IConsoleVariable* BatchedTick = IConsoleManager::Get().FindConsoleVariable(TEXT("hoopsnake.BatchedTick"));
+	if (!BatchedTick || !GetWorld()->GetSubsystem<USnakeTickSubsystem>())
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("BenchSnakeTick: snake tick subsystem not available"));
+		return;
+	}
+
+	BenchSavedBatchedTick = BatchedTick->GetString();
+	BenchFramesPerRun = FMath::Max(FramesPerRun, 10);
+	BenchTickRun = 0;
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Snake tick benchmark: %d frames per run"), BenchFramesPerRun);
+
+	BeginSnakeTickRun();
+	BenchTickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &AMainGameMode::TickSnakeTickBenchmark));
+}
+
+void AMainGameMode::BeginSnakeTickRun()
+{
+	const int32 TargetSnakes = SnakeTickBenchCounts[BenchTickRun / 2];
+	const bool bBatched = BenchTickRun % 2 == 1;
+
+	// Snakes already in the world count towards the target, so the player's own snake is part of the first run.
+	const USnakeTickSubsystem* SnakeTick = GetWorld()->GetSubsystem<USnakeTickSubsystem>();
+	const FVector Origin = GetStressTestOrigin();
+	const int32 NumToSpawn = TargetSnakes - SnakeTick->GetNumSnakes();
+	for (int32 Index = 0; Index < NumToSpawn; ++Index)
+	{
+		BenchSnakeList.Add(SpawnAISnake(Origin));
+	}
+
+	// The subsystem follows the variable from its next tick.
+	if (IConsoleVariable* BatchedTick = IConsoleManager::Get().FindConsoleVariable(TEXT("hoopsnake.BatchedTick")))
+	{
+		BatchedTick->Set(bBatched ? TEXT("1") : TEXT("0"), ECVF_SetByCode);
+	}
+
+	BenchStepTime = 0.0;
+	BenchTotalFrameTime = 0.0;
+	BenchWorstFrameTime = 0.0;
+	BenchFrameCount = 0;
+}
+
+bool AMainGameMode::TickSnakeTickBenchmark(float DeltaTime)
+{
+	const USnakeTickSubsystem* SnakeTick = GetWorld()->GetSubsystem<USnakeTickSubsystem>();
+	if (!SnakeTick)
+	{
+		BenchTickHandle.Reset();
+		StopSnakeBenchmark();
+		return false;
+	}
+
+	BenchStepTime += DeltaTime;
+
+	// Skip the frames right after spawning and switching tick paths.
+	if (BenchStepTime > 0.5)
+	{
+		const double ActorTickMilliseconds = SnakeTick->GetLastActorTickMilliseconds();
+		BenchTotalFrameTime += ActorTickMilliseconds;
+		BenchWorstFrameTime = FMath::Max(BenchWorstFrameTime, ActorTickMilliseconds);
+		++BenchFrameCount;
+	}
+
+	if (BenchFrameCount < BenchFramesPerRun)
+	{
+		return true;
+	}
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Snake tick benchmark: %3d snakes, %-9s avg actor tick %.3f ms, worst %.3f ms"),
+		SnakeTick->GetNumSnakes(), SnakeTick->IsBatching() ? TEXT("batched,") : TEXT("per actor,"), BenchTotalFrameTime / BenchFrameCount, BenchWorstFrameTime);
+
+	++BenchTickRun;
+	if (BenchTickRun >= (int32)UE_ARRAY_COUNT(SnakeTickBenchCounts) * 2)
+	{
+		UE_LOG(LogHoopSnake, Display, TEXT("Snake tick benchmark finished"));
+		BenchTickHandle.Reset();
+		StopSnakeBenchmark();
+		return false;
+	}
+
+	BeginSnakeTickRun();
+	return true;
+}
+
+void AMainGameMode::StopSnakeBenchmark()
+{
+	if (BenchTickHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(BenchTickHandle);
+		BenchTickHandle.Reset();
+	}
+
+	if (!BenchSavedBatchedTick.IsEmpty())
+	{
+		if (IConsoleVariable* BatchedTick = IConsoleManager::Get().FindConsoleVariable(TEXT("hoopsnake.BatchedTick")))
+		{
+			BatchedTick->Set(*BenchSavedBatchedTick, ECVF_SetByCode);
+		}
+		BenchSavedBatchedTick.Reset();
+	}
+
+	for (const TWeakObjectPtr<AHoopSnakeCharacter>& Snake : BenchSnakeList)
+	{
+		if (Snake.IsValid())
+		{
+			if (AController* SnakeController = Snake->GetController())
+			{
+				SnakeController->Destroy();
+			}
+
+			Snake->Destroy();
+		}
+	}
+
+	BenchSnakeList.Reset();
+}
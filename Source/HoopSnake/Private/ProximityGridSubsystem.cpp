@@ -0,0 +1,251 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProximityGridSubsystem.h"
+#include "HoopSnake.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Proximity Grid Update"), STAT_ProximityGridUpdate, STATGROUP_HoopSnake);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Proximity Grid Entries"), STAT_ProximityGridEntries, STATGROUP_HoopSnake);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Proximity Grid Cell Moves"), STAT_ProximityGridCellMoves, STATGROUP_HoopSnake);
+
+UProximityGridSubsystem::UProximityGridSubsystem()
+{
+	CellSize = 1000.0f;
+}
+
+void UProximityGridSubsystem::Deinitialize()
+{
+	TArray<TWeakObjectPtr<AActor>> Tracked;
+	ActorToEntry.GenerateKeyArray(Tracked);
+	for (const TWeakObjectPtr<AActor>& Actor : Tracked)
+	{
+		Unregister(Actor.Get());
+	}
+
+	Entries.Empty();
+	FreeEntries.Empty();
+	ActorToEntry.Empty();
+	Cells.Empty();
+
+	Super::Deinitialize();
+}
+
+FIntVector UProximityGridSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt32(Location.X / CellSize),
+		FMath::FloorToInt32(Location.Y / CellSize),
+		FMath::FloorToInt32(Location.Z / CellSize));
+}
+
+void UProximityGridSubsystem::Register(AActor* Actor, EProximityKind Kind)
+{
+	USceneComponent* Root = Actor ? Actor->GetRootComponent() : nullptr;
+	if (!Root || ActorToEntry.Contains(Actor))
+	{
+		return;
+	}
+
+	const int32 EntryIndex = FreeEntries.IsEmpty() ? Entries.AddDefaulted() : FreeEntries.Pop(EAllowShrinking::No);
+
+	FEntry& Entry = Entries[EntryIndex];
+	Entry.Actor = Actor;
+	Entry.Location = Actor->GetActorLocation();
+	Entry.Cell = GetCell(Entry.Location);
+	Entry.Kind = Kind;
+	Entry.Root = Root;
+	Entry.MovedHandle = Root->TransformUpdated.AddUObject(this, &UProximityGridSubsystem::OnEntryMoved, EntryIndex);
+
+	Actor->OnEndPlay.AddUniqueDynamic(this, &UProximityGridSubsystem::OnTrackedActorEndPlay);
+
+	Cells.FindOrAdd(Entry.Cell).Add(EntryIndex);
+	ActorToEntry.Add(Actor, EntryIndex);
+	SET_DWORD_STAT(STAT_ProximityGridEntries, ActorToEntry.Num());
+}
+
+void UProximityGridSubsystem::Unregister(AActor* Actor)
+{
+	int32 EntryIndex = INDEX_NONE;
+	if (!ActorToEntry.RemoveAndCopyValue(Actor, EntryIndex))
+	{
+		return;
+	}
+
+	FEntry& Entry = Entries[EntryIndex];
+	if (USceneComponent* Root = Entry.Root.Get())
+	{
+		Root->TransformUpdated.Remove(Entry.MovedHandle);
+	}
+	if (Actor)
+	{
+		Actor->OnEndPlay.RemoveDynamic(this, &UProximityGridSubsystem::OnTrackedActorEndPlay);
+	}
+
+	RemoveFromCell(EntryIndex);
+	Entry = FEntry();
+	FreeEntries.Add(EntryIndex);
+	SET_DWORD_STAT(STAT_ProximityGridEntries, ActorToEntry.Num());
+}
+
+void UProximityGridSubsystem::OnTrackedActorEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason)
+{
+	Unregister(Actor);
+}
+
+void UProximityGridSubsystem::RemoveFromCell(int32 EntryIndex)
+{
+	if (TArray<int32>* CellEntries = Cells.Find(Entries[EntryIndex].Cell))
+	{
+		CellEntries->RemoveSingleSwap(EntryIndex, EAllowShrinking::No);
+	}
+}
+
+void UProximityGridSubsystem::OnEntryMoved(USceneComponent* Root, EUpdateTransformFlags UpdateFlags, ETeleportType Teleport, int32 EntryIndex)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProximityGridUpdate);
+
+	FEntry& Entry = Entries[EntryIndex];
+	Entry.Location = Root->GetComponentLocation();
+
+	// Only touch the cell lists when the actor actually crosses a cell boundary.
+	const FIntVector NewCell = GetCell(Entry.Location);
+	if (NewCell != Entry.Cell)
+	{
+		RemoveFromCell(EntryIndex);
+		Entry.Cell = NewCell;
+		Cells.FindOrAdd(NewCell).Add(EntryIndex);
+		INC_DWORD_STAT(STAT_ProximityGridCellMoves);
+	}
+}
+
+void UProximityGridSubsystem::ForEachInRadius(const FVector& Center, float Radius, EProximityKind KindMask, TFunctionRef<void(AActor* Actor, const FVector& Location, float DistanceSquared)> Func) const
+{
+	const FIntVector MinCell = GetCell(Center - FVector(Radius));
+	const FIntVector MaxCell = GetCell(Center + FVector(Radius));
+	const float RadiusSquared = FMath::Square(Radius);
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+			{
+				const TArray<int32>* CellEntries = Cells.Find(FIntVector(X, Y, Z));
+				if (!CellEntries)
+				{
+					continue;
+				}
+
+				for (const int32 EntryIndex : *CellEntries)
+				{
+					const FEntry& Entry = Entries[EntryIndex];
+					if (!EnumHasAnyFlags(Entry.Kind, KindMask))
+					{
+						continue;
+					}
+
+					const float DistanceSquared = FVector::DistSquared(Center, Entry.Location);
+					if (DistanceSquared <= RadiusSquared)
+					{
+						if (AActor* Actor = Entry.Actor.Get())
+						{
+							Func(Actor, Entry.Location, DistanceSquared);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void UProximityGridSubsystem::ForEachInCone(const FVector& Origin, const FVector& Direction, float Radius, float HalfAngleDegrees, EProximityKind KindMask, TFunctionRef<void(AActor* Actor, const FVector& Location, float DistanceSquared)> Func) const
+{
+	const FVector ConeDirection = Direction.GetSafeNormal();
+	const float CosHalfAngle = FMath::Cos(FMath::DegreesToRadians(HalfAngleDegrees));
+
+	ForEachInRadius(Origin, Radius, KindMask, [&](AActor* Actor, const FVector& Location, float DistanceSquared)
+	{
+		// Inside the cone when the angle to the target is within the half angle. Compared without normalising the offset.
+		const float Along = FVector::DotProduct(Location - Origin, ConeDirection);
+		if (Along >= 0.0f && FMath::Square(Along) >= FMath::Square(CosHalfAngle) * DistanceSquared)
+		{
+			Func(Actor, Location, DistanceSquared);
+		}
+	});
+}
+
+AActor* UProximityGridSubsystem::FindNearest(const FVector& Center, float Radius, EProximityKind KindMask, float* OutDistance) const
+{
+	AActor* Nearest = nullptr;
+	float NearestDistanceSquared = TNumericLimits<float>::Max();
+
+	ForEachInRadius(Center, Radius, KindMask, [&](AActor* Actor, const FVector& Location, float DistanceSquared)
+	{
+		if (DistanceSquared < NearestDistanceSquared)
+		{
+			NearestDistanceSquared = DistanceSquared;
+			Nearest = Actor;
+		}
+	});
+
+	if (OutDistance)
+	{
+		*OutDistance = Nearest ? FMath::Sqrt(NearestDistanceSquared) : 0.0f;
+	}
+
+	return Nearest;
+}
+
+void UProximityGridSubsystem::RunBenchmark(int32 NumQueries, float Radius) const
+{
+	// Query around the tracked actors themselves, so both methods see the same spread of results. Free slots are left out, they sit at the origin.
+	TArray<FVector> ActorLocations;
+	ActorLocations.Reserve(ActorToEntry.Num());
+	for (const TPair<TWeakObjectPtr<AActor>, int32>& Pair : ActorToEntry)
+	{
+		if (Pair.Key.IsValid())
+		{
+			ActorLocations.Add(Entries[Pair.Value].Location);
+		}
+	}
+
+	if (ActorLocations.IsEmpty() || NumQueries <= 0)
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Proximity benchmark needs registered actors and at least one query."));
+		return;
+	}
+
+	TArray<FVector> QueryLocations;
+	QueryLocations.Reserve(NumQueries);
+	for (int32 Index = 0; Index < NumQueries; ++Index)
+	{
+		QueryLocations.Add(ActorLocations[Index % ActorLocations.Num()]);
+	}
+
+	int32 GridResults = 0;
+	const double GridStart = FPlatformTime::Seconds();
+	for (const FVector& Location : QueryLocations)
+	{
+		ForEachInRadius(Location, Radius, EProximityKind::All, [&GridResults](AActor*, const FVector&, float) { ++GridResults; });
+	}
+	const double GridSeconds = FPlatformTime::Seconds() - GridStart;
+
+	int32 OverlapResults = 0;
+	TArray<FOverlapResult> Overlaps;
+	Overlaps.Reserve(256);
+	const FCollisionShape Sphere = FCollisionShape::MakeSphere(Radius);
+	const double OverlapStart = FPlatformTime::Seconds();
+	for (const FVector& Location : QueryLocations)
+	{
+		Overlaps.Reset();
+		GetWorld()->OverlapMultiByChannel(Overlaps, Location, FQuat::Identity, ECollisionChannel::ECC_Pawn, Sphere);
+		OverlapResults += Overlaps.Num();
+	}
+	const double OverlapSeconds = FPlatformTime::Seconds() - OverlapStart;
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Proximity benchmark: %d actors, %d queries, radius %.0f"), ActorLocations.Num(), NumQueries, Radius);
+	UE_LOG(LogHoopSnake, Display, TEXT("  Grid:    %.3f us/query, %d results"), GridSeconds * 1e6 / NumQueries, GridResults);
+	UE_LOG(LogHoopSnake, Display, TEXT("  Overlap: %.3f us/query, %d results"), OverlapSeconds * 1e6 / NumQueries, OverlapResults);
+}
@@ -0,0 +1,172 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeAIController.h"
+#include "HoopSnakeCharacter.h"
+#include "ProximityGridSubsystem.h"
+#include "InputActionValue.h"
+#include "Components/SkeletalMeshComponent.h"
+
+ASnakeAIController::ASnakeAIController()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	SeekRadius = 5000.0f;
+	AttackRange = 600.0f;
+	MaxRollTime = 6.0f;
+	AttackTimeout = 2.0f;
+	RecoverDelay = 3.0f;
+
+	SnakeState = ESnakeAIState::Seeking;
+	StateTime = 0.0f;
+	bResetRequested = false;
+	Snake = nullptr;
+}
+
+void ASnakeAIController::OnPossess(APawn* InPawn)
+{
+	Super::OnPossess(InPawn);
+
+	Snake = Cast<AHoopSnakeCharacter>(InPawn);
+	SetSnakeState(ESnakeAIState::Seeking);
+}
+
+void ASnakeAIController::OnUnPossess()
+{
+	Snake = nullptr;
+	Target.Reset();
+	ClearFocus(EAIFocusPriority::Gameplay);
+
+	Super::OnUnPossess();
+}
+
+void ASnakeAIController::SetSnakeState(ESnakeAIState NewState)
+{
+	SnakeState = NewState;
+	StateTime = 0.0f;
+	bResetRequested = false;
+}
+
+void ASnakeAIController::ResetState()
+{
+	StopMovement();
+	ClearFocus(EAIFocusPriority::Gameplay);
+	Target.Reset();
+	SetSnakeState(ESnakeAIState::Seeking);
+}
+
+AActor* ASnakeAIController::FindTarget()
+{
+	AActor* NewTarget = nullptr;
+	if (const UProximityGridSubsystem* ProximityGrid = GetWorld()->GetSubsystem<UProximityGridSubsystem>())
+	{
+		NewTarget = ProximityGrid->FindNearest(Snake->GetActorLocation(), SeekRadius, EProximityKind::Victim);
+	}
+
+	Target = NewTarget;
+
+	// Focusing sets the control rotation, which the snake follows with its yaw, so this also steers the hoop.
+	if (NewTarget)
+	{
+		SetFocus(NewTarget, EAIFocusPriority::Gameplay);
+	}
+	else
+	{
+		ClearFocus(EAIFocusPriority::Gameplay);
+	}
+
+	return NewTarget;
+}
+
+void ASnakeAIController::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (!Snake)
+	{
+		return;
+	}
+
+	StateTime += DeltaSeconds;
+
+	const bool bRagdolling = Snake->GetMesh()->IsSimulatingPhysics();
+
+	switch (SnakeState)
+	{
+	case ESnakeAIState::Seeking:
+		// A forced ragdoll can happen in any state, wait it out before doing anything else.
+		if (bRagdolling)
+		{
+			SetSnakeState(ESnakeAIState::Recovering);
+		}
+		else if (FindTarget())
+		{
+			Snake->ToggleHoop(FInputActionValue(true));
+
+			if (Snake->IsHoopModeEnabled())
+			{
+				SetSnakeState(ESnakeAIState::Rolling);
+			}
+		}
+		else
+		{
+			// Nothing to chase, slither forward until something comes into range.
+			Snake->Move(FInputActionValue(FVector2D(0.0f, 1.0f)));
+		}
+		break;
+
+	case ESnakeAIState::Rolling:
+		if (!Snake->IsHoopModeEnabled())
+		{
+			// Knocked out of hoop mode, probably by hitting a wall.
+			SetSnakeState(bRagdolling ? ESnakeAIState::Recovering : ESnakeAIState::Seeking);
+		}
+		else if (!Target.IsValid() && !FindTarget())
+		{
+			// Lost the target with nothing else around, attack where we're headed anyway.
+			Snake->ToggleHoop(FInputActionValue(true));
+			SetSnakeState(ESnakeAIState::Attacking);
+		}
+		else if (StateTime >= MaxRollTime || FVector::DistSquared(Snake->GetActorLocation(), Target->GetActorLocation()) <= FMath::Square(AttackRange))
+		{
+			// Toggling hoop mode off queues the attack, the animation triggers it.
+			Snake->ToggleHoop(FInputActionValue(true));
+			SetSnakeState(ESnakeAIState::Attacking);
+		}
+		break;
+
+	case ESnakeAIState::Attacking:
+		if (bRagdolling)
+		{
+			SetSnakeState(ESnakeAIState::Recovering);
+		}
+		else if (StateTime >= AttackTimeout)
+		{
+			// The animation never got round to triggering the attack, e.g. because the snake isn't rendered. Fire it ourselves,
+			// otherwise the snake stays in hoop mode with the attack queued and seeking would only queue it again.
+			if (Snake->IsAttackQueued())
+			{
+				ICharacterAnimationInterface::Execute_TriggerAttack(Snake);
+			}
+
+			SetSnakeState(Snake->GetMesh()->IsSimulatingPhysics() ? ESnakeAIState::Recovering : ESnakeAIState::Seeking);
+		}
+		break;
+
+	case ESnakeAIState::Recovering:
+		if (!bRagdolling)
+		{
+			if (bResetRequested || StateTime >= RecoverDelay)
+			{
+				SetSnakeState(ESnakeAIState::Seeking);
+			}
+		}
+		else if (!bResetRequested && StateTime >= RecoverDelay)
+		{
+			// Reset runs on timers, so only ask once.
+			Snake->Reset();
+			bResetRequested = true;
+		}
+		break;
+	}
+}
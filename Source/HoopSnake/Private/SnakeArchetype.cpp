@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeArchetype.h"
+#include "InputMappingContext.h"
+#include "InputAction.h"
+#include "Engine/StaticMesh.h"
+#include "NiagaraSystem.h"
+#include "Sound/SoundCue.h"
+#include "PhysicsEngine/PhysicsConstraintActor.h"
+
+const FPrimaryAssetType USnakeArchetype::PrimaryAssetType = TEXT("SnakeArchetype");
+const FName USnakeArchetype::CoreBundle = TEXT("Core");
+const FName USnakeArchetype::CombatBundle = TEXT("Combat");
+
+USnakeArchetype::USnakeArchetype()
+{
+	DefaultMappingContext = TSoftObjectPtr<UInputMappingContext>(FSoftObjectPath(TEXT("/Game/HoopSnake/Input/IMC_Main.IMC_Main")));
+	MoveAction = TSoftObjectPtr<UInputAction>(FSoftObjectPath(TEXT("/Game/HoopSnake/Input/Actions/Move.Move")));
+	LookAction = TSoftObjectPtr<UInputAction>(FSoftObjectPath(TEXT("/Game/HoopSnake/Input/Actions/Look.Look")));
+	HoopAction = TSoftObjectPtr<UInputAction>(FSoftObjectPath(TEXT("/Game/HoopSnake/Input/Actions/HoopToggle.HoopToggle")));
+	ResetAction = TSoftObjectPtr<UInputAction>(FSoftObjectPath(TEXT("/Game/HoopSnake/Input/Actions/Reset.Reset")));
+	PauseAction = TSoftObjectPtr<UInputAction>(FSoftObjectPath(TEXT("/Game/HoopSnake/Input/Actions/Pause.Pause")));
+
+	UpperJawMesh = TSoftObjectPtr<UStaticMesh>(FSoftObjectPath(TEXT("/Game/HoopSnake/Models/UpperJaw.UpperJaw")));
+	LowerJawMesh = TSoftObjectPtr<UStaticMesh>(FSoftObjectPath(TEXT("/Game/HoopSnake/Models/LowerJaw.LowerJaw")));
+	SpeedLineSystem = TSoftObjectPtr<UNiagaraSystem>(FSoftObjectPath(TEXT("/Game/HoopSnake/Effects/NS_Speedlines.NS_Speedlines")));
+
+	WhooshSound = TSoftObjectPtr<USoundCue>(FSoftObjectPath(TEXT("/Game/HoopSnake/Audio/SC_Whoosh.SC_Whoosh")));
+	HissSound = TSoftObjectPtr<USoundCue>(FSoftObjectPath(TEXT("/Game/HoopSnake/Audio/SC_Hiss.SC_Hiss")));
+	ImpactSound = TSoftObjectPtr<USoundCue>(FSoftObjectPath(TEXT("/Game/HoopSnake/Audio/SC_Impact.SC_Impact")));
+	BiteSound = TSoftObjectPtr<USoundCue>(FSoftObjectPath(TEXT("/Game/HoopSnake/Audio/SC_Bite.SC_Bite")));
+	BiteConstraintClass = TSoftClassPtr<APhysicsConstraintActor>(FSoftObjectPath(TEXT("/Game/HoopSnake/Blueprints/BP_BiteConstraint.BP_BiteConstraint_C")));
+}
+
+FPrimaryAssetId USnakeArchetype::GetPrimaryAssetId() const
+{
+	return FPrimaryAssetId(PrimaryAssetType, GetFName());
+}
+
+void USnakeArchetype::GetBundleAssets(FName Bundle, TArray<FSoftObjectPath>& OutAssets) const
+{
+	// Keep in step with the AssetBundles metadata on the properties.
+	if (Bundle == CoreBundle)
+	{
+		OutAssets.Append({ DefaultMappingContext.ToSoftObjectPath(), MoveAction.ToSoftObjectPath(), LookAction.ToSoftObjectPath(), HoopAction.ToSoftObjectPath(),
+			ResetAction.ToSoftObjectPath(), PauseAction.ToSoftObjectPath(), UpperJawMesh.ToSoftObjectPath(), LowerJawMesh.ToSoftObjectPath(), SpeedLineSystem.ToSoftObjectPath() });
+	}
+	else if (Bundle == CombatBundle)
+	{
+		OutAssets.Append({ WhooshSound.ToSoftObjectPath(), HissSound.ToSoftObjectPath(), ImpactSound.ToSoftObjectPath(), BiteSound.ToSoftObjectPath(), BiteConstraintClass.ToSoftObjectPath() });
+	}
+
+	OutAssets.RemoveAll([](const FSoftObjectPath& Path) { return Path.IsNull(); });
+}
@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeCameraBoomComponent.h"
+#include "Camera/CameraComponent.h"
+#include "HoopSnake.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Camera Boom Moves"), STAT_CameraBoomMoves, STATGROUP_HoopSnake);
+
+bool FSnakeCameraState::Interpolate(const FSnakeCameraTargets& Targets, float DeltaTime, float InterpSpeed, float Tolerance)
+{
+	const bool bWasConverged = bConverged;
+
+	FieldOfView = FMath::FInterpTo(FieldOfView, Targets.FieldOfView, DeltaTime, InterpSpeed);
+	ArmLength = FMath::FInterpTo(ArmLength, Targets.ArmLength, DeltaTime, InterpSpeed);
+	SocketOffset = FMath::VInterpTo(SocketOffset, Targets.SocketOffset, DeltaTime, InterpSpeed);
+
+	bConverged = FMath::IsNearlyEqual(FieldOfView, Targets.FieldOfView, Tolerance)
+		&& FMath::IsNearlyEqual(ArmLength, Targets.ArmLength, Tolerance)
+		&& SocketOffset.Equals(Targets.SocketOffset, Tolerance);
+
+	// Snap the last little bit so the values stop creeping towards the target forever.
+	if (bConverged)
+	{
+		FieldOfView = Targets.FieldOfView;
+		ArmLength = Targets.ArmLength;
+		SocketOffset = Targets.SocketOffset;
+	}
+
+	return !(bConverged && bWasConverged);
+}
+
+USnakeCameraBoomComponent::USnakeCameraBoomComponent()
+{
+	ConvergenceTolerance = 0.01f;
+	bCameraStateInitialised = false;
+}
+
+const FSnakeCameraState& USnakeCameraBoomComponent::GetCameraState(const UCameraComponent* Camera)
+{
+	if (!bCameraStateInitialised)
+	{
+		CameraState.FieldOfView = Camera ? Camera->FieldOfView : CameraState.FieldOfView;
+		CameraState.ArmLength = TargetArmLength;
+		CameraState.SocketOffset = SocketOffset;
+		CameraState.bConverged = false;
+		bCameraStateInitialised = true;
+	}
+
+	return CameraState;
+}
+
+void USnakeCameraBoomComponent::UpdateCamera(const FSnakeCameraTargets& Targets, float DeltaTime, float InterpSpeed, UCameraComponent* Camera, const FTransform& ParentSocketTransform)
+{
+	FSnakeCameraState NewState = GetCameraState(Camera);
+	NewState.Interpolate(Targets, DeltaTime, InterpSpeed, ConvergenceTolerance);
+
+	ApplyCameraState(NewState, Targets, Camera, ParentSocketTransform);
+}
+
+void USnakeCameraBoomComponent::ApplyCameraState(const FSnakeCameraState& NewState, const FSnakeCameraTargets& Targets, UCameraComponent* Camera, const FTransform& ParentSocketTransform)
+{
+	GetCameraState(Camera);
+
+	// Nothing to write while both the old and new states are sitting on their targets.
+	if (!(NewState.bConverged && CameraState.bConverged))
+	{
+		if (Camera && Camera->FieldOfView != NewState.FieldOfView)
+		{
+			Camera->SetFieldOfView(NewState.FieldOfView);
+		}
+
+		TargetArmLength = NewState.ArmLength;
+		SocketOffset = NewState.SocketOffset;
+	}
+
+	CameraState = NewState;
+
+	ApplyBoomLocation(Targets, ParentSocketTransform);
+}
+
+void USnakeCameraBoomComponent::ApplyBoomLocation(const FSnakeCameraTargets& Targets, const FTransform& ParentSocketTransform)
+{
+	/* World space targets are turned into a location relative to the socket the boom is attached to, so that moving it
+	 * is always a single relative location update rather than a reset followed by a world location update. */
+	const FVector NewRelativeLocation = Targets.bBoomLocationIsWorld ? ParentSocketTransform.InverseTransformPosition(Targets.BoomLocation) : Targets.BoomLocation;
+
+	if (!GetRelativeLocation().Equals(NewRelativeLocation, ConvergenceTolerance))
+	{
+		SetRelativeLocation(NewRelativeLocation);
+		INC_DWORD_STAT(STAT_CameraBoomMoves);
+	}
+}
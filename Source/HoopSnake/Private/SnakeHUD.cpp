@@ -0,0 +1,389 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeHUD.h"
+#include "CommonActivatableWidget.h"
+#include "Widgets/CommonActivatableWidgetContainer.h"
+#include "Blueprint/UserWidget.h"
+#include "Blueprint/WidgetTree.h"
+#include "Components/InvalidationBox.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/LocalPlayer.h"
+#include "Engine/GameViewportClient.h"
+#include "Engine/Texture2D.h"
+#include "SceneView.h"
+#include "Widgets/SLeafWidget.h"
+#include "Rendering/DrawElements.h"
+#include "VictimAIManager.h"
+#include "VictimAIController.h"
+#include "HoopSnake.h"
+
+DECLARE_CYCLE_STAT(TEXT("Victim Alert Overlay Paint"), STAT_SnakeAlertOverlayPaint, STATGROUP_HoopSnake);
+DECLARE_DWORD_COUNTER_STAT(TEXT("HUD Widgets Created"), STAT_SnakeHUDWidgetsCreated, STATGROUP_HoopSnake);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Victim Alert Icons Drawn"), STAT_SnakeAlertIconsDrawn, STATGROUP_HoopSnake);
+
+/** A victim that is alert or panicked, and where its icon goes */
+struct FVictimAlertEntry
+{
+	FVector Location;
+	EVictimAlertState State;
+};
+
+/**
+ * Draws every victim's alert icon in one paint. Icons are projected from world space with the camera the HUD last saw,
+ * culled when behind the camera, off screen or too far away, and faded out with distance.
+ */
+class SVictimAlertOverlay : public SLeafWidget
+{
+public:
+	SLATE_BEGIN_ARGS(SVictimAlertOverlay)
+		: _AlertBrush(nullptr)
+		, _PanicBrush(nullptr)
+		, _IconSize(FVector2D::ZeroVector)
+		, _FadeStartDistance(0.0f)
+		, _MaxDistance(0.0f)
+		{}
+		SLATE_ARGUMENT(const FSlateBrush*, AlertBrush)
+		SLATE_ARGUMENT(const FSlateBrush*, PanicBrush)
+		SLATE_ARGUMENT(FVector2D, IconSize)
+		SLATE_ARGUMENT(float, FadeStartDistance)
+		SLATE_ARGUMENT(float, MaxDistance)
+	SLATE_END_ARGS()
+
+	void Construct(const FArguments& InArgs)
+	{
+		AlertBrush = InArgs._AlertBrush;
+		PanicBrush = InArgs._PanicBrush;
+		IconSize = InArgs._IconSize;
+		FadeStartDistance = InArgs._FadeStartDistance;
+		MaxDistance = InArgs._MaxDistance;
+
+		// Never hit tested, and painted every frame since the icons move with the camera.
+		SetVisibility(EVisibility::HitTestInvisible);
+		SetCanTick(false);
+		ForceVolatile(true);
+	}
+
+	/** Entries are reset and refilled each frame, so the array's memory is reused */
+	TArray<FVictimAlertEntry> Entries;
+
+	FMatrix ViewProjection = FMatrix::Identity;
+	FVector ViewOrigin = FVector::ZeroVector;
+
+	virtual FVector2D ComputeDesiredSize(float LayoutScaleMultiplier) const override
+	{
+		return FVector2D::ZeroVector;
+	}
+
+	virtual int32 OnPaint(const FPaintArgs& Args, const FGeometry& AllottedGeometry, const FSlateRect& MyCullingRect, FSlateWindowElementList& OutDrawElements, int32 LayerId, const FWidgetStyle& InWidgetStyle, bool bParentEnabled) const override
+	{
+		SCOPE_CYCLE_COUNTER(STAT_SnakeAlertOverlayPaint);
+
+		const FVector2D ScreenSize = AllottedGeometry.GetLocalSize();
+		const FVector2D HalfIcon = IconSize * 0.5f;
+		const float MaxDistanceSquared = FMath::Square(MaxDistance);
+		int32 NumDrawn = 0;
+
+		for (const FVictimAlertEntry& Entry : Entries)
+		{
+			const double DistanceSquared = FVector::DistSquared(Entry.Location, ViewOrigin);
+			if (DistanceSquared > MaxDistanceSquared)
+			{
+				continue;
+			}
+
+			// Behind the camera
+			const FVector4 Clip = ViewProjection.TransformFVector4(FVector4(Entry.Location, 1.0f));
+			if (Clip.W <= UE_KINDA_SMALL_NUMBER)
+			{
+				continue;
+			}
+
+			const FVector2D ScreenPosition(
+				(Clip.X / Clip.W * 0.5f + 0.5f) * ScreenSize.X,
+				(0.5f - Clip.Y / Clip.W * 0.5f) * ScreenSize.Y);
+
+			// Off screen, allowing for half an icon hanging over the edge
+			if (ScreenPosition.X < -HalfIcon.X || ScreenPosition.Y < -HalfIcon.Y || ScreenPosition.X > ScreenSize.X + HalfIcon.X || ScreenPosition.Y > ScreenSize.Y + HalfIcon.Y)
+			{
+				continue;
+			}
+
+			const FSlateBrush* Brush = Entry.State == EVictimAlertState::Panicked ? PanicBrush : AlertBrush;
+			if (!Brush)
+			{
+				continue;
+			}
+
+			const float Distance = FMath::Sqrt(DistanceSquared);
+			const float Opacity = 1.0f - FMath::Clamp((Distance - FadeStartDistance) / FMath::Max(MaxDistance - FadeStartDistance, 1.0f), 0.0f, 1.0f);
+			const FLinearColor Tint = Brush->GetTint(InWidgetStyle) * InWidgetStyle.GetColorAndOpacityTint() * FLinearColor(1.0f, 1.0f, 1.0f, Opacity);
+
+			FSlateDrawElement::MakeBox(OutDrawElements, LayerId, AllottedGeometry.ToPaintGeometry(IconSize, FSlateLayoutTransform(ScreenPosition - HalfIcon)), Brush, ESlateDrawEffect::None, Tint);
+			++NumDrawn;
+		}
+
+		SET_DWORD_STAT(STAT_SnakeAlertIconsDrawn, NumDrawn);
+		return LayerId;
+	}
+
+private:
+	const FSlateBrush* AlertBrush = nullptr;
+	const FSlateBrush* PanicBrush = nullptr;
+	FVector2D IconSize;
+	float FadeStartDistance = 0.0f;
+	float MaxDistance = 0.0f;
+};
+
+ASnakeHUD::ASnakeHUD()
+{
+	LayoutClass = FSoftClassPath(TEXT("/Game/HoopSnake/UI/WBP_UIBase.WBP_UIBase_C"));
+	StackName = "UIStack";
+	CrosshairClass = FSoftClassPath(TEXT("/Game/HoopSnake/UI/WBP_Crosshair.WBP_Crosshair_C"));
+	FadeToBlackClass = FSoftClassPath(TEXT("/Game/HoopSnake/UI/WBP_ScreenFadeTransition.WBP_ScreenFadeTransition_C"));
+	PauseMenuClass = FSoftClassPath(TEXT("/Game/HoopSnake/UI/WBP_PauseMenu.WBP_PauseMenu_C"));
+	bCacheLayout = true;
+
+	bShowVictimAlerts = true;
+	AlertIconTexture = FSoftObjectPath(TEXT("/Game/HoopSnake/UI/AlertIcon.AlertIcon"));
+	PanicIconTexture = FSoftObjectPath(TEXT("/Game/HoopSnake/UI/OhShitIcon.OhShitIcon"));
+	AlertIconSize = 64.0f;
+	AlertIconHeight = 120.0f;
+	AlertFadeStartDistance = 2000.0f;
+	AlertMaxDistance = 4000.0f;
+	LoadedAlertIcon = nullptr;
+	LoadedPanicIcon = nullptr;
+
+	Layout = nullptr;
+	Stack = nullptr;
+	LoadedCrosshairClass = nullptr;
+	LoadedFadeToBlackClass = nullptr;
+	LoadedPauseMenuClass = nullptr;
+	bPrewarmed = false;
+	WidgetsCreatedSincePrewarm = 0;
+}
+
+void ASnakeHUD::BeginPlay()
+{
+	Super::BeginPlay();
+
+	LoadedCrosshairClass = CrosshairClass.TryLoadClass<UCommonActivatableWidget>();
+	LoadedFadeToBlackClass = FadeToBlackClass.TryLoadClass<UCommonActivatableWidget>();
+	LoadedPauseMenuClass = PauseMenuClass.TryLoadClass<UCommonActivatableWidget>();
+
+	CreateLayout();
+	CreateAlertOverlay();
+}
+
+void ASnakeHUD::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (Layout)
+	{
+		Layout->RemoveFromParent();
+	}
+
+	if (AlertOverlay.IsValid())
+	{
+		UGameViewportClient* ViewportClient = GetWorld()->GetGameViewport();
+		if (ViewportClient && PlayerOwner)
+		{
+			ViewportClient->RemoveViewportWidgetForPlayer(PlayerOwner->GetLocalPlayer(), AlertOverlay.ToSharedRef());
+		}
+		AlertOverlay.Reset();
+	}
+
+	Layout = nullptr;
+	Stack = nullptr;
+	KnownWidgets.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ASnakeHUD::CreateLayout()
+{
+	if (Layout || !PlayerOwner || !PlayerOwner->IsLocalController())
+	{
+		return;
+	}
+
+	UClass* Class = LayoutClass.TryLoadClass<UCommonActivatableWidget>();
+	Layout = Class ? CreateWidget<UCommonActivatableWidget>(PlayerOwner, Class) : nullptr;
+	if (!Layout)
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("HUD: couldn't create layout %s"), *LayoutClass.ToString());
+		return;
+	}
+
+	Stack = Cast<UCommonActivatableWidgetContainerBase>(Layout->GetWidgetFromName(StackName));
+	if (!Stack)
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("HUD: layout %s has no activatable widget stack called %s"), *GetNameSafe(Class), *StackName.ToString());
+	}
+
+	// Widgets on the stack mostly sit still, so paint them from a cache. Animated ones are volatile and still repaint every frame.
+	// Has to be done before the layout's Slate widgets are built, which happens when it is added to the viewport.
+	if (bCacheLayout && Layout->WidgetTree && Layout->WidgetTree->RootWidget)
+	{
+		UInvalidationBox* InvalidationBox = Layout->WidgetTree->ConstructWidget<UInvalidationBox>(UInvalidationBox::StaticClass(), TEXT("LayoutCache"));
+		UWidget* Root = Layout->WidgetTree->RootWidget;
+		Layout->WidgetTree->RootWidget = InvalidationBox;
+		InvalidationBox->AddChild(Root);
+	}
+
+	Layout->AddToViewport();
+}
+
+void ASnakeHUD::CreateAlertOverlay()
+{
+	if (!bShowVictimAlerts || AlertOverlay.IsValid() || !PlayerOwner || !PlayerOwner->GetLocalPlayer())
+	{
+		return;
+	}
+
+	UGameViewportClient* ViewportClient = GetWorld()->GetGameViewport();
+	if (!ViewportClient)
+	{
+		return;
+	}
+
+	LoadedAlertIcon = Cast<UTexture2D>(AlertIconTexture.TryLoad());
+	LoadedPanicIcon = Cast<UTexture2D>(PanicIconTexture.TryLoad());
+
+	AlertBrush.SetResourceObject(LoadedAlertIcon);
+	AlertBrush.ImageSize = FVector2D(AlertIconSize);
+	PanicBrush.SetResourceObject(LoadedPanicIcon);
+	PanicBrush.ImageSize = FVector2D(AlertIconSize);
+
+	AlertOverlay = SNew(SVictimAlertOverlay)
+		.AlertBrush(LoadedAlertIcon ? &AlertBrush : nullptr)
+		.PanicBrush(LoadedPanicIcon ? &PanicBrush : nullptr)
+		.IconSize(FVector2D(AlertIconSize))
+		.FadeStartDistance(AlertFadeStartDistance)
+		.MaxDistance(AlertMaxDistance);
+
+	// Below the layout, so menus and the fade cover the icons.
+	ViewportClient->AddViewportWidgetForPlayer(PlayerOwner->GetLocalPlayer(), AlertOverlay.ToSharedRef(), -1);
+}
+
+void ASnakeHUD::DrawHUD()
+{
+	Super::DrawHUD();
+
+	UpdateAlertOverlay();
+}
+
+void ASnakeHUD::UpdateAlertOverlay()
+{
+	if (!AlertOverlay.IsValid())
+	{
+		return;
+	}
+
+	AlertOverlay->Entries.Reset();
+
+	// The camera this frame was rendered from, so icons line up with the victims they belong to.
+	ULocalPlayer* LocalPlayer = PlayerOwner ? PlayerOwner->GetLocalPlayer() : nullptr;
+	FSceneViewProjectionData ProjectionData;
+	if (!LocalPlayer || !LocalPlayer->ViewportClient || !LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, ProjectionData))
+	{
+		return;
+	}
+
+	AlertOverlay->ViewProjection = ProjectionData.ComputeViewProjectionMatrix();
+	AlertOverlay->ViewOrigin = ProjectionData.ViewOrigin;
+
+	const UVictimAIManager* Manager = GetWorld()->GetSubsystem<UVictimAIManager>();
+	if (!Manager)
+	{
+		return;
+	}
+
+	// Calm victims don't get an icon, so only the alerted few make it into the overlay's list.
+	for (const AVictimAIController* Victim : Manager->GetVictims())
+	{
+		const APawn* VictimPawn = Victim ? Victim->GetPawn() : nullptr;
+		if (VictimPawn && Victim->GetAlertState() != EVictimAlertState::Calm)
+		{
+			AlertOverlay->Entries.Add({ VictimPawn->GetActorLocation() + FVector(0.0f, 0.0f, AlertIconHeight), Victim->GetAlertState() });
+		}
+	}
+}
+
+UCommonActivatableWidget* ASnakeHUD::PushWidget(UClass* WidgetClass)
+{
+	if (!Stack || !WidgetClass)
+	{
+		return nullptr;
+	}
+
+	UCommonActivatableWidget* Widget = Stack->AddWidget(WidgetClass);
+
+	// The stack only makes a new widget when none of that class is waiting in its pool.
+	if (Widget && !KnownWidgets.Contains(Widget))
+	{
+		KnownWidgets.Add(Widget);
+		INC_DWORD_STAT(STAT_SnakeHUDWidgetsCreated);
+
+		if (bPrewarmed)
+		{
+			++WidgetsCreatedSincePrewarm;
+			UE_LOG(LogHoopSnake, Verbose, TEXT("HUD: created %s after prewarming"), *WidgetClass->GetName());
+		}
+	}
+
+	return Widget;
+}
+
+void ASnakeHUD::PushCrosshair_Implementation()
+{
+	PushWidget(LoadedCrosshairClass);
+}
+
+void ASnakeHUD::PushFadeToBlack_Implementation()
+{
+	PushWidget(LoadedFadeToBlackClass);
+}
+
+void ASnakeHUD::PushPauseMenu_Implementation()
+{
+	PushWidget(LoadedPauseMenuClass);
+}
+
+void ASnakeHUD::PopWidget_Implementation()
+{
+	// Removing a widget deactivates it and returns it to the stack's pool once it has transitioned out.
+	if (Stack)
+	{
+		if (UCommonActivatableWidget* ActiveWidget = Stack->GetActiveWidget())
+		{
+			Stack->RemoveWidget(*ActiveWidget);
+		}
+	}
+}
+
+void ASnakeHUD::PopAllWidgets_Implementation()
+{
+	if (Stack)
+	{
+		Stack->ClearWidgets();
+	}
+}
+
+void ASnakeHUD::PrewarmWidgets_Implementation()
+{
+	CreateLayout();
+
+	if (!Stack || bPrewarmed)
+	{
+		return;
+	}
+
+	// One of each is enough, the stack never shows two of the same widget at once.
+	PushWidget(LoadedCrosshairClass);
+	PushWidget(LoadedFadeToBlackClass);
+	PushWidget(LoadedPauseMenuClass);
+	Stack->ClearWidgets();
+
+	bPrewarmed = true;
+	UE_LOG(LogHoopSnake, Log, TEXT("HUD: prewarmed %d widgets"), KnownWidgets.Num());
+}
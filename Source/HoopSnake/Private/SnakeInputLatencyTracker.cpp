@@ -0,0 +1,255 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeInputLatencyTracker.h"
+#include "Framework/Application/SlateApplication.h"
+#include "Framework/Application/IInputProcessor.h"
+#include "Rendering/SlateRenderer.h"
+#include "Misc/ScopeLock.h"
+#include "RenderingThread.h"
+#include "HoopSnake.h"
+
+DECLARE_CYCLE_STAT(TEXT("Input Latency Tracker"), STAT_SnakeInputLatency, STATGROUP_HoopSnake);
+
+static TAutoConsoleVariable<bool> CVarSnakeInputLatency(
+	TEXT("hoopsnake.InputLatency"),
+	false,
+	TEXT("Time the player's actions from input through to the presented frame. Results are logged by the InputLatencyStats command."));
+
+/** Samples that never reach an effect, such as an attack whose animation window didn't come, are dropped after this long */
+static constexpr double SnakeInputLatencyTimeout = 2.0;
+
+/** Notes when Slate receives input, before Enhanced Input sees it. Never consumes anything. */
+class FSnakeInputLatencyProcessor : public IInputProcessor
+{
+public:
+	FSnakeInputLatencyProcessor(USnakeInputLatencyTracker* InTracker)
+		: Tracker(InTracker)
+	{
+	}
+
+	virtual void Tick(const float DeltaTime, FSlateApplication& SlateApp, TSharedRef<ICursor> Cursor) override {}
+
+	virtual bool HandleKeyDownEvent(FSlateApplication& SlateApp, const FKeyEvent& InKeyEvent) override
+	{
+		// Held keys repeat, only the first press starts an action.
+		if (!InKeyEvent.IsRepeat())
+		{
+			Note(false);
+		}
+		return false;
+	}
+
+	virtual bool HandleMouseButtonDownEvent(FSlateApplication& SlateApp, const FPointerEvent& MouseEvent) override
+	{
+		Note(false);
+		return false;
+	}
+
+	// Mouse movement and sticks arrive every frame while held, so they're kept apart from presses or they'd hide when a button went down.
+	virtual bool HandleMouseMoveEvent(FSlateApplication& SlateApp, const FPointerEvent& MouseEvent) override
+	{
+		Note(true);
+		return false;
+	}
+
+	virtual bool HandleAnalogInputEvent(FSlateApplication& SlateApp, const FAnalogInputEvent& InAnalogInputEvent) override
+	{
+		Note(true);
+		return false;
+	}
+
+	virtual const TCHAR* GetDebugName() const override { return TEXT("SnakeInputLatency"); }
+
+private:
+	void Note(bool bAxisInput)
+	{
+		if (USnakeInputLatencyTracker* TrackerPtr = Tracker.Get())
+		{
+			TrackerPtr->OnInputReceived(bAxisInput);
+		}
+	}
+
+	TWeakObjectPtr<USnakeInputLatencyTracker> Tracker;
+};
+
+USnakeInputLatencyTracker::USnakeInputLatencyTracker()
+{
+	LastButtonInputTime = 0.0;
+	LastAxisInputTime = 0.0;
+	LastTickTime = 0.0;
+	bCanSeePresent = false;
+}
+
+bool USnakeInputLatencyTracker::IsTracking()
+{
+	return CVarSnakeInputLatency.GetValueOnGameThread();
+}
+
+void USnakeInputLatencyTracker::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (!FSlateApplication::IsInitialized())
+	{
+		return;
+	}
+
+	InputProcessor = MakeShared<FSnakeInputLatencyProcessor>(this);
+	FSlateApplication::Get().RegisterInputPreProcessor(InputProcessor, 0);
+
+	// There is no renderer under -nullrhi, samples finish when their effect happens instead.
+	if (FSlateRenderer* Renderer = FSlateApplication::Get().GetRenderer())
+	{
+		BackBufferHandle = Renderer->OnBackBufferReadyToPresent().AddUObject(this, &USnakeInputLatencyTracker::OnBackBufferReadyToPresent);
+		bCanSeePresent = true;
+	}
+}
+
+void USnakeInputLatencyTracker::Deinitialize()
+{
+	if (FSlateApplication::IsInitialized())
+	{
+		if (InputProcessor)
+		{
+			FSlateApplication::Get().UnregisterInputPreProcessor(InputProcessor);
+		}
+
+		if (FSlateRenderer* Renderer = FSlateApplication::Get().GetRenderer())
+		{
+			Renderer->OnBackBufferReadyToPresent().Remove(BackBufferHandle);
+		}
+	}
+
+	// The render thread may be partway through the callback.
+	FlushRenderingCommands();
+
+	InputProcessor.Reset();
+	Pending.Empty();
+
+	Super::Deinitialize();
+}
+
+TStatId USnakeInputLatencyTracker::GetStatId() const
+{
+	return GET_STATID(STAT_SnakeInputLatency);
+}
+
+void USnakeInputLatencyTracker::OnBackBufferReadyToPresent(SWindow& Window, const FTextureRHIRef& BackBuffer)
+{
+	// The render thread's frame number is the game frame it is drawing.
+	const double Now = FPlatformTime::Seconds();
+
+	FScopeLock Lock(&PresentedFramesLock);
+	PresentedFrames.Emplace(GFrameNumberRenderThread, Now);
+}
+
+void USnakeInputLatencyTracker::MarkHandled(FName Action, bool bAxisInput)
+{
+	if (!IsTracking() || Pending.ContainsByPredicate([Action](const FSnakeInputLatencySample& Sample) { return Sample.Action == Action; }))
+	{
+		return;
+	}
+
+	FSnakeInputLatencySample& Sample = Pending.AddDefaulted_GetRef();
+	Sample.Action = Action;
+	Sample.HandledTime = FPlatformTime::Seconds();
+
+	// Input from an earlier frame belongs to something else, so this action's input is only known if it came in since the last tick.
+	const double LastInputTime = bAxisInput ? LastAxisInputTime : LastButtonInputTime;
+	Sample.InputTime = LastInputTime > LastTickTime ? LastInputTime : Sample.HandledTime;
+}
+
+void USnakeInputLatencyTracker::MarkEffect(FName Action)
+{
+	for (int32 Index = 0; Index < Pending.Num(); ++Index)
+	{
+		FSnakeInputLatencySample& Sample = Pending[Index];
+		if (Sample.Action != Action || Sample.EffectFrame != 0)
+		{
+			continue;
+		}
+
+		Sample.EffectTime = FPlatformTime::Seconds();
+		Sample.EffectFrame = GFrameNumber;
+
+		if (!bCanSeePresent)
+		{
+			CompleteSample(Sample, Sample.EffectTime);
+			Pending.RemoveAtSwap(Index);
+		}
+		return;
+	}
+}
+
+void USnakeInputLatencyTracker::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SnakeInputLatency);
+
+	const double Now = FPlatformTime::Seconds();
+	LastTickTime = Now;
+
+	TArray<TPair<uint32, double>> Presented;
+	{
+		FScopeLock Lock(&PresentedFramesLock);
+		Presented = MoveTemp(PresentedFrames);
+		PresentedFrames.Reset();
+	}
+
+	for (int32 Index = Pending.Num() - 1; Index >= 0; --Index)
+	{
+		const FSnakeInputLatencySample& Sample = Pending[Index];
+
+		if (Sample.EffectFrame != 0)
+		{
+			// The first frame presented that includes the effect's frame.
+			const TPair<uint32, double>* Frame = Presented.FindByPredicate([&Sample](const TPair<uint32, double>& Entry) { return Entry.Key >= Sample.EffectFrame; });
+			if (Frame)
+			{
+				CompleteSample(Sample, Frame->Value);
+				Pending.RemoveAtSwap(Index);
+			}
+		}
+		else if (Now - Sample.HandledTime > SnakeInputLatencyTimeout)
+		{
+			UE_LOG(LogHoopSnake, Verbose, TEXT("Input latency: %s was handled but had no effect, dropping it"), *Sample.Action.ToString());
+			Pending.RemoveAtSwap(Index);
+		}
+	}
+}
+
+void USnakeInputLatencyTracker::CompleteSample(const FSnakeInputLatencySample& Sample, double PresentTime)
+{
+	FSnakeInputLatencyTotals& Total = Totals.FindOrAdd(Sample.Action);
+	++Total.Count;
+	Total.InputToHandled += Sample.HandledTime - Sample.InputTime;
+	Total.HandledToEffect += Sample.EffectTime - Sample.HandledTime;
+	Total.EffectToPresent += PresentTime - Sample.EffectTime;
+	Total.InputToPresent += PresentTime - Sample.InputTime;
+	Total.WorstInputToPresent = FMath::Max(Total.WorstInputToPresent, PresentTime - Sample.InputTime);
+
+	UE_LOG(LogHoopSnake, Verbose, TEXT("Input latency: %s %.2f ms input to screen (%.2f handled, %.2f effect, %.2f present)"),
+		*Sample.Action.ToString(), (PresentTime - Sample.InputTime) * 1000.0, (Sample.HandledTime - Sample.InputTime) * 1000.0,
+		(Sample.EffectTime - Sample.HandledTime) * 1000.0, (PresentTime - Sample.EffectTime) * 1000.0);
+}
+
+void USnakeInputLatencyTracker::LogStats()
+{
+	if (Totals.IsEmpty())
+	{
+		UE_LOG(LogHoopSnake, Display, TEXT("Input latency: nothing recorded. Turn on hoopsnake.InputLatency and play for a while first."));
+		return;
+	}
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Input latency, averages in ms%s:"), bCanSeePresent ? TEXT("") : TEXT(" (no renderer, present stage not measured)"));
+	for (const TPair<FName, FSnakeInputLatencyTotals>& Entry : Totals)
+	{
+		const FSnakeInputLatencyTotals& Total = Entry.Value;
+		const double Scale = 1000.0 / Total.Count;
+		UE_LOG(LogHoopSnake, Display, TEXT("  %-10s x%-4d input->handled %6.2f  handled->effect %6.2f  effect->present %6.2f  total %6.2f (worst %.2f)"),
+			*Entry.Key.ToString(), Total.Count, Total.InputToHandled * Scale, Total.HandledToEffect * Scale, Total.EffectToPresent * Scale,
+			Total.InputToPresent * Scale, Total.WorstInputToPresent * 1000.0);
+	}
+
+	Totals.Empty();
+}
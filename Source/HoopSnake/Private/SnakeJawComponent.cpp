@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeJawComponent.h"
+#include "Animation/AnimInstance.h"
+
+USnakeJawComponent::USnakeJawComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	JawOpenCurveName = "JawOpen";
+	MaxOpenAngle = 45.0f;
+	bLowerJaw = false;
+
+	GameplayOpenAngle = 0.0f;
+	AppliedOpenAngle = 0.0f;
+
+	// The jaw is cosmetic. Bites are detected on the head bone's body, so the instance doesn't need a physics body.
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetGenerateOverlapEvents(false);
+	SetCanEverAffectNavigation(false);
+}
+
+void USnakeJawComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	EnsureJawInstance();
+}
+
+void USnakeJawComponent::SetJawOpenAngle(float Angle)
+{
+	GameplayOpenAngle = Angle;
+}
+
+void USnakeJawComponent::UpdateJaw(const UAnimInstance* AnimInstance)
+{
+	float Angle = GameplayOpenAngle;
+
+	float CurveValue = 0.0f;
+	if (AnimInstance && AnimInstance->GetCurveValue(JawOpenCurveName, CurveValue))
+	{
+		Angle = CurveValue * MaxOpenAngle;
+	}
+
+	if (!FMath::IsNearlyEqual(Angle, AppliedOpenAngle, 0.01f))
+	{
+		ApplyJawAngle(Angle);
+	}
+}
+
+void USnakeJawComponent::EnsureJawInstance()
+{
+	if (GetInstanceCount() != 1)
+	{
+		ClearInstances();
+		AddInstance(FTransform::Identity);
+	}
+
+	ApplyJawAngle(AppliedOpenAngle);
+}
+
+void USnakeJawComponent::ApplyJawAngle(float Angle)
+{
+	AppliedOpenAngle = Angle;
+
+	// Upper jaw pitches up and lower jaw pitches down by the same amount, as the separate jaw components used to.
+	const FTransform Open(FRotator(bLowerJaw ? Angle : -Angle, 0.0f, 0.0f));
+	UpdateInstanceTransform(0, Open, false, true, true);
+}
@@ -0,0 +1,165 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeKillcamActor.h"
+#include "SnakeKillcamRecorder.h"
+#include "SnakeJawComponent.h"
+#include "Camera/CameraComponent.h"
+#include "Components/PoseableMeshComponent.h"
+#include "Engine/SkinnedAsset.h"
+
+ASnakeKillcamActor::ASnakeKillcamActor()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	Camera = CreateDefaultSubobject<UCameraComponent>(TEXT("Camera"));
+	Camera->SetupAttachment(RootComponent);
+
+	CameraDistance = 450.0f;
+	CameraHeight = 200.0f;
+	CameraInterpSpeed = 4.0f;
+
+	Recorder = nullptr;
+	PlaybackTime = 0.0;
+	EndTime = 0.0;
+	PlaybackRate = 1.0f;
+	CameraDirection = -FVector::ForwardVector;
+	bCameraPlaced = false;
+}
+
+void ASnakeKillcamActor::StartPlayback(USnakeKillcamRecorder* InRecorder, const TArray<const USnakeJawComponent*>& JawTemplates, double StartTime, double InEndTime, float InPlaybackRate, const FRotator& ViewRotation)
+{
+	Recorder = InRecorder;
+	PlaybackTime = StartTime;
+	EndTime = InEndTime;
+	PlaybackRate = FMath::Max(InPlaybackRate, 0.01f);
+	bCameraPlaced = false;
+	CameraDirection = -FRotator(0.0f, ViewRotation.Yaw, 0.0f).Vector();
+
+	Ghosts.SetNumZeroed(Recorder->GetNumTracks());
+	for (int32 TrackIndex = 0; TrackIndex < Ghosts.Num(); ++TrackIndex)
+	{
+		USkinnedAsset* Asset = Recorder->GetTrackAsset(TrackIndex);
+		if (!Asset)
+		{
+			continue;
+		}
+
+		// Ghosts are only ever posed from the recording, nothing should collide with them.
+		UPoseableMeshComponent* Ghost = NewObject<UPoseableMeshComponent>(this);
+		Ghost->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		Ghost->SetupAttachment(RootComponent);
+		Ghost->SetUsingAbsoluteLocation(true);
+		Ghost->SetUsingAbsoluteRotation(true);
+		Ghost->SetUsingAbsoluteScale(true);
+		Ghost->RegisterComponent();
+		Ghost->SetSkinnedAssetAndUpdate(Asset);
+		Ghosts[TrackIndex] = Ghost;
+	}
+
+	// The first track is the snake, give its ghost a copy of each half of the jaw.
+	GhostJaws.Reset();
+	for (const USnakeJawComponent* JawTemplate : JawTemplates)
+	{
+		if (!JawTemplate || Ghosts.Num() == 0 || !Ghosts[0])
+		{
+			continue;
+		}
+
+		USnakeJawComponent* GhostJaw = NewObject<USnakeJawComponent>(this);
+		GhostJaw->SetStaticMesh(JawTemplate->GetStaticMesh());
+		GhostJaw->MaxOpenAngle = JawTemplate->MaxOpenAngle;
+		GhostJaw->bLowerJaw = JawTemplate->bLowerJaw;
+		GhostJaw->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		GhostJaw->SetupAttachment(Ghosts[0], JawTemplate->GetAttachSocketName());
+		GhostJaw->SetRelativeTransform(JawTemplate->GetRelativeTransform());
+		GhostJaw->RegisterComponent();
+		GhostJaws.Add(GhostJaw);
+	}
+
+	SetActorTickEnabled(true);
+
+	// Pose everything before the first frame is drawn.
+	Tick(0.0f);
+}
+
+void ASnakeKillcamActor::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (!Recorder)
+	{
+		return;
+	}
+
+	if (PlaybackTime > EndTime)
+	{
+		// Destroys this actor.
+		Recorder->StopKillcam();
+		return;
+	}
+
+	for (int32 TrackIndex = 0; TrackIndex < Ghosts.Num(); ++TrackIndex)
+	{
+		UPoseableMeshComponent* Ghost = Ghosts[TrackIndex];
+		if (!Ghost)
+		{
+			continue;
+		}
+
+		FTransform ComponentTransform;
+		float JawAngle = 0.0f;
+		const bool bRecorded = Recorder->SampleTrack(TrackIndex, PlaybackTime, ComponentTransform, PoseScratch, JawAngle);
+
+		// Victims come and go from the recording, only show them while they were being recorded.
+		Ghost->SetVisibility(bRecorded, true);
+		if (!bRecorded)
+		{
+			continue;
+		}
+
+		Ghost->SetWorldTransform(ComponentTransform);
+		ApplyPose(Ghost, PoseScratch);
+
+		if (TrackIndex == 0)
+		{
+			for (USnakeJawComponent* GhostJaw : GhostJaws)
+			{
+				GhostJaw->SetJawOpenAngle(JawAngle);
+				GhostJaw->UpdateJaw(nullptr);
+			}
+
+			UpdateCamera(ComponentTransform.GetLocation(), DeltaSeconds, !bCameraPlaced);
+			bCameraPlaced = true;
+		}
+	}
+
+	PlaybackTime += DeltaSeconds * PlaybackRate;
+}
+
+void ASnakeKillcamActor::ApplyPose(UPoseableMeshComponent* Mesh, const TArray<FTransform>& ComponentSpacePose)
+{
+	const FReferenceSkeleton& RefSkeleton = Mesh->GetSkinnedAsset()->GetRefSkeleton();
+	const int32 NumBones = FMath::Min(ComponentSpacePose.Num(), Mesh->BoneSpaceTransforms.Num());
+
+	// Poseable meshes take parent relative transforms. Parents always come before their children, so they are in the recorded range too.
+	for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+	{
+		const int32 ParentIndex = RefSkeleton.GetParentIndex(BoneIndex);
+		Mesh->BoneSpaceTransforms[BoneIndex] = ParentIndex == INDEX_NONE ? ComponentSpacePose[BoneIndex] : ComponentSpacePose[BoneIndex].GetRelativeTransform(ComponentSpacePose[ParentIndex]);
+	}
+
+	Mesh->RefreshBoneTransforms();
+}
+
+void ASnakeKillcamActor::UpdateCamera(const FVector& TargetLocation, float DeltaSeconds, bool bSnap)
+{
+	// A fixed direction rather than one following the snake's rotation, so a tumbling ragdoll doesn't spin the camera.
+	const FVector DesiredLocation = TargetLocation + CameraDirection * CameraDistance + FVector::UpVector * CameraHeight;
+	const FVector NewLocation = bSnap ? DesiredLocation : FMath::VInterpTo(Camera->GetComponentLocation(), DesiredLocation, DeltaSeconds, CameraInterpSpeed);
+
+	Camera->SetWorldLocationAndRotation(NewLocation, (TargetLocation - NewLocation).Rotation());
+}
@@ -0,0 +1,492 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeKillcamRecorder.h"
+#include "SnakeKillcamActor.h"
+#include "HoopSnakeCharacter.h"
+#include "SnakeJawComponent.h"
+#include "ProximityGridSubsystem.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Kismet/GameplayStatics.h"
+#include "TimerManager.h"
+#include "HoopSnake.h"
+
+DECLARE_CYCLE_STAT(TEXT("Killcam Record"), STAT_KillcamRecord, STATGROUP_HoopSnake);
+
+/** Size of one quantized location step, in centimetres. Bones can be up to 81 metres from their component. */
+static constexpr float KillcamLocationStep = 0.25f;
+
+static FKillcamBone QuantizeBone(const FTransform& Transform)
+{
+	FKillcamBone Bone;
+
+	const FVector Location = Transform.GetLocation() / KillcamLocationStep;
+	Bone.Location[0] = (int16)FMath::Clamp(FMath::RoundToInt(Location.X), -MAX_int16, MAX_int16);
+	Bone.Location[1] = (int16)FMath::Clamp(FMath::RoundToInt(Location.Y), -MAX_int16, MAX_int16);
+	Bone.Location[2] = (int16)FMath::Clamp(FMath::RoundToInt(Location.Z), -MAX_int16, MAX_int16);
+
+	// A quaternion and its negation are the same rotation, so flipping to a positive w means w can be rebuilt from the other three.
+	FQuat Rotation = Transform.GetRotation().GetNormalized();
+	if (Rotation.W < 0.0)
+	{
+		Rotation = FQuat(-Rotation.X, -Rotation.Y, -Rotation.Z, -Rotation.W);
+	}
+	Bone.Rotation[0] = (int16)FMath::RoundToInt(FMath::Clamp(Rotation.X, -1.0, 1.0) * MAX_int16);
+	Bone.Rotation[1] = (int16)FMath::RoundToInt(FMath::Clamp(Rotation.Y, -1.0, 1.0) * MAX_int16);
+	Bone.Rotation[2] = (int16)FMath::RoundToInt(FMath::Clamp(Rotation.Z, -1.0, 1.0) * MAX_int16);
+
+	return Bone;
+}
+
+static FTransform DequantizeBone(const FKillcamBone& Bone)
+{
+	const FVector Location(Bone.Location[0] * KillcamLocationStep, Bone.Location[1] * KillcamLocationStep, Bone.Location[2] * KillcamLocationStep);
+
+	const double X = Bone.Rotation[0] / (double)MAX_int16;
+	const double Y = Bone.Rotation[1] / (double)MAX_int16;
+	const double Z = Bone.Rotation[2] / (double)MAX_int16;
+	const double W = FMath::Sqrt(FMath::Max(0.0, 1.0 - (X * X + Y * Y + Z * Z)));
+
+	return FTransform(FQuat(X, Y, Z, W).GetNormalized(), Location);
+}
+
+USnakeKillcamRecorder::USnakeKillcamRecorder()
+{
+	bRecordKillcam = true;
+	bPlayKillcamOnBite = true;
+	RecordSeconds = 5.0f;
+	SnapshotRate = 15.0f;
+	MaxRecordedVictims = 3;
+	VictimRecordRadius = 1500.0f;
+	MaxBonesPerTrack = 128;
+	PostBiteSeconds = 0.75f;
+	PlaybackRate = 0.5f;
+
+	MaxFrames = 0;
+	NextFrame = 0;
+	NumFrames = 0;
+	TimeUntilSnapshot = 0.0f;
+	KillcamActor = nullptr;
+}
+
+TStatId USnakeKillcamRecorder::GetStatId() const
+{
+	return GET_STATID(STAT_KillcamRecord);
+}
+
+void USnakeKillcamRecorder::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (!bRecordKillcam)
+	{
+		return;
+	}
+
+	LLM_SCOPE_BYTAG(HoopSnake_SnakeEffects);
+
+	// Everything is allocated here, once. Recording only ever writes into these buffers.
+	MaxFrames = FMath::Max(FMath::CeilToInt(RecordSeconds * SnapshotRate), 2);
+	MaxBonesPerTrack = FMath::Max(MaxBonesPerTrack, 1);
+	FrameTimes.SetNumZeroed(MaxFrames);
+
+	Tracks.SetNum(1 + FMath::Max(MaxRecordedVictims, 0));
+	for (FKillcamTrack& Track : Tracks)
+	{
+		Track.Frames.SetNum(MaxFrames);
+		Track.Bones.SetNumUninitialized(MaxFrames * MaxBonesPerTrack);
+	}
+
+	UE_LOG(LogHoopSnake, Log, TEXT("Killcam: recording %d tracks, %d frames at %.0f Hz, %.1f KB"), Tracks.Num(), MaxFrames, SnapshotRate, GetBufferBytes() / 1024.0);
+}
+
+void USnakeKillcamRecorder::Deinitialize()
+{
+	StopKillcam();
+
+	if (AHoopSnakeCharacter* Snake = RecordedSnake.Get())
+	{
+		Snake->OnBite.Remove(BiteHandle);
+	}
+	RecordedSnake.Reset();
+
+	Tracks.Empty();
+	FrameTimes.Empty();
+	TruncatedAssets.Empty();
+
+	Super::Deinitialize();
+}
+
+SIZE_T USnakeKillcamRecorder::GetBufferBytes() const
+{
+	SIZE_T Bytes = FrameTimes.GetAllocatedSize() + Tracks.GetAllocatedSize();
+	for (const FKillcamTrack& Track : Tracks)
+	{
+		Bytes += Track.Frames.GetAllocatedSize() + Track.Bones.GetAllocatedSize();
+	}
+
+	return Bytes;
+}
+
+void USnakeKillcamRecorder::Tick(float DeltaTime)
+{
+	// Nothing new is recorded while the killcam plays, so playback can read the buffer as it stands.
+	if (Tracks.IsEmpty() || IsPlaying())
+	{
+		return;
+	}
+
+	TimeUntilSnapshot -= DeltaTime;
+	if (TimeUntilSnapshot <= 0.0f)
+	{
+		TimeUntilSnapshot += 1.0f / SnapshotRate;
+
+		// Don't try to catch up after a hitch, one snapshot is enough.
+		TimeUntilSnapshot = FMath::Max(TimeUntilSnapshot, 0.0f);
+
+		RecordSnapshot();
+	}
+}
+
+AHoopSnakeCharacter* USnakeKillcamRecorder::UpdateRecordedSnake()
+{
+	AHoopSnakeCharacter* Snake = Cast<AHoopSnakeCharacter>(UGameplayStatics::GetPlayerPawn(this, 0));
+	if (Snake != RecordedSnake.Get())
+	{
+		if (AHoopSnakeCharacter* OldSnake = RecordedSnake.Get())
+		{
+			OldSnake->OnBite.Remove(BiteHandle);
+		}
+		BiteHandle.Reset();
+
+		RecordedSnake = Snake;
+		ClearBuffer();
+
+		if (Snake)
+		{
+			BiteHandle = Snake->OnBite.AddUObject(this, &USnakeKillcamRecorder::OnSnakeBite);
+		}
+	}
+
+	// The archetype sets the snake's mesh after it spawns, so check the asset as well as the component.
+	if (Snake && (Tracks[0].Source.Get() != Snake->GetMesh() || Tracks[0].Asset.Get() != Snake->GetMesh()->GetSkinnedAsset()))
+	{
+		AssignTrack(Tracks[0], Snake->GetMesh());
+	}
+
+	return Snake;
+}
+
+void USnakeKillcamRecorder::UpdateVictimTracks(const AHoopSnakeCharacter* Snake)
+{
+	const FVector SnakeLocation = Snake->GetActorLocation();
+	const float RadiusSquared = FMath::Square(VictimRecordRadius);
+
+	// Keep victims that are still around, so their history isn't lost to a closer one.
+	for (int32 Index = 1; Index < Tracks.Num(); ++Index)
+	{
+		const USkeletalMeshComponent* Source = Tracks[Index].Source.Get();
+		if (Source && (!Source->IsVisible() || Source->GetOwner()->IsHidden() || FVector::DistSquared(Source->GetComponentLocation(), SnakeLocation) > RadiusSquared))
+		{
+			AssignTrack(Tracks[Index], nullptr);
+		}
+	}
+
+	const UProximityGridSubsystem* ProximityGrid = GetWorld()->GetSubsystem<UProximityGridSubsystem>();
+	if (!ProximityGrid)
+	{
+		return;
+	}
+
+	TArray<TPair<float, AActor*>, TInlineAllocator<16>> Candidates;
+	ProximityGrid->ForEachInRadius(SnakeLocation, VictimRecordRadius, EProximityKind::Victim, [&Candidates](AActor* Actor, const FVector& Location, float DistanceSquared)
+	{
+		Candidates.Emplace(DistanceSquared, Actor);
+	});
+	Candidates.Sort([](const TPair<float, AActor*>& A, const TPair<float, AActor*>& B) { return A.Key < B.Key; });
+
+	for (const TPair<float, AActor*>& Candidate : Candidates)
+	{
+		// Victims have a physics mesh and a trace mesh, only one of which is rendered. Record the one that is.
+		USkeletalMeshComponent* VisibleMesh = nullptr;
+		TInlineComponentArray<USkeletalMeshComponent*> Meshes(Candidate.Value);
+		for (USkeletalMeshComponent* Mesh : Meshes)
+		{
+			if (Mesh->IsVisible() && !Candidate.Value->IsHidden())
+			{
+				VisibleMesh = Mesh;
+				break;
+			}
+		}
+
+		if (!VisibleMesh || Tracks.ContainsByPredicate([VisibleMesh](const FKillcamTrack& Track) { return Track.Source.Get() == VisibleMesh; }))
+		{
+			continue;
+		}
+
+		FKillcamTrack* FreeTrack = nullptr;
+		for (int32 Index = 1; Index < Tracks.Num() && !FreeTrack; ++Index)
+		{
+			if (!Tracks[Index].Source.IsValid())
+			{
+				FreeTrack = &Tracks[Index];
+			}
+		}
+
+		if (!FreeTrack)
+		{
+			break;
+		}
+
+		AssignTrack(*FreeTrack, VisibleMesh);
+	}
+}
+
+void USnakeKillcamRecorder::AssignTrack(FKillcamTrack& Track, USkeletalMeshComponent* Mesh)
+{
+	Track.Source = Mesh;
+	Track.Asset = Mesh ? Mesh->GetSkinnedAsset() : nullptr;
+	Track.Scale = Mesh ? Mesh->GetComponentScale() : FVector::OneVector;
+	Track.NumBones = Mesh ? FMath::Min(Mesh->GetComponentSpaceTransforms().Num(), MaxBonesPerTrack) : 0;
+
+	if (Mesh && Mesh->GetComponentSpaceTransforms().Num() > MaxBonesPerTrack && !TruncatedAssets.Contains(Track.Asset))
+	{
+		TruncatedAssets.Add(Track.Asset);
+		UE_LOG(LogHoopSnake, Warning, TEXT("Killcam: %s has %d bones but only %d are recorded, the rest will stay in the reference pose on playback. Raise MaxBonesPerTrack to record them all."),
+			*GetNameSafe(Track.Asset.Get()), Mesh->GetComponentSpaceTransforms().Num(), MaxBonesPerTrack);
+	}
+
+	for (FKillcamTrackFrame& Frame : Track.Frames)
+	{
+		Frame.bRecorded = false;
+	}
+}
+
+void USnakeKillcamRecorder::RecordSnapshot()
+{
+	SCOPE_CYCLE_COUNTER(STAT_KillcamRecord);
+
+	AHoopSnakeCharacter* Snake = UpdateRecordedSnake();
+	if (!Snake)
+	{
+		return;
+	}
+
+	UpdateVictimTracks(Snake);
+
+	const int32 Frame = NextFrame;
+	FrameTimes[Frame] = GetWorld()->GetTimeSeconds();
+
+	RecordTrack(Tracks[0], Frame, Snake->GetUpperJaw()->GetAppliedOpenAngle());
+	for (int32 Index = 1; Index < Tracks.Num(); ++Index)
+	{
+		RecordTrack(Tracks[Index], Frame, 0.0f);
+	}
+
+	NextFrame = (NextFrame + 1) % MaxFrames;
+	NumFrames = FMath::Min(NumFrames + 1, MaxFrames);
+}
+
+void USnakeKillcamRecorder::RecordTrack(FKillcamTrack& Track, int32 Frame, float JawAngle)
+{
+	FKillcamTrackFrame& TrackFrame = Track.Frames[Frame];
+
+	const USkeletalMeshComponent* Mesh = Track.Source.Get();
+	if (!Mesh || Mesh->GetSkinnedAsset() != Track.Asset.Get())
+	{
+		TrackFrame.bRecorded = false;
+		return;
+	}
+
+	TrackFrame.Location = FVector3f(Mesh->GetComponentLocation());
+	TrackFrame.Rotation = FQuat4f(Mesh->GetComponentQuat());
+	TrackFrame.JawAngle = JawAngle;
+	TrackFrame.bRecorded = true;
+
+	// The pose the mesh already worked out this frame, animated or simulated. Nothing is evaluated just for the killcam.
+	const TArray<FTransform>& ComponentSpace = Mesh->GetComponentSpaceTransforms();
+	const int32 NumBones = FMath::Min(Track.NumBones, ComponentSpace.Num());
+	FKillcamBone* Bones = Track.Bones.GetData() + Frame * MaxBonesPerTrack;
+	for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+	{
+		Bones[BoneIndex] = QuantizeBone(ComponentSpace[BoneIndex]);
+	}
+}
+
+void USnakeKillcamRecorder::ClearBuffer()
+{
+	NextFrame = 0;
+	NumFrames = 0;
+
+	for (FKillcamTrack& Track : Tracks)
+	{
+		for (FKillcamTrackFrame& Frame : Track.Frames)
+		{
+			Frame.bRecorded = false;
+		}
+	}
+}
+
+double USnakeKillcamRecorder::GetOldestFrameTime() const
+{
+	return NumFrames > 0 ? FrameTimes[GetFrameIndex(0)] : 0.0;
+}
+
+double USnakeKillcamRecorder::GetNewestFrameTime() const
+{
+	return NumFrames > 0 ? FrameTimes[GetFrameIndex(NumFrames - 1)] : 0.0;
+}
+
+USkinnedAsset* USnakeKillcamRecorder::GetTrackAsset(int32 TrackIndex) const
+{
+	return Tracks.IsValidIndex(TrackIndex) ? Tracks[TrackIndex].Asset.Get() : nullptr;
+}
+
+bool USnakeKillcamRecorder::SampleTrack(int32 TrackIndex, double Time, FTransform& OutComponentTransform, TArray<FTransform>& OutBones, float& OutJawAngle) const
+{
+	if (!Tracks.IsValidIndex(TrackIndex) || NumFrames == 0)
+	{
+		return false;
+	}
+
+	// Find the last snapshot at or before the time. The buffer is only a few dozen frames, so a walk is fine.
+	int32 Age = 0;
+	while (Age + 1 < NumFrames && FrameTimes[GetFrameIndex(Age + 1)] <= Time)
+	{
+		++Age;
+	}
+
+	const int32 FrameA = GetFrameIndex(Age);
+	const int32 FrameB = GetFrameIndex(FMath::Min(Age + 1, NumFrames - 1));
+
+	const FKillcamTrack& Track = Tracks[TrackIndex];
+	const FKillcamTrackFrame& A = Track.Frames[FrameA];
+	if (!A.bRecorded)
+	{
+		return false;
+	}
+
+	// Hold the last snapshot if the track stopped recording after it.
+	const FKillcamTrackFrame& B = Track.Frames[FrameB].bRecorded ? Track.Frames[FrameB] : A;
+	const double FrameDuration = FrameTimes[FrameB] - FrameTimes[FrameA];
+	const float Alpha = (FrameB != FrameA && FrameDuration > UE_SMALL_NUMBER) ? (float)FMath::Clamp((Time - FrameTimes[FrameA]) / FrameDuration, 0.0, 1.0) : 0.0f;
+
+	OutComponentTransform = FTransform(
+		FQuat(FQuat4f::Slerp(A.Rotation, B.Rotation, Alpha)),
+		FVector(FMath::Lerp(A.Location, B.Location, Alpha)),
+		Track.Scale);
+	OutJawAngle = FMath::Lerp(A.JawAngle, B.JawAngle, Alpha);
+
+	const FKillcamBone* BonesA = Track.Bones.GetData() + FrameA * MaxBonesPerTrack;
+	const FKillcamBone* BonesB = Track.Bones.GetData() + (&B == &A ? FrameA : FrameB) * MaxBonesPerTrack;
+
+	OutBones.SetNumUninitialized(Track.NumBones, EAllowShrinking::No);
+	for (int32 BoneIndex = 0; BoneIndex < Track.NumBones; ++BoneIndex)
+	{
+		OutBones[BoneIndex].Blend(DequantizeBone(BonesA[BoneIndex]), DequantizeBone(BonesB[BoneIndex]), Alpha);
+	}
+
+	return true;
+}
+
+void USnakeKillcamRecorder::OnSnakeBite(AHoopSnakeCharacter* Snake, AActor* Victim)
+{
+	if (!bPlayKillcamOnBite || IsPlaying() || GetWorld()->GetTimerManager().IsTimerActive(KillcamTimerHandle))
+	{
+		return;
+	}
+
+	GetWorld()->GetTimerManager().SetTimer(KillcamTimerHandle, this, &USnakeKillcamRecorder::PlayKillcam, PostBiteSeconds, false);
+}
+
+void USnakeKillcamRecorder::PlayKillcam()
+{
+	LLM_SCOPE_BYTAG(HoopSnake_SnakeEffects);
+
+	AHoopSnakeCharacter* Snake = RecordedSnake.Get();
+	APlayerController* PlayerController = Snake ? Snake->GetSnakePlayerController() : nullptr;
+	if (IsPlaying() || !PlayerController || NumFrames < 2)
+	{
+		return;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	KillcamActor = GetWorld()->SpawnActor<ASnakeKillcamActor>(Snake->GetActorLocation(), FRotator::ZeroRotator, SpawnParams);
+	if (!KillcamActor)
+	{
+		return;
+	}
+
+	KillcamActor->StartPlayback(this, { Snake->GetUpperJaw(), Snake->GetLowerJaw() }, GetOldestFrameTime(), GetNewestFrameTime(), PlaybackRate, PlayerController->GetControlRotation());
+
+	HideSources(true);
+	PlayerController->SetViewTargetWithBlend(KillcamActor, 0.25f);
+
+	UE_LOG(LogHoopSnake, Log, TEXT("Killcam: playing %.1f seconds"), GetNewestFrameTime() - GetOldestFrameTime());
+}
+
+void USnakeKillcamRecorder::StopKillcam()
+{
+	GetWorld()->GetTimerManager().ClearTimer(KillcamTimerHandle);
+
+	if (!IsPlaying())
+	{
+		return;
+	}
+
+	AHoopSnakeCharacter* Snake = RecordedSnake.Get();
+	if (APlayerController* PlayerController = Snake ? Snake->GetSnakePlayerController() : nullptr)
+	{
+		PlayerController->SetViewTargetWithBlend(Snake, 0.25f);
+	}
+
+	HideSources(false);
+
+	KillcamActor->Destroy();
+	KillcamActor = nullptr;
+
+	// Start the next clip fresh, rather than with a gap where the killcam played.
+	ClearBuffer();
+}
+
+void USnakeKillcamRecorder::HideSources(bool bHide)
+{
+	if (!bHide)
+	{
+		for (const TWeakObjectPtr<USceneComponent>& Component : HiddenComponents)
+		{
+			if (Component.IsValid())
+			{
+				Component->SetVisibility(true);
+			}
+		}
+
+		HiddenComponents.Reset();
+		return;
+	}
+
+	// Hide the recorded meshes and whatever is attached to them, such as the snake's jaw. Only things that were visible are shown again later.
+	for (const FKillcamTrack& Track : Tracks)
+	{
+		USkeletalMeshComponent* Mesh = Track.Source.Get();
+		if (!Mesh)
+		{
+			continue;
+		}
+
+		TArray<USceneComponent*> Components;
+		Mesh->GetChildrenComponents(true, Components);
+		Components.Add(Mesh);
+
+		for (USceneComponent* Component : Components)
+		{
+			if (Component->IsVisible())
+			{
+				Component->SetVisibility(false);
+				HiddenComponents.Add(Component);
+			}
+		}
+	}
+}
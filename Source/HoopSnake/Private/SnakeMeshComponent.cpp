@@ -0,0 +1,381 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeMeshComponent.h"
+#include "SnakePhysicsLODSubsystem.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/World.h"
+#include "PhysicsEngine/PhysicsAsset.h"
+#include "PhysicsEngine/SkeletalBodySetup.h"
+#include "PhysicsEngine/PhysicsConstraintTemplate.h"
+#include "AnimationRuntime.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "UObject/Package.h"
+#include "HoopSnake.h"
+
+DECLARE_CYCLE_STAT(TEXT("Snake Build Reduced Physics"), STAT_SnakeBuildReducedPhysics, STATGROUP_HoopSnake);
+DECLARE_CYCLE_STAT(TEXT("Snake Interpolate Bones"), STAT_SnakeInterpolateBones, STATGROUP_HoopSnake);
+
+namespace SnakeMeshComponent
+{
+	// Move a shape from one bone's space into another's, using the reference pose
+	template<typename ElemType>
+	void MergeElems(const TArray<ElemType>& From, TArray<ElemType>& To, const FTransform& FromToTarget)
+	{
+		for (ElemType Elem : From)
+		{
+			Elem.SetTransform(Elem.GetTransform() * FromToTarget);
+			To.Add(Elem);
+		}
+	}
+}
+
+USnakeMeshComponent::USnakeMeshComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	bAllowReducedPhysics = true;
+	ReducedBodyStride = 3;
+	FullFidelityDistance = 2500.0f;
+	PhysicsLODCheckInterval = 0.5f;
+	PreservedBoneName = "Bone";
+
+	bPhysicsReduced = false;
+	FullPhysicsAsset = nullptr;
+	FullBodyCount = 0;
+	TimeUntilLODCheck = 0.0f;
+}
+
+void USnakeMeshComponent::UpdatePhysicsLOD(bool bIsHero, float DeltaTime)
+{
+	TimeUntilLODCheck -= DeltaTime;
+	if (TimeUntilLODCheck > 0.0f || IsSimulatingPhysics())
+	{
+		return;
+	}
+
+	TimeUntilLODCheck = PhysicsLODCheckInterval;
+
+	bool bWantsReduced = bAllowReducedPhysics && !bIsHero;
+	if (bWantsReduced)
+	{
+		// A little hysteresis so a snake sitting on the boundary doesn't rebuild its bodies every check.
+		const float Distance = bPhysicsReduced ? FullFidelityDistance : FullFidelityDistance * 1.1f;
+		const FVector Location = GetComponentLocation();
+
+		for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+		{
+			const APlayerController* PlayerController = It->Get();
+			if (PlayerController && PlayerController->PlayerCameraManager && FVector::DistSquared(PlayerController->PlayerCameraManager->GetCameraLocation(), Location) < FMath::Square(Distance))
+			{
+				bWantsReduced = false;
+				break;
+			}
+		}
+	}
+
+	SetReducedPhysics(bWantsReduced);
+}
+
+void USnakeMeshComponent::SetReducedPhysics(bool bReduced)
+{
+	if (bReduced == bPhysicsReduced)
+	{
+		return;
+	}
+
+	if (bReduced)
+	{
+		UPhysicsAsset* ReducedAsset = GetReducedPhysicsAsset(GetPhysicsAsset());
+		if (!ReducedAsset)
+		{
+			return;
+		}
+
+		FullPhysicsAsset = GetPhysicsAsset();
+		FullBodyCount = Bodies.Num();
+		SetPhysicsAsset(ReducedAsset, true);
+		bPhysicsReduced = true;
+		BuildInterpolatedBones();
+	}
+	else
+	{
+		SetPhysicsAsset(FullPhysicsAsset, true);
+		FullPhysicsAsset = nullptr;
+		bPhysicsReduced = false;
+		InterpolatedBones.Reset();
+	}
+}
+
+float USnakeMeshComponent::GetBodyImpulseScale() const
+{
+	return (bPhysicsReduced && Bodies.Num() > 0) ? (float)FullBodyCount / Bodies.Num() : 1.0f;
+}
+
+UPhysicsAsset* USnakeMeshComponent::GetReducedPhysicsAsset(UPhysicsAsset* FullAsset) const
+{
+	if (!FullAsset || !GetSkeletalMeshAsset())
+	{
+		return nullptr;
+	}
+
+	// Reduced assets are shared by every snake in the world using the same full asset and stride.
+	USnakePhysicsLODSubsystem* PhysicsLOD = GetWorld() ? GetWorld()->GetSubsystem<USnakePhysicsLODSubsystem>() : nullptr;
+	if (UPhysicsAsset* Cached = PhysicsLOD ? PhysicsLOD->FindReducedAsset(FullAsset, ReducedBodyStride) : nullptr)
+	{
+		return Cached;
+	}
+
+	UPhysicsAsset* ReducedAsset = BuildReducedPhysicsAsset(FullAsset);
+	if (ReducedAsset && PhysicsLOD)
+	{
+		PhysicsLOD->AddReducedAsset(FullAsset, ReducedBodyStride, ReducedAsset);
+	}
+
+	return ReducedAsset;
+}
+
+UPhysicsAsset* USnakeMeshComponent::BuildReducedPhysicsAsset(UPhysicsAsset* FullAsset) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_SnakeBuildReducedPhysics);
+
+	const FReferenceSkeleton& RefSkeleton = GetSkeletalMeshAsset()->GetRefSkeleton();
+
+	// Bodies in order down the rope, which for a chain is bone order.
+	TArray<int32> BodyOrder;
+	TArray<int32> BodyBones;
+	BodyBones.Init(INDEX_NONE, FullAsset->SkeletalBodySetups.Num());
+	for (int32 BodyIndex = 0; BodyIndex < FullAsset->SkeletalBodySetups.Num(); ++BodyIndex)
+	{
+		BodyBones[BodyIndex] = RefSkeleton.FindBoneIndex(FullAsset->SkeletalBodySetups[BodyIndex]->BoneName);
+		if (BodyBones[BodyIndex] == INDEX_NONE)
+		{
+			return nullptr;
+		}
+
+		BodyOrder.Add(BodyIndex);
+	}
+	BodyOrder.Sort([&BodyBones](int32 A, int32 B) { return BodyBones[A] < BodyBones[B]; });
+
+	const int32 NumBodies = BodyOrder.Num();
+	if (NumBodies <= 2)
+	{
+		return nullptr;
+	}
+
+	// Only a single chain can be reduced like this, where every body hangs off the one before it.
+	for (int32 Order = 1; Order < NumBodies; ++Order)
+	{
+		if (!RefSkeleton.BoneIsChildOf(BodyBones[BodyOrder[Order]], BodyBones[BodyOrder[Order - 1]]))
+		{
+			UE_LOG(LogHoopSnake, Warning, TEXT("%s isn't a single chain of bodies, the snake will keep its full ragdoll."), *FullAsset->GetName());
+			return nullptr;
+		}
+	}
+
+	// Keep the ends, the preserved bone and every Nth body.
+	TArray<bool> Keep;
+	Keep.SetNumZeroed(NumBodies);
+	for (int32 Order = 0; Order < NumBodies; ++Order)
+	{
+		Keep[Order] = Order % ReducedBodyStride == 0 || Order == NumBodies - 1 || FullAsset->SkeletalBodySetups[BodyOrder[Order]]->BoneName == PreservedBoneName;
+	}
+
+	UPhysicsAsset* ReducedAsset = DuplicateObject<UPhysicsAsset>(FullAsset, GetTransientPackage(),
+		MakeUniqueObjectName(GetTransientPackage(), UPhysicsAsset::StaticClass(), *FString::Printf(TEXT("%s_Reduced%d"), *FullAsset->GetName(), ReducedBodyStride)));
+
+	auto BoneOf = [&BodyBones, &BodyOrder](int32 Order) { return BodyBones[BodyOrder[Order]]; };
+	auto RefPose = [&RefSkeleton](int32 BoneIndex) { return FAnimationRuntime::GetComponentSpaceTransformRefPose(RefSkeleton, BoneIndex); };
+
+	// Dropped bodies hand their shapes to the kept body above them, so the coverage stays where it was along the rope.
+	// The preserved bone is never merged into, its shapes and mass stay as authored. When it is the body above, the next kept body down is used instead.
+	auto IsMergeTarget = [&Keep, &FullAsset, &BodyOrder, this](int32 Order)
+	{
+		return Keep[Order] && FullAsset->SkeletalBodySetups[BodyOrder[Order]]->BoneName != PreservedBoneName;
+	};
+
+	TArray<int32> MergeTargets;
+	MergeTargets.Init(INDEX_NONE, NumBodies);
+	int32 PreviousTarget = INDEX_NONE;
+	for (int32 Order = 0; Order < NumBodies; ++Order)
+	{
+		if (IsMergeTarget(Order))
+		{
+			PreviousTarget = Order;
+		}
+		else if (!Keep[Order])
+		{
+			MergeTargets[Order] = PreviousTarget;
+		}
+	}
+
+	int32 NextTarget = INDEX_NONE;
+	for (int32 Order = NumBodies - 1; Order >= 0; --Order)
+	{
+		if (IsMergeTarget(Order))
+		{
+			NextTarget = Order;
+		}
+		else if (!Keep[Order] && MergeTargets[Order] == INDEX_NONE)
+		{
+			MergeTargets[Order] = NextTarget;
+		}
+	}
+
+	for (int32 Order = 0; Order < NumBodies; ++Order)
+	{
+		const int32 TargetOrder = MergeTargets[Order];
+		if (TargetOrder == INDEX_NONE)
+		{
+			continue;
+		}
+
+		USkeletalBodySetup* Source = ReducedAsset->SkeletalBodySetups[BodyOrder[Order]];
+		USkeletalBodySetup* Target = ReducedAsset->SkeletalBodySetups[BodyOrder[TargetOrder]];
+		const FTransform SourceToTarget = RefPose(BoneOf(Order)).GetRelativeTransform(RefPose(BoneOf(TargetOrder)));
+
+		SnakeMeshComponent::MergeElems(Source->AggGeom.SphylElems, Target->AggGeom.SphylElems, SourceToTarget);
+		SnakeMeshComponent::MergeElems(Source->AggGeom.SphereElems, Target->AggGeom.SphereElems, SourceToTarget);
+		SnakeMeshComponent::MergeElems(Source->AggGeom.BoxElems, Target->AggGeom.BoxElems, SourceToTarget);
+
+		if (Target->DefaultInstance.bOverrideMass)
+		{
+			Target->DefaultInstance.SetMassOverride(Target->DefaultInstance.GetMassOverride() + Source->CalculateMass());
+		}
+	}
+
+	// Join each kept body to the kept body above it, reusing the joint that used to hold it.
+	TArray<TObjectPtr<UPhysicsConstraintTemplate>> Constraints;
+	int32 PreviousKept = 0;
+	for (int32 Order = 1; Order < NumBodies; ++Order)
+	{
+		if (!Keep[Order])
+		{
+			continue;
+		}
+
+		const FName ChildBoneName = RefSkeleton.GetBoneName(BoneOf(Order));
+		const FName ParentBoneName = RefSkeleton.GetBoneName(BoneOf(PreviousKept));
+		const int32 Steps = Order - PreviousKept;
+
+		const TObjectPtr<UPhysicsConstraintTemplate>* Found = ReducedAsset->ConstraintSetup.FindByPredicate([ChildBoneName](const UPhysicsConstraintTemplate* Template)
+		{
+			return Template && Template->DefaultInstance.ConstraintBone1 == ChildBoneName;
+		});
+
+		if (Found)
+		{
+			FConstraintInstance& Joint = (*Found)->DefaultInstance;
+			const FTransform ChildFrame = Joint.GetRefFrame(EConstraintFrame::Frame1);
+
+			Joint.ConstraintBone2 = ParentBoneName;
+			Joint.SetRefFrame(EConstraintFrame::Frame2, ChildFrame * RefPose(BoneOf(Order)).GetRelativeTransform(RefPose(BoneOf(PreviousKept))));
+
+			// One joint now bends as far as all the ones it replaced.
+			Joint.SetAngularSwing1Limit(Joint.GetAngularSwing1Motion(), FMath::Min(Joint.GetAngularSwing1Limit() * Steps, 179.0f));
+			Joint.SetAngularSwing2Limit(Joint.GetAngularSwing2Motion(), FMath::Min(Joint.GetAngularSwing2Limit() * Steps, 179.0f));
+			Joint.SetAngularTwistLimit(Joint.GetAngularTwistMotion(), FMath::Min(Joint.GetAngularTwistLimit() * Steps, 179.0f));
+
+			Constraints.Add(*Found);
+		}
+		else
+		{
+			// Without a joint the rope would come apart at this body, so it's better not to reduce it at all.
+			UE_LOG(LogHoopSnake, Warning, TEXT("%s has no joint holding %s, the reduced chain would be broken there. The snake will keep its full ragdoll."), *FullAsset->GetName(), *ChildBoneName.ToString());
+			return nullptr;
+		}
+
+		PreviousKept = Order;
+	}
+
+	TArray<TObjectPtr<USkeletalBodySetup>> BodySetups;
+	for (int32 Order = 0; Order < NumBodies; ++Order)
+	{
+		if (Keep[Order])
+		{
+			BodySetups.Add(ReducedAsset->SkeletalBodySetups[BodyOrder[Order]]);
+		}
+	}
+
+	ReducedAsset->SkeletalBodySetups = MoveTemp(BodySetups);
+	ReducedAsset->ConstraintSetup = MoveTemp(Constraints);
+
+	// The table is keyed on body indices, which no longer line up. Joined bodies already skip colliding through their joints.
+	ReducedAsset->CollisionDisableTable.Empty();
+	ReducedAsset->UpdateBodySetupIndexMap();
+	ReducedAsset->UpdateBoundsBodiesArray();
+
+	UE_LOG(LogHoopSnake, Log, TEXT("Built %s: %d of %d bodies kept"), *ReducedAsset->GetName(), ReducedAsset->SkeletalBodySetups.Num(), NumBodies);
+
+	return ReducedAsset;
+}
+
+void USnakeMeshComponent::BuildInterpolatedBones()
+{
+	InterpolatedBones.Reset();
+
+	const UPhysicsAsset* PhysicsAsset = GetPhysicsAsset();
+	if (!PhysicsAsset || !GetSkeletalMeshAsset())
+	{
+		return;
+	}
+
+	const FReferenceSkeleton& RefSkeleton = GetSkeletalMeshAsset()->GetRefSkeleton();
+
+	TArray<int32> KeyBones;
+	for (const USkeletalBodySetup* BodySetup : PhysicsAsset->SkeletalBodySetups)
+	{
+		KeyBones.Add(RefSkeleton.FindBoneIndex(BodySetup->BoneName));
+	}
+	KeyBones.Sort();
+
+	for (int32 KeyIndex = 1; KeyIndex < KeyBones.Num(); ++KeyIndex)
+	{
+		const int32 ParentKey = KeyBones[KeyIndex - 1];
+		const int32 ChildKey = KeyBones[KeyIndex];
+		const FTransform ParentRef = FAnimationRuntime::GetComponentSpaceTransformRefPose(RefSkeleton, ParentKey);
+		const FTransform ChildRef = FAnimationRuntime::GetComponentSpaceTransformRefPose(RefSkeleton, ChildKey);
+
+		for (int32 BoneIndex = ParentKey + 1; BoneIndex < ChildKey; ++BoneIndex)
+		{
+			if (!RefSkeleton.BoneIsChildOf(BoneIndex, ParentKey) || !RefSkeleton.BoneIsChildOf(ChildKey, BoneIndex))
+			{
+				continue;
+			}
+
+			const FTransform BoneRef = FAnimationRuntime::GetComponentSpaceTransformRefPose(RefSkeleton, BoneIndex);
+
+			FInterpolatedBone& Interpolated = InterpolatedBones.AddDefaulted_GetRef();
+			Interpolated.BoneIndex = BoneIndex;
+			Interpolated.ParentKeyIndex = ParentKey;
+			Interpolated.ChildKeyIndex = ChildKey;
+			Interpolated.Alpha = (float)(BoneIndex - ParentKey) / (ChildKey - ParentKey);
+			Interpolated.FromParentKey = BoneRef.GetRelativeTransform(ParentRef);
+			Interpolated.FromChildKey = BoneRef.GetRelativeTransform(ChildRef);
+		}
+	}
+}
+
+void USnakeMeshComponent::FinalizeBoneTransform()
+{
+	// Without this the bones between simulated bodies would ride rigidly on the body above them, and the rope would look segmented.
+	if (bPhysicsReduced && IsSimulatingPhysics() && !InterpolatedBones.IsEmpty())
+	{
+		SCOPE_CYCLE_COUNTER(STAT_SnakeInterpolateBones);
+
+		TArray<FTransform>& Transforms = GetEditableComponentSpaceTransforms();
+		for (const FInterpolatedBone& Interpolated : InterpolatedBones)
+		{
+			if (!Transforms.IsValidIndex(Interpolated.ChildKeyIndex))
+			{
+				continue;
+			}
+
+			FTransform Blended;
+			Blended.Blend(Interpolated.FromParentKey * Transforms[Interpolated.ParentKeyIndex], Interpolated.FromChildKey * Transforms[Interpolated.ChildKeyIndex], Interpolated.Alpha);
+			Transforms[Interpolated.BoneIndex] = Blended;
+		}
+	}
+
+	Super::FinalizeBoneTransform();
+}
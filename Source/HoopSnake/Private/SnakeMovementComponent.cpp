@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeMovementComponent.h"
+#include "HoopSnakeCharacter.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
+#include "HoopSnake.h"
+
+DECLARE_CYCLE_STAT(TEXT("Snake Predict Hoop Impact"), STAT_SnakePredictHoopImpact, STATGROUP_HoopSnake);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Predicted Hoop Impacts"), STAT_SnakePredictedHoopImpacts, STATGROUP_HoopSnake);
+
+USnakeMovementComponent::USnakeMovementComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	bPredictHoopImpacts = true;
+	HoopImpactInflation = 5.0f;
+	HoopImpactMinApproach = 0.5f;
+}
+
+void USnakeMovementComponent::MoveAlongFloor(const FVector& InVelocity, float DeltaSeconds, FStepDownResult* OutStepDownResult)
+{
+	AHoopSnakeCharacter* Snake = Cast<AHoopSnakeCharacter>(CharacterOwner);
+	if (!bPredictHoopImpacts || !Snake || !Snake->IsHoopModeEnabled())
+	{
+		Super::MoveAlongFloor(InVelocity, DeltaSeconds, OutStepDownResult);
+		return;
+	}
+
+	// Called once per substep, so at hoop speed the look-ahead is never longer than the step itself.
+	const FVector Delta = FVector(InVelocity.X, InVelocity.Y, 0.0f) * DeltaSeconds;
+	FHitResult Hit;
+	if (!PredictHoopImpact(Delta, Hit))
+	{
+		Super::MoveAlongFloor(InVelocity, DeltaSeconds, OutStepDownResult);
+		return;
+	}
+
+	INC_DWORD_STAT(STAT_SnakePredictedHoopImpacts);
+
+	// Move up to the contact, so the ragdoll starts where the hoop hit rather than where it was at the start of the step.
+	const FVector ImpactVelocity = Velocity;
+	FHitResult MoveHit;
+	SafeMoveUpdatedComponent(Delta * Hit.Time, UpdatedComponent->GetComponentQuat(), true, MoveHit);
+
+	// Ragdolling disables movement, so the rest of this frame's substeps don't slide the capsule along the wall.
+	Snake->ForceRagdollWithVelocity(ImpactVelocity);
+}
+
+bool USnakeMovementComponent::PredictHoopImpact(const FVector& Delta, FHitResult& OutHit) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_SnakePredictHoopImpact);
+
+	if (Delta.IsNearlyZero())
+	{
+		return false;
+	}
+
+	// Only the radius is inflated. Inflating the half-height too would start the sweep in the floor, and every hit would be start-penetrating.
+	const FCollisionShape Shape = GetPawnCapsuleCollisionShape(SHRINK_RadiusCustom, -HoopImpactInflation);
+
+	// The half-height is clamped to at least the radius, so lift the sweep by however much that grew it to keep the bottom where the capsule's is.
+	const float HalfHeightGrowth = FMath::Max(0.0f, Shape.GetCapsuleHalfHeight() - CharacterOwner->GetCapsuleComponent()->GetScaledCapsuleHalfHeight());
+	const FVector Start = UpdatedComponent->GetComponentLocation() + FVector(0.0f, 0.0f, HalfHeightGrowth);
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(SnakePredictHoopImpact), false, CharacterOwner);
+	FCollisionResponseParams ResponseParams;
+	UpdatedPrimitive->InitSweepCollisionParams(Params, ResponseParams);
+
+	if (!GetWorld()->SweepSingleByChannel(OutHit, Start, Start + Delta, UpdatedComponent->GetComponentQuat(), UpdatedComponent->GetCollisionObjectType(), Shape, Params, ResponseParams))
+	{
+		return false;
+	}
+
+	// Starting inside something is the floor or a wall we're already sliding along, not a new impact.
+	if (OutHit.bStartPenetrating)
+	{
+		return false;
+	}
+
+	// Slopes and steps are walked up, and other pawns are for biting.
+	const float HeightAboveBase = OutHit.ImpactPoint.Z - (Start.Z - Shape.GetCapsuleHalfHeight());
+	if (IsWalkable(OutHit) || (CanStepUp(OutHit) && HeightAboveBase <= MaxStepHeight))
+	{
+		return false;
+	}
+	if (const UPrimitiveComponent* HitComponent = OutHit.GetComponent())
+	{
+		if (HitComponent->GetCollisionObjectType() == ECC_Pawn || HitComponent->GetCollisionObjectType() == ECC_PhysicsBody)
+		{
+			return false;
+		}
+	}
+
+	return FVector::DotProduct(-OutHit.ImpactNormal, Delta.GetSafeNormal()) >= HoopImpactMinApproach;
+}
@@ -0,0 +1,511 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeObstacleSubsystem.h"
+#include "HoopSnakeCharacter.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "Materials/MaterialInterface.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+#include "Misc/App.h"
+#include "RHIGlobals.h"
+#include "HoopSnake.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Obstacle Instances"), STAT_SnakeObstacleInstances, STATGROUP_HoopSnake);
+
+USnakeObstacleSubsystem::USnakeObstacleSubsystem()
+{
+	bCollapseObstacles = true;
+	ObstacleTag = "Obstacle";
+	BenchSpreadRadius = 3000.0f;
+
+	InstanceOwner = nullptr;
+	BenchFramesPerRun = 0;
+	BenchRun = 0;
+	BenchSettleTime = 0.0;
+}
+
+void USnakeObstacleSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (!bCollapseObstacles)
+	{
+		return;
+	}
+
+	for (const FSoftClassPath& ClassPath : ObstacleClasses)
+	{
+		if (UClass* Class = ClassPath.TryLoadClass<AActor>())
+		{
+			LoadedObstacleClasses.Add(Class);
+		}
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Name = TEXT("ObstacleInstances");
+	SpawnParams.ObjectFlags |= RF_Transient;
+	InstanceOwner = InWorld.SpawnActor<AActor>(SpawnParams);
+
+	USceneComponent* Root = NewObject<USceneComponent>(InstanceOwner, TEXT("Root"));
+	Root->SetMobility(EComponentMobility::Static);
+	InstanceOwner->SetRootComponent(Root);
+	Root->RegisterComponent();
+
+	for (ULevel* Level : InWorld.GetLevels())
+	{
+		CollapseLevel(Level);
+	}
+	RebuildInstances();
+
+	// World partition cells stream in after play has started.
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &USnakeObstacleSubsystem::OnLevelAdded);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &USnakeObstacleSubsystem::OnLevelRemoved);
+
+	UE_LOG(LogHoopSnake, Log, TEXT("Obstacles: collapsed %d obstacles into %d instance components"), Obstacles.Num(), Groups.Num());
+}
+
+void USnakeObstacleSubsystem::Deinitialize()
+{
+	StopBenchmark();
+
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+
+	Obstacles.Empty();
+	Groups.Empty();
+	GroupKeys.Empty();
+	InstanceObstacles.Empty();
+
+	Super::Deinitialize();
+}
+
+bool USnakeObstacleSubsystem::IsCollapsibleObstacle(const AActor* Actor) const
+{
+	if (!IsValid(Actor) || Actor == InstanceOwner)
+	{
+		return false;
+	}
+
+	const bool bIsObstacle = Actor->ActorHasTag(ObstacleTag) || LoadedObstacleClasses.ContainsByPredicate([Actor](const UClass* Class) { return Actor->IsA(Class); });
+	if (!bIsObstacle)
+	{
+		return false;
+	}
+
+	// Anything other than static meshes, such as lights or effects, would be lost with the actor.
+	bool bHasMesh = false;
+	for (const UActorComponent* Component : Actor->GetComponents())
+	{
+		if (Cast<UStaticMeshComponent>(Component))
+		{
+			bHasMesh = true;
+		}
+		else if (Cast<UPrimitiveComponent>(Component) || !Cast<USceneComponent>(Component))
+		{
+			return false;
+		}
+	}
+
+	return bHasMesh;
+}
+
+void USnakeObstacleSubsystem::CollapseLevel(ULevel* Level)
+{
+	if (!Level)
+	{
+		return;
+	}
+
+	// Collapsing destroys actors, so find them all first.
+	TArray<AActor*> ToCollapse;
+	for (AActor* Actor : Level->Actors)
+	{
+		if (IsCollapsibleObstacle(Actor))
+		{
+			ToCollapse.Add(Actor);
+		}
+	}
+
+	for (AActor* Actor : ToCollapse)
+	{
+		CollapseActor(Actor);
+	}
+}
+
+void USnakeObstacleSubsystem::CollapseActor(AActor* Actor)
+{
+	FSnakeCollapsedObstacle& Obstacle = Obstacles.AddDefaulted_GetRef();
+	Obstacle.Class = Actor->GetClass();
+	Obstacle.ActorTransform = Actor->GetActorTransform();
+	Obstacle.Level = Actor->GetLevel();
+
+	TInlineComponentArray<UStaticMeshComponent*> MeshComponents(Actor);
+	for (const UStaticMeshComponent* MeshComponent : MeshComponents)
+	{
+		if (!MeshComponent->GetStaticMesh())
+		{
+			continue;
+		}
+
+		// Meshes that are neither drawn nor collide have nothing to carry over. Hidden ones that collide, such as blocking volumes made of meshes, still do.
+		const bool bVisible = MeshComponent->IsVisible() && !MeshComponent->bHiddenInGame;
+		if (bVisible || MeshComponent->GetCollisionEnabled() != ECollisionEnabled::NoCollision)
+		{
+			Obstacle.Meshes.Emplace(FindOrAddGroup(MeshComponent, bVisible), MeshComponent->GetComponentTransform());
+		}
+	}
+
+	Actor->Destroy();
+}
+
+int32 USnakeObstacleSubsystem::FindOrAddGroup(const UStaticMeshComponent* MeshComponent, bool bVisible)
+{
+	FString Key = MeshComponent->GetStaticMesh()->GetPathName();
+	for (int32 Index = 0; Index < MeshComponent->GetNumMaterials(); ++Index)
+	{
+		Key += TEXT("|") + GetPathNameSafe(MeshComponent->GetMaterial(Index));
+	}
+	Key += TEXT("|") + GetCollisionKey(MeshComponent);
+	Key += bVisible ? TEXT("|Visible") : TEXT("|Hidden");
+
+	if (const int32* Existing = GroupKeys.Find(Key))
+	{
+		return *Existing;
+	}
+
+	UHierarchicalInstancedStaticMeshComponent* Instances = NewObject<UHierarchicalInstancedStaticMeshComponent>(InstanceOwner);
+	Instances->SetMobility(EComponentMobility::Static);
+	Instances->SetStaticMesh(MeshComponent->GetStaticMesh());
+	for (int32 Index = 0; Index < MeshComponent->GetNumMaterials(); ++Index)
+	{
+		Instances->SetMaterial(Index, MeshComponent->GetMaterial(Index));
+	}
+
+	// Each instance gets its own body with the obstacle's collision, including any custom responses and hit events.
+	const FBodyInstance& SourceBody = MeshComponent->BodyInstance;
+	Instances->SetCollisionProfileName(SourceBody.GetCollisionProfileName());
+	Instances->SetCollisionObjectType(SourceBody.GetObjectType());
+	Instances->SetCollisionResponseToChannels(SourceBody.GetResponseToChannels());
+	Instances->SetCollisionEnabled(SourceBody.GetCollisionEnabled());
+	Instances->SetNotifyRigidBodyCollision(SourceBody.bNotifyRigidBodyCollision);
+	Instances->SetGenerateOverlapEvents(MeshComponent->GetGenerateOverlapEvents());
+	Instances->SetPhysMaterialOverride(SourceBody.GetSimplePhysicalMaterial());
+	Instances->BodyInstance.bUseCCD = SourceBody.bUseCCD;
+	Instances->SetCastShadow(bVisible && MeshComponent->CastShadow);
+	Instances->SetVisibility(bVisible);
+	Instances->OnComponentHit.AddDynamic(this, &USnakeObstacleSubsystem::OnObstacleHit);
+	Instances->SetupAttachment(InstanceOwner->GetRootComponent());
+	Instances->RegisterComponent();
+
+	const int32 GroupIndex = Groups.Add(Instances);
+	InstanceObstacles.AddDefaulted();
+	GroupKeys.Add(Key, GroupIndex);
+	return GroupIndex;
+}
+
+FString USnakeObstacleSubsystem::GetCollisionKey(const UStaticMeshComponent* MeshComponent)
+{
+	const FBodyInstance& Body = MeshComponent->BodyInstance;
+
+	FString Key = Body.GetCollisionProfileName().ToString();
+	Key += FString::Printf(TEXT("|%d|%d|"), (int32)Body.GetCollisionEnabled(), (int32)Body.GetObjectType());
+
+	// One digit per channel, since custom responses can differ from the profile's.
+	const FCollisionResponseContainer& Responses = Body.GetResponseToChannels();
+	for (int32 Channel = 0; Channel < ECC_MAX; ++Channel)
+	{
+		Key.AppendChar((TCHAR)(TEXT('0') + Responses.GetResponse((ECollisionChannel)Channel)));
+	}
+
+	Key += FString::Printf(TEXT("|%d%d%d|"), Body.bNotifyRigidBodyCollision ? 1 : 0, MeshComponent->GetGenerateOverlapEvents() ? 1 : 0, Body.bUseCCD ? 1 : 0);
+	Key += GetPathNameSafe(Body.GetSimplePhysicalMaterial());
+	return Key;
+}
+
+void USnakeObstacleSubsystem::AddObstacleInstances(int32 FirstObstacle)
+{
+	TArray<TArray<FTransform>> Transforms;
+	Transforms.SetNum(Groups.Num());
+
+	for (int32 ObstacleIndex = FirstObstacle; ObstacleIndex < Obstacles.Num(); ++ObstacleIndex)
+	{
+		for (const TPair<int32, FTransform>& Mesh : Obstacles[ObstacleIndex].Meshes)
+		{
+			Transforms[Mesh.Key].Add(Mesh.Value);
+			InstanceObstacles[Mesh.Key].Add(ObstacleIndex);
+		}
+	}
+
+	// Added in one go per component, so the cluster tree is only built once.
+	int32 NumInstances = 0;
+	for (int32 GroupIndex = 0; GroupIndex < Groups.Num(); ++GroupIndex)
+	{
+		if (!Transforms[GroupIndex].IsEmpty())
+		{
+			Groups[GroupIndex]->AddInstances(Transforms[GroupIndex], false, true);
+		}
+		NumInstances += InstanceObstacles[GroupIndex].Num();
+	}
+
+	SET_DWORD_STAT(STAT_SnakeObstacleInstances, NumInstances);
+}
+
+void USnakeObstacleSubsystem::RemoveLevelObstacles(ULevel* Level)
+{
+	// A null level means every level is going.
+	auto IsLeaving = [Level](const FSnakeCollapsedObstacle& Obstacle) { return !Level || Obstacle.Level == Level; };
+
+	// Where each obstacle ends up once the leaving ones are gone.
+	TArray<int32> NewIndices;
+	NewIndices.SetNumUninitialized(Obstacles.Num());
+	int32 NumKept = 0;
+	for (int32 ObstacleIndex = 0; ObstacleIndex < Obstacles.Num(); ++ObstacleIndex)
+	{
+		NewIndices[ObstacleIndex] = IsLeaving(Obstacles[ObstacleIndex]) ? INDEX_NONE : NumKept++;
+	}
+
+	if (NumKept == Obstacles.Num())
+	{
+		return;
+	}
+
+	int32 NumInstances = 0;
+	for (int32 GroupIndex = 0; GroupIndex < Groups.Num(); ++GroupIndex)
+	{
+		TArray<int32>& Owners = InstanceObstacles[GroupIndex];
+
+		TArray<int32> ToRemove;
+		for (int32 InstanceIndex = 0; InstanceIndex < Owners.Num(); ++InstanceIndex)
+		{
+			if (NewIndices[Owners[InstanceIndex]] == INDEX_NONE)
+			{
+				ToRemove.Add(InstanceIndex);
+			}
+		}
+
+		if (!ToRemove.IsEmpty())
+		{
+			// The component removes from the back, swapping its last instance into each gap, so do the same here.
+			Groups[GroupIndex]->RemoveInstances(ToRemove);
+			for (int32 Index = ToRemove.Num() - 1; Index >= 0; --Index)
+			{
+				Owners.RemoveAtSwap(ToRemove[Index], 1, EAllowShrinking::No);
+			}
+		}
+
+		for (int32& Owner : Owners)
+		{
+			Owner = NewIndices[Owner];
+		}
+		NumInstances += Owners.Num();
+	}
+
+	Obstacles.RemoveAll(IsLeaving);
+
+	SET_DWORD_STAT(STAT_SnakeObstacleInstances, NumInstances);
+}
+
+void USnakeObstacleSubsystem::RebuildInstances()
+{
+	for (int32 GroupIndex = 0; GroupIndex < Groups.Num(); ++GroupIndex)
+	{
+		Groups[GroupIndex]->ClearInstances();
+		InstanceObstacles[GroupIndex].Reset();
+	}
+
+	AddObstacleInstances(0);
+}
+
+void USnakeObstacleSubsystem::ExpandObstacles()
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	for (const FSnakeCollapsedObstacle& Obstacle : Obstacles)
+	{
+		ExpandedActors.Add(GetWorld()->SpawnActor<AActor>(Obstacle.Class, Obstacle.ActorTransform, SpawnParams));
+	}
+
+	for (int32 GroupIndex = 0; GroupIndex < Groups.Num(); ++GroupIndex)
+	{
+		Groups[GroupIndex]->ClearInstances();
+		InstanceObstacles[GroupIndex].Reset();
+	}
+}
+
+void USnakeObstacleSubsystem::OnLevelAdded(ULevel* Level, UWorld* InWorld)
+{
+	if (InWorld == GetWorld() && !BenchHandle.IsValid())
+	{
+		const int32 Before = Obstacles.Num();
+		CollapseLevel(Level);
+		if (Obstacles.Num() != Before)
+		{
+			AddObstacleInstances(Before);
+		}
+	}
+}
+
+void USnakeObstacleSubsystem::OnLevelRemoved(ULevel* Level, UWorld* InWorld)
+{
+	if (InWorld != GetWorld())
+	{
+		return;
+	}
+
+	// The benchmark's copies and expanded actors don't line up with the instances, so put the level back first.
+	if (BenchHandle.IsValid())
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Obstacle benchmark: stopped, a level streamed out"));
+		StopBenchmark();
+	}
+
+	RemoveLevelObstacles(Level);
+}
+
+void USnakeObstacleSubsystem::OnObstacleHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
+{
+	AHoopSnakeCharacter* Snake = Cast<AHoopSnakeCharacter>(OtherActor);
+	if (!Snake)
+	{
+		return;
+	}
+
+	// Hitting a wall while rolling knocks the snake out of hoop mode.
+	if (Snake->IsHoopModeEnabled())
+	{
+		Snake->ForceRagdoll();
+	}
+
+	OnObstacleInstanceHit.Broadcast(Cast<UHierarchicalInstancedStaticMeshComponent>(HitComponent), Hit.Item, Snake);
+}
+
+void USnakeObstacleSubsystem::RunBenchmark(int32 Multiplier, int32 FramesPerRun)
+{
+	StopBenchmark();
+
+	if (!InstanceOwner || Obstacles.IsEmpty())
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Obstacle benchmark: no obstacles have been collapsed"));
+		return;
+	}
+
+	// Scatter copies of each obstacle around it, as if the level had Multiplier times as many.
+	const int32 NumOriginal = Obstacles.Num();
+	for (int32 ObstacleIndex = 0; ObstacleIndex < NumOriginal; ++ObstacleIndex)
+	{
+		for (int32 Copy = 1; Copy < Multiplier; ++Copy)
+		{
+			const FVector2D Offset2D = FMath::RandPointInCircle(BenchSpreadRadius);
+			const FVector Offset(Offset2D.X, Offset2D.Y, 0.0f);
+
+			FSnakeCollapsedObstacle CopyObstacle = Obstacles[ObstacleIndex];
+			CopyObstacle.bBenchCopy = true;
+			CopyObstacle.ActorTransform.AddToTranslation(Offset);
+			for (TPair<int32, FTransform>& Mesh : CopyObstacle.Meshes)
+			{
+				Mesh.Value.AddToTranslation(Offset);
+			}
+			Obstacles.Add(MoveTemp(CopyObstacle));
+		}
+	}
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Obstacle benchmark: %d obstacles (%d x %d), %d frames per run"), Obstacles.Num(), NumOriginal, Multiplier, FramesPerRun);
+
+	// Actors first.
+	ExpandObstacles();
+
+	BenchFramesPerRun = FMath::Max(FramesPerRun, 10);
+	BenchRun = 0;
+	BenchSettleTime = 0.0;
+	BenchResults[0] = FSnakeObstacleBenchRun();
+	BenchResults[1] = FSnakeObstacleBenchRun();
+	BenchHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &USnakeObstacleSubsystem::TickBenchmark));
+}
+
+bool USnakeObstacleSubsystem::TickBenchmark(float DeltaTime)
+{
+	BenchSettleTime += DeltaTime;
+
+	// Skip the frames right after spawning or collapsing.
+	if (BenchSettleTime > 0.5)
+	{
+		FSnakeObstacleBenchRun& Run = BenchResults[BenchRun];
+		++Run.Frames;
+		Run.FrameMilliseconds += FApp::GetDeltaTime() * 1000.0;
+		Run.DrawCalls += GNumDrawCallsRHI[0];
+		Run.Primitives += GNumPrimitivesDrawnRHI[0];
+		Run.Actors = GetWorld()->GetActorCount();
+
+		Run.TickingObstacles = 0;
+		for (const TWeakObjectPtr<AActor>& Actor : ExpandedActors)
+		{
+			Run.TickingObstacles += (Actor.IsValid() && Actor->IsActorTickEnabled()) ? 1 : 0;
+		}
+	}
+
+	if (BenchResults[BenchRun].Frames < BenchFramesPerRun)
+	{
+		return true;
+	}
+
+	if (BenchRun == 0)
+	{
+		// Then instances, collapsed from the actors just measured.
+		for (const TWeakObjectPtr<AActor>& Actor : ExpandedActors)
+		{
+			if (Actor.IsValid())
+			{
+				Actor->Destroy();
+			}
+		}
+		ExpandedActors.Reset();
+		RebuildInstances();
+
+		BenchRun = 1;
+		BenchSettleTime = 0.0;
+		return true;
+	}
+
+	static const TCHAR* RunNames[] = { TEXT("actors"), TEXT("instances") };
+	for (int32 RunIndex = 0; RunIndex < 2; ++RunIndex)
+	{
+		const FSnakeObstacleBenchRun& Run = BenchResults[RunIndex];
+		UE_LOG(LogHoopSnake, Display, TEXT("  %-9s %6.2f ms/frame, %6lld draw calls, %8lld primitives, %5d actors, %5d ticking obstacles"),
+			RunNames[RunIndex], Run.FrameMilliseconds / Run.Frames, Run.DrawCalls / Run.Frames, Run.Primitives / Run.Frames, Run.Actors, Run.TickingObstacles);
+	}
+
+	BenchHandle.Reset();
+	StopBenchmark();
+	return false;
+}
+
+void USnakeObstacleSubsystem::StopBenchmark()
+{
+	if (BenchHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(BenchHandle);
+		BenchHandle.Reset();
+	}
+
+	// Put the level back to its own obstacles, as instances.
+	const bool bWasExpanded = !ExpandedActors.IsEmpty();
+	for (const TWeakObjectPtr<AActor>& Actor : ExpandedActors)
+	{
+		if (Actor.IsValid())
+		{
+			Actor->Destroy();
+		}
+	}
+	ExpandedActors.Reset();
+
+	const int32 NumRemoved = Obstacles.RemoveAll([](const FSnakeCollapsedObstacle& Obstacle) { return Obstacle.bBenchCopy; });
+	if ((NumRemoved > 0 || bWasExpanded) && !Groups.IsEmpty())
+	{
+		RebuildInstances();
+	}
+}
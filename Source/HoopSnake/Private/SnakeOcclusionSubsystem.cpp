@@ -0,0 +1,244 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeOcclusionSubsystem.h"
+#include "HoopSnakeCharacter.h"
+#include "Camera/CameraComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HoopSnake.h"
+
+DECLARE_CYCLE_STAT(TEXT("Snake Occlusion"), STAT_SnakeOcclusion, STATGROUP_HoopSnake);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Occlusion Sweeps"), STAT_SnakeOcclusionSweeps, STATGROUP_HoopSnake);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Faded Occluders"), STAT_SnakeFadedOccluders, STATGROUP_HoopSnake);
+
+USnakeOcclusionSubsystem::USnakeOcclusionSubsystem()
+{
+	bFadeOccluders = false;
+	OccluderTag = "Occluder";
+	OpacityDataIndex = 0;
+	OccludedOpacity = 0.25f;
+	FadeSpeed = 4.0f;
+	SweepRadius = 10.0f;
+
+	LoadedOccluderClass = nullptr;
+	bOccluderClassResolved = false;
+	NumSweeps = 0;
+}
+
+TStatId USnakeOcclusionSubsystem::GetStatId() const
+{
+	return GET_STATID(STAT_SnakeOcclusion);
+}
+
+void USnakeOcclusionSubsystem::Deinitialize()
+{
+	PendingSweeps.Empty();
+	Fades.Empty();
+
+	Super::Deinitialize();
+}
+
+void USnakeOcclusionSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (!bFadeOccluders)
+	{
+		return;
+	}
+
+	// Custom primitive data starts at 0, which the occluder material would draw as invisible until the first fade wrote to it.
+	ResolveOccluderClass();
+	for (TActorIterator<AActor> It(&InWorld); It; ++It)
+	{
+		if (IsOccluder(*It))
+		{
+			InitOccluderOpacity(*It);
+		}
+	}
+}
+
+void USnakeOcclusionSubsystem::ResolveOccluderClass()
+{
+	if (bOccluderClassResolved)
+	{
+		return;
+	}
+
+	bOccluderClassResolved = true;
+	if (OccluderClass.IsValid())
+	{
+		LoadedOccluderClass = OccluderClass.TryLoadClass<AActor>();
+		if (!LoadedOccluderClass)
+		{
+			UE_LOG(LogHoopSnake, Warning, TEXT("Occlusion: %s isn't an actor class, only actors tagged %s will fade."), *OccluderClass.ToString(), *OccluderTag.ToString());
+		}
+	}
+}
+
+void USnakeOcclusionSubsystem::InitOccluderOpacity(AActor* Actor) const
+{
+	TInlineComponentArray<UPrimitiveComponent*> Primitives(Actor);
+	for (UPrimitiveComponent* Primitive : Primitives)
+	{
+		Primitive->SetCustomPrimitiveDataFloat(OpacityDataIndex, 1.0f);
+	}
+}
+
+bool USnakeOcclusionSubsystem::IsOccluder(const AActor* Actor) const
+{
+	return Actor && (Actor->ActorHasTag(OccluderTag) || (LoadedOccluderClass && Actor->IsA(LoadedOccluderClass)));
+}
+
+void USnakeOcclusionSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SnakeOcclusion);
+
+	if (!bFadeOccluders)
+	{
+		return;
+	}
+
+	ResolveOccluderClass();
+
+	// Nothing is in the way unless last frame's sweeps say so.
+	for (TPair<TWeakObjectPtr<AActor>, FSnakeOccluderFade>& Fade : Fades)
+	{
+		Fade.Value.bOccluding = false;
+	}
+
+	CollectSweeps();
+
+	int32 SweepsThisFrame = 0;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController && PlayerController->IsLocalController())
+		{
+			if (const AHoopSnakeCharacter* Snake = PlayerController->GetPawn<AHoopSnakeCharacter>())
+			{
+				IssueSweep(Snake);
+				++SweepsThisFrame;
+			}
+		}
+	}
+
+	UpdateFades(DeltaTime);
+
+	SET_DWORD_STAT(STAT_SnakeOcclusionSweeps, SweepsThisFrame);
+	SET_DWORD_STAT(STAT_SnakeFadedOccluders, Fades.Num());
+}
+
+void USnakeOcclusionSubsystem::IssueSweep(const AHoopSnakeCharacter* Snake)
+{
+	const FVector Start = Snake->GetFollowCamera()->GetComponentLocation();
+	const FVector End = Snake->GetMesh()->GetSocketLocation(Snake->GetHeadBoneName());
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(SnakeOcclusion), false, Snake);
+
+	FCollisionObjectQueryParams ObjectParams;
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldStatic);
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+
+	// Read back next frame, by which time the physics thread has long finished with it.
+	PendingSweeps.Add(GetWorld()->AsyncSweepByObjectType(EAsyncTraceType::Multi, Start, End, FQuat::Identity, ObjectParams, FCollisionShape::MakeSphere(SweepRadius), Params));
+	++NumSweeps;
+}
+
+void USnakeOcclusionSubsystem::CollectSweeps()
+{
+	FTraceDatum Datum;
+	for (const FTraceHandle& Handle : PendingSweeps)
+	{
+		if (!GetWorld()->QueryTraceData(Handle, Datum))
+		{
+			continue;
+		}
+
+		for (const FHitResult& Hit : Datum.OutHits)
+		{
+			AActor* Actor = Hit.GetActor();
+			if (!IsOccluder(Actor))
+			{
+				continue;
+			}
+
+			FSnakeOccluderFade* Fade = Fades.Find(Actor);
+			if (!Fade)
+			{
+				// Every primitive on the occluder fades together. Occluders streamed in after play started haven't been given full opacity yet.
+				InitOccluderOpacity(Actor);
+				Fade = &Fades.Add(Actor);
+				TInlineComponentArray<UPrimitiveComponent*> Primitives(Actor);
+				for (UPrimitiveComponent* Primitive : Primitives)
+				{
+					Fade->Components.Add(Primitive);
+				}
+			}
+
+			Fade->bOccluding = true;
+		}
+	}
+
+	PendingSweeps.Reset();
+}
+
+void USnakeOcclusionSubsystem::UpdateFades(float DeltaTime)
+{
+	for (auto It = Fades.CreateIterator(); It; ++It)
+	{
+		FSnakeOccluderFade& Fade = It.Value();
+		if (!It.Key().IsValid())
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+
+		const float TargetOpacity = Fade.bOccluding ? OccludedOpacity : 1.0f;
+		Fade.Opacity = FMath::FInterpConstantTo(Fade.Opacity, TargetOpacity, DeltaTime, FadeSpeed);
+
+		if (Fade.Opacity != Fade.AppliedOpacity)
+		{
+			for (const TWeakObjectPtr<UPrimitiveComponent>& Component : Fade.Components)
+			{
+				if (UPrimitiveComponent* Primitive = Component.Get())
+				{
+					Primitive->SetCustomPrimitiveDataFloat(OpacityDataIndex, Fade.Opacity);
+				}
+			}
+			Fade.AppliedOpacity = Fade.Opacity;
+		}
+
+		// Fully back, nothing left to do for it.
+		if (!Fade.bOccluding && Fade.Opacity >= 1.0f)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void USnakeOcclusionSubsystem::LogStats() const
+{
+	// Any dynamic material instances still on occluders come from somewhere other than this subsystem.
+	int32 NumDynamicMaterials = 0;
+	for (const TPair<TWeakObjectPtr<AActor>, FSnakeOccluderFade>& Fade : Fades)
+	{
+		for (const TWeakObjectPtr<UPrimitiveComponent>& Component : Fade.Value.Components)
+		{
+			if (const UPrimitiveComponent* Primitive = Component.Get())
+			{
+				for (int32 Index = 0; Index < Primitive->GetNumMaterials(); ++Index)
+				{
+					NumDynamicMaterials += Cast<UMaterialInstanceDynamic>(Primitive->GetMaterial(Index)) ? 1 : 0;
+				}
+			}
+		}
+	}
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Occlusion: %d sweeps issued, %d occluders fading, %d dynamic material instances on them"), NumSweeps, Fades.Num(), NumDynamicMaterials);
+}
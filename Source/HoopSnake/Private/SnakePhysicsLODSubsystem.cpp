@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakePhysicsLODSubsystem.h"
+#include "PhysicsEngine/PhysicsAsset.h"
+
+void USnakePhysicsLODSubsystem::Deinitialize()
+{
+	ReducedAssets.Empty();
+
+	Super::Deinitialize();
+}
+
+UPhysicsAsset* USnakePhysicsLODSubsystem::FindReducedAsset(UPhysicsAsset* FullAsset, int32 Stride) const
+{
+	return ReducedAssets.FindRef(TPair<TWeakObjectPtr<UPhysicsAsset>, int32>(FullAsset, Stride)).Get();
+}
+
+void USnakePhysicsLODSubsystem::AddReducedAsset(UPhysicsAsset* FullAsset, int32 Stride, UPhysicsAsset* ReducedAsset)
+{
+	// Only ever grows when something is built, so this is the time to clear out what's been collected since the last one.
+	PruneStaleAssets();
+
+	ReducedAssets.Add(TPair<TWeakObjectPtr<UPhysicsAsset>, int32>(FullAsset, Stride), ReducedAsset);
+}
+
+void USnakePhysicsLODSubsystem::PruneStaleAssets()
+{
+	for (auto It = ReducedAssets.CreateIterator(); It; ++It)
+	{
+		if (!It->Key.Key.IsValid() || !It->Value.IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
@@ -0,0 +1,404 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakePhysicsProfiler.h"
+#include "HoopSnakeCharacter.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "PhysicsEngine/ConstraintInstance.h"
+#include "PhysicsEngine/PhysicsAsset.h"
+#include "PhysicsEngine/PhysicsConstraintActor.h"
+#include "PhysicsEngine/PhysicsConstraintComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HoopSnake.h"
+#include "EngineUtils.h"
+
+DECLARE_CYCLE_STAT(TEXT("Snake Physics Profiler"), STAT_SnakePhysicsProfiler, STATGROUP_HoopSnake);
+
+USnakePhysicsProfiler::USnakePhysicsProfiler()
+{
+	ActivePresetIndex = INDEX_NONE;
+	SecondsPerPreset = 10.0f;
+	PresetElapsed = 0.0f;
+}
+
+TStatId USnakePhysicsProfiler::GetStatId() const
+{
+	return GET_STATID(STAT_SnakePhysicsProfiler);
+}
+
+void USnakePhysicsProfiler::Deinitialize()
+{
+	StopProfiling();
+
+	Super::Deinitialize();
+}
+
+void USnakePhysicsProfiler::StartProfiling(FName PresetName, float InSecondsPerPreset)
+{
+	StopProfiling();
+
+	PresetQueue.Reset();
+	for (int32 Index = 0; Index < Presets.Num(); ++Index)
+	{
+		if (PresetName.IsNone() || Presets[Index].Name == PresetName)
+		{
+			PresetQueue.Add(Index);
+		}
+	}
+
+	if (PresetQueue.IsEmpty())
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Snake physics profile: no preset called %s"), *PresetName.ToString());
+		return;
+	}
+
+	SecondsPerPreset = FMath::Max(InSecondsPerPreset, 1.0f);
+	SummaryLines.Reset();
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Snake physics profile: %d presets, %.1fs each"), PresetQueue.Num(), SecondsPerPreset);
+
+	BeginPreset(PresetQueue[0]);
+	PresetQueue.RemoveAt(0);
+}
+
+void USnakePhysicsProfiler::StopProfiling()
+{
+	if (!IsProfiling())
+	{
+		return;
+	}
+
+	PresetQueue.Reset();
+	EndPreset();
+	WriteSummary();
+}
+
+void USnakePhysicsProfiler::WriteSummary()
+{
+	FString Summary = TEXT("Preset,Frames,AvgFrameMs,MaxFrameMs,AvgIslandBodies,MaxIslandBodies,AvgAwakeBodies,AvgConstraints,HitEvents\n");
+	for (const FString& Line : SummaryLines)
+	{
+		Summary += Line;
+	}
+
+	const FString SummaryPath = FPaths::ProfilingDir() / TEXT("SnakePhysicsSummary.csv");
+	if (FFileHelper::SaveStringToFile(Summary, *SummaryPath))
+	{
+		UE_LOG(LogHoopSnake, Display, TEXT("Snake physics profile summary written to %s"), *SummaryPath);
+	}
+	else
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Failed to write snake physics profile summary to %s"), *SummaryPath);
+	}
+}
+
+void USnakePhysicsProfiler::BeginPreset(int32 PresetIndex)
+{
+	const FSnakePhysicsPreset& Preset = Presets[PresetIndex];
+
+	ActivePresetIndex = PresetIndex;
+	PresetElapsed = 0.0f;
+	Samples.Reset();
+	HitEventCounts.Reset();
+
+	// Solver settings are global, so they're set once for the preset rather than per snake.
+	for (const FSnakePhysicsConsoleVariable& Override : Preset.ConsoleVariables)
+	{
+		IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(*Override.Name);
+		if (!CVar)
+		{
+			UE_LOG(LogHoopSnake, Warning, TEXT("Snake physics profile: unknown console variable %s"), *Override.Name);
+			continue;
+		}
+
+		// Set at the priority the variable already has. Raising it to SetByCode would stop ini and scalability changes reaching it after the profile.
+		const EConsoleVariableFlags SetBy = (EConsoleVariableFlags)(CVar->GetFlags() & ECVF_SetByMask);
+		SavedCVarValues.Add(Override.Name, { CVar->GetString(), SetBy });
+		CVar->Set(*Override.Value, SetBy);
+	}
+
+	for (TActorIterator<AHoopSnakeCharacter> It(GetWorld()); It; ++It)
+	{
+		ApplyPresetToSnake(*It, Preset);
+	}
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Snake physics profile: recording %s on %d snakes"), *Preset.Name.ToString(), ProfiledSnakes.Num());
+}
+
+void USnakePhysicsProfiler::EndPreset()
+{
+	if (!IsProfiling())
+	{
+		return;
+	}
+
+	const FSnakePhysicsPreset& Preset = Presets[ActivePresetIndex];
+
+	// Per frame samples, with the preset's solver overrides at the top so the file stands on its own.
+	FString Report = FString::Printf(TEXT("# Preset %s\n"), *Preset.Name.ToString());
+	for (const FSnakePhysicsConsoleVariable& Override : Preset.ConsoleVariables)
+	{
+		Report += FString::Printf(TEXT("# %s=%s\n"), *Override.Name, *Override.Value);
+	}
+	if (!Preset.PhysicsAsset.IsNull())
+	{
+		Report += FString::Printf(TEXT("# PhysicsAsset=%s\n"), *Preset.PhysicsAsset.ToString());
+	}
+	Report += TEXT("Frame,FrameMs,Snake,IslandBodies,SimulatedBodies,AwakeBodies,Constraints,BiteConstraints,HitEvents,PositionIterations,VelocityIterations,ProjectionIterations\n");
+
+	double TotalFrameMs = 0.0;
+	float MaxFrameMs = 0.0f;
+	int64 TotalIslandBodies = 0;
+	int32 MaxIslandBodies = 0;
+	int64 TotalAwakeBodies = 0;
+	int64 TotalConstraints = 0;
+	int32 TotalHitEvents = 0;
+	uint64 LastFrame = 0;
+	int32 NumFrames = 0;
+
+	for (const FSnakePhysicsSample& Sample : Samples)
+	{
+		Report += FString::Printf(TEXT("%llu,%.3f,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d\n"), Sample.Frame, Sample.DeltaMilliseconds, *Sample.SnakeName,
+			Sample.IslandBodies, Sample.SimulatedBodies, Sample.AwakeBodies, Sample.Constraints, Sample.BiteConstraints, Sample.HitEvents,
+			Sample.PositionIterations, Sample.VelocityIterations, Sample.ProjectionIterations);
+
+		// Several snakes share a frame, only count its time once.
+		if (NumFrames == 0 || Sample.Frame != LastFrame)
+		{
+			TotalFrameMs += Sample.DeltaMilliseconds;
+			MaxFrameMs = FMath::Max(MaxFrameMs, Sample.DeltaMilliseconds);
+			LastFrame = Sample.Frame;
+			++NumFrames;
+		}
+
+		TotalIslandBodies += Sample.IslandBodies;
+		MaxIslandBodies = FMath::Max(MaxIslandBodies, Sample.IslandBodies);
+		TotalAwakeBodies += Sample.AwakeBodies;
+		TotalConstraints += Sample.Constraints;
+		TotalHitEvents += Sample.HitEvents;
+	}
+
+	const FString ReportPath = FPaths::ProfilingDir() / FString::Printf(TEXT("SnakePhysics_%s.csv"), *Preset.Name.ToString());
+	if (FFileHelper::SaveStringToFile(Report, *ReportPath))
+	{
+		UE_LOG(LogHoopSnake, Display, TEXT("Snake physics profile for %s written to %s"), *Preset.Name.ToString(), *ReportPath);
+	}
+	else
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Failed to write snake physics profile to %s"), *ReportPath);
+	}
+
+	const int32 NumSamples = FMath::Max(Samples.Num(), 1);
+	SummaryLines.Add(FString::Printf(TEXT("%s,%d,%.3f,%.3f,%.2f,%d,%.2f,%.2f,%d\n"), *Preset.Name.ToString(), NumFrames,
+		NumFrames > 0 ? TotalFrameMs / NumFrames : 0.0, MaxFrameMs, (double)TotalIslandBodies / NumSamples, MaxIslandBodies,
+		(double)TotalAwakeBodies / NumSamples, (double)TotalConstraints / NumSamples, TotalHitEvents));
+
+	// Put everything back before the next preset, so presets don't stack.
+	for (const FProfiledSnake& Profiled : ProfiledSnakes)
+	{
+		RestoreSnake(Profiled);
+	}
+	ProfiledSnakes.Reset();
+
+	for (const TPair<FString, FSavedConsoleVariable>& Saved : SavedCVarValues)
+	{
+		if (IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(*Saved.Key))
+		{
+			CVar->Set(*Saved.Value.Value, Saved.Value.SetBy);
+		}
+	}
+	SavedCVarValues.Empty();
+
+	Samples.Reset();
+	HitEventCounts.Reset();
+	ActivePresetIndex = INDEX_NONE;
+}
+
+void USnakePhysicsProfiler::ApplyPresetToSnake(AHoopSnakeCharacter* Snake, const FSnakePhysicsPreset& Preset)
+{
+	USkeletalMeshComponent* Mesh = Snake->GetMesh();
+	ProfiledSnakes.Add({ Snake, Mesh->GetPhysicsAsset(), Mesh->BodyInstance.bNotifyRigidBodyCollision });
+
+	// Swapping physics assets is how bone count reductions are compared, the reduced asset is authored in the editor.
+	if (!Preset.PhysicsAsset.IsNull())
+	{
+		if (UPhysicsAsset* PhysicsAsset = Cast<UPhysicsAsset>(Preset.PhysicsAsset.TryLoad()))
+		{
+			Mesh->SetPhysicsAsset(PhysicsAsset, true);
+		}
+		else
+		{
+			UE_LOG(LogHoopSnake, Warning, TEXT("Snake physics profile: couldn't load physics asset %s"), *Preset.PhysicsAsset.ToString());
+		}
+	}
+
+	// The head keeps its full collision so biting still works.
+	const int32 HeadBodyIndex = Mesh->GetPhysicsAsset() ? Mesh->GetPhysicsAsset()->FindBodyIndex(Snake->GetHeadBoneName()) : INDEX_NONE;
+	for (int32 BodyIndex = 0; BodyIndex < Mesh->Bodies.Num(); ++BodyIndex)
+	{
+		FBodyInstance* Body = Mesh->Bodies[BodyIndex];
+		if (!Body || BodyIndex == HeadBodyIndex)
+		{
+			continue;
+		}
+
+		for (const TEnumAsByte<ECollisionChannel>& Channel : Preset.IgnoredChannels)
+		{
+			Body->SetResponseToChannel(Channel, ECR_Ignore);
+		}
+	}
+
+	// Hit events are only sent for bodies that ask for them, which the snake's don't by default. Set after any asset swap, which recreates the bodies.
+	Mesh->SetNotifyRigidBodyCollision(true);
+	Mesh->OnComponentHit.AddUniqueDynamic(this, &USnakePhysicsProfiler::OnSnakeMeshHit);
+}
+
+void USnakePhysicsProfiler::RestoreSnake(const FProfiledSnake& Profiled)
+{
+	AHoopSnakeCharacter* Snake = Profiled.Snake.Get();
+	if (!IsValid(Snake))
+	{
+		return;
+	}
+
+	USkeletalMeshComponent* Mesh = Snake->GetMesh();
+	Mesh->OnComponentHit.RemoveDynamic(this, &USnakePhysicsProfiler::OnSnakeMeshHit);
+
+	UPhysicsAsset* OriginalPhysicsAsset = Profiled.OriginalPhysicsAsset.Get();
+	if (OriginalPhysicsAsset && Mesh->GetPhysicsAsset() != OriginalPhysicsAsset)
+	{
+		Mesh->SetPhysicsAsset(OriginalPhysicsAsset, true);
+	}
+
+	Mesh->SetNotifyRigidBodyCollision(Profiled.bOriginalNotifyRigidBodyCollision);
+
+	// Bodies take their responses from the component, so copying the component's back undoes any ignored channels.
+	const FCollisionResponseContainer& Responses = Mesh->GetCollisionResponseToChannels();
+	for (FBodyInstance* Body : Mesh->Bodies)
+	{
+		if (Body)
+		{
+			Body->SetResponseToChannels(Responses);
+		}
+	}
+}
+
+void USnakePhysicsProfiler::OnSnakeMeshHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
+{
+	++HitEventCounts.FindOrAdd(HitComponent);
+}
+
+void USnakePhysicsProfiler::Tick(float DeltaTime)
+{
+	if (!IsProfiling())
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_SnakePhysicsProfiler);
+
+	for (const FProfiledSnake& Profiled : ProfiledSnakes)
+	{
+		if (AHoopSnakeCharacter* Snake = Profiled.Snake.Get())
+		{
+			SampleSnake(Snake, DeltaTime);
+		}
+	}
+
+	HitEventCounts.Reset();
+
+	PresetElapsed += DeltaTime;
+	if (PresetElapsed < SecondsPerPreset)
+	{
+		return;
+	}
+
+	EndPreset();
+
+	if (PresetQueue.IsEmpty())
+	{
+		WriteSummary();
+	}
+	else
+	{
+		BeginPreset(PresetQueue[0]);
+		PresetQueue.RemoveAt(0);
+	}
+}
+
+void USnakePhysicsProfiler::SampleSnake(AHoopSnakeCharacter* Snake, float DeltaTime)
+{
+	FSnakePhysicsSample& Sample = Samples.AddDefaulted_GetRef();
+	Sample.Frame = GFrameCounter;
+	Sample.DeltaMilliseconds = DeltaTime * 1000.0f;
+	Sample.SnakeName = Snake->GetName();
+
+	USkeletalMeshComponent* Mesh = Snake->GetMesh();
+	Sample.HitEvents = HitEventCounts.FindRef(Mesh);
+
+	// Counts the simulating bodies and joints of one skeletal mesh into the sample
+	auto AddMesh = [&Sample](const USkeletalMeshComponent* SkeletalMesh, bool bIsSnake)
+	{
+		int32 SimulatedBodies = 0;
+		for (const FBodyInstance* Body : SkeletalMesh->Bodies)
+		{
+			if (!Body || !Body->IsInstanceSimulatingPhysics())
+			{
+				continue;
+			}
+
+			++SimulatedBodies;
+			if (Body->IsInstanceAwake())
+			{
+				++Sample.AwakeBodies;
+			}
+
+			Sample.PositionIterations = FMath::Max<int32>(Sample.PositionIterations, Body->PositionSolverIterationCount);
+			Sample.VelocityIterations = FMath::Max<int32>(Sample.VelocityIterations, Body->VelocitySolverIterationCount);
+			Sample.ProjectionIterations = FMath::Max<int32>(Sample.ProjectionIterations, Body->ProjectionSolverIterationCount);
+		}
+
+		// Joints only cost anything in the solver while their bodies simulate.
+		if (SimulatedBodies > 0)
+		{
+			Sample.Constraints += SkeletalMesh->Constraints.Num();
+		}
+
+		Sample.IslandBodies += SimulatedBodies;
+		if (bIsSnake)
+		{
+			Sample.SimulatedBodies = SimulatedBodies;
+		}
+	};
+
+	AddMesh(Mesh, true);
+
+	// The bite constraint is owned by the snake, and joins the victim's ragdoll into the snake's island.
+	for (AActor* Child : Snake->Children)
+	{
+		const APhysicsConstraintActor* Constraint = Cast<APhysicsConstraintActor>(Child);
+		if (!Constraint)
+		{
+			continue;
+		}
+
+		++Sample.BiteConstraints;
+		++Sample.Constraints;
+
+		UPrimitiveComponent* FirstComponent, * SecondComponent;
+		FName FirstBone, SecondBone;
+		Constraint->GetConstraintComp()->GetConstrainedComponents(FirstComponent, FirstBone, SecondComponent, SecondBone);
+
+		for (const UPrimitiveComponent* Component : { FirstComponent, SecondComponent })
+		{
+			const USkeletalMeshComponent* VictimMesh = Cast<USkeletalMeshComponent>(Component);
+			if (VictimMesh && VictimMesh != Mesh)
+			{
+				AddMesh(VictimMesh, false);
+			}
+		}
+	}
+}
@@ -0,0 +1,317 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeScalabilitySubsystem.h"
+#include "HoopSnakeCharacter.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/App.h"
+#include "HoopSnake.h"
+
+DECLARE_CYCLE_STAT(TEXT("Scalability Controller"), STAT_SnakeScalability, STATGROUP_HoopSnake);
+
+void FSnakeFrameBudgetController::Reset(const FSnakeFrameBudgetSettings& InSettings, float InMaxScreenPercentage)
+{
+	Settings = InSettings;
+	MaxScreenPercentage = InMaxScreenPercentage;
+	ScreenPercentage = InMaxScreenPercentage;
+	FeatureDowngrades = 0;
+	SmoothedFrameMilliseconds = 0.0f;
+	FramesOverBudget = 0;
+	FramesUnderThreshold = 0;
+	CooldownFramesLeft = 0;
+	bHasFrame = false;
+}
+
+bool FSnakeFrameBudgetController::AddFrame(float FrameMilliseconds)
+{
+	// Smooth out single hitches, those aren't something resolution can fix.
+	SmoothedFrameMilliseconds = bHasFrame ? FMath::Lerp(SmoothedFrameMilliseconds, FrameMilliseconds, Settings.SmoothingFactor) : FrameMilliseconds;
+	bHasFrame = true;
+
+	if (CooldownFramesLeft > 0)
+	{
+		--CooldownFramesLeft;
+		return false;
+	}
+
+	FramesOverBudget = SmoothedFrameMilliseconds > Settings.TargetFrameMilliseconds ? FramesOverBudget + 1 : 0;
+	FramesUnderThreshold = SmoothedFrameMilliseconds < Settings.TargetFrameMilliseconds * Settings.RaiseThreshold ? FramesUnderThreshold + 1 : 0;
+
+	if (FramesOverBudget >= Settings.FramesToLower)
+	{
+		FramesOverBudget = 0;
+		return Lower();
+	}
+
+	if (FramesUnderThreshold >= Settings.FramesToRaise)
+	{
+		FramesUnderThreshold = 0;
+		return Raise();
+	}
+
+	return false;
+}
+
+bool FSnakeFrameBudgetController::Lower()
+{
+	if (ScreenPercentage > Settings.MinScreenPercentage)
+	{
+		ScreenPercentage = FMath::Max(ScreenPercentage - Settings.ScreenPercentageStep, Settings.MinScreenPercentage);
+	}
+	else if (FeatureDowngrades < Settings.MaxFeatureDowngrades)
+	{
+		++FeatureDowngrades;
+	}
+	else
+	{
+		return false;
+	}
+
+	CooldownFramesLeft = Settings.CooldownFrames;
+	return true;
+}
+
+bool FSnakeFrameBudgetController::Raise()
+{
+	if (FeatureDowngrades > 0)
+	{
+		--FeatureDowngrades;
+	}
+	else if (ScreenPercentage < MaxScreenPercentage)
+	{
+		ScreenPercentage = FMath::Min(ScreenPercentage + Settings.ScreenPercentageStep, MaxScreenPercentage);
+	}
+	else
+	{
+		return false;
+	}
+
+	CooldownFramesLeft = Settings.CooldownFrames;
+	return true;
+}
+
+USnakeScalabilitySubsystem::USnakeScalabilitySubsystem()
+{
+	bAdaptInHoopMode = true;
+	TargetFrameRate = 60.0f;
+	RaiseThreshold = 0.8f;
+	MinScreenPercentage = 50.0f;
+	ScreenPercentageStep = 10.0f;
+	FramesToLower = 15;
+	FramesToRaise = 90;
+	CooldownFrames = 30;
+
+	bAdapting = false;
+	AppliedFeatureDowngrades = 0;
+}
+
+TStatId USnakeScalabilitySubsystem::GetStatId() const
+{
+	return GET_STATID(STAT_SnakeScalability);
+}
+
+void USnakeScalabilitySubsystem::Deinitialize()
+{
+	RestoreAll();
+
+	Super::Deinitialize();
+}
+
+FSnakeFrameBudgetSettings USnakeScalabilitySubsystem::MakeSettings() const
+{
+	FSnakeFrameBudgetSettings Settings;
+	Settings.TargetFrameMilliseconds = 1000.0f / FMath::Max(TargetFrameRate, 1.0f);
+	Settings.RaiseThreshold = RaiseThreshold;
+	Settings.MinScreenPercentage = MinScreenPercentage;
+	Settings.ScreenPercentageStep = FMath::Max(ScreenPercentageStep, 1.0f);
+	Settings.MaxFeatureDowngrades = FeatureDowngrades.Num();
+	Settings.FramesToLower = FramesToLower;
+	Settings.FramesToRaise = FramesToRaise;
+	Settings.CooldownFrames = CooldownFrames;
+	return Settings;
+}
+
+void USnakeScalabilitySubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SnakeScalability);
+
+	const AHoopSnakeCharacter* Snake = Cast<AHoopSnakeCharacter>(UGameplayStatics::GetPlayerPawn(this, 0));
+	const bool bShouldAdapt = bAdaptInHoopMode && Snake && Snake->IsHoopModeEnabled();
+
+	if (!bShouldAdapt)
+	{
+		// Out of hoop mode the normal FOV is back, and so are the scalability settings.
+		if (bAdapting)
+		{
+			RestoreAll();
+		}
+		return;
+	}
+
+	if (!bAdapting)
+	{
+		// Work down from whatever the scalability settings picked. 0 or less means the renderer's default of 100.
+		const IConsoleVariable* ScreenPercentage = IConsoleManager::Get().FindConsoleVariable(TEXT("r.ScreenPercentage"));
+		const float CurrentScreenPercentage = ScreenPercentage ? ScreenPercentage->GetFloat() : 100.0f;
+
+		Controller.Reset(MakeSettings(), CurrentScreenPercentage > 0.0f ? CurrentScreenPercentage : 100.0f);
+		bAdapting = true;
+	}
+
+	// Real frame time, not the world's dilated delta.
+	if (Controller.AddFrame(FApp::GetDeltaTime() * 1000.0f))
+	{
+		ApplyDecision();
+	}
+}
+
+void USnakeScalabilitySubsystem::ApplyDecision()
+{
+	SetConsoleVariable(TEXT("r.ScreenPercentage"), FString::SanitizeFloat(Controller.GetScreenPercentage()));
+
+	const int32 WantedDowngrades = FMath::Min(Controller.GetFeatureDowngrades(), FeatureDowngrades.Num());
+	while (AppliedFeatureDowngrades < WantedDowngrades)
+	{
+		const FSnakeFeatureDowngrade& Downgrade = FeatureDowngrades[AppliedFeatureDowngrades++];
+		for (const FSnakeScalabilityConsoleVariable& Override : Downgrade.ConsoleVariables)
+		{
+			SetConsoleVariable(Override.Name, Override.Value);
+		}
+		UE_LOG(LogHoopSnake, Log, TEXT("Scalability: applied %s"), *Downgrade.Name.ToString());
+	}
+
+	while (AppliedFeatureDowngrades > WantedDowngrades)
+	{
+		const FSnakeFeatureDowngrade& Downgrade = FeatureDowngrades[--AppliedFeatureDowngrades];
+		for (const FSnakeScalabilityConsoleVariable& Override : Downgrade.ConsoleVariables)
+		{
+			RestoreConsoleVariable(Override.Name);
+		}
+		UE_LOG(LogHoopSnake, Log, TEXT("Scalability: removed %s"), *Downgrade.Name.ToString());
+	}
+
+	UE_LOG(LogHoopSnake, Verbose, TEXT("Scalability: %.1f ms smoothed, screen percentage %.0f, %d feature downgrades"),
+		Controller.GetSmoothedFrameMilliseconds(), Controller.GetScreenPercentage(), AppliedFeatureDowngrades);
+}
+
+void USnakeScalabilitySubsystem::RestoreAll()
+{
+	for (const TPair<FString, FSavedConsoleVariable>& Saved : SavedCVarValues)
+	{
+		if (IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(*Saved.Key))
+		{
+			CVar->Set(*Saved.Value.Value, Saved.Value.SetBy);
+		}
+	}
+
+	SavedCVarValues.Empty();
+	AppliedFeatureDowngrades = 0;
+	bAdapting = false;
+}
+
+void USnakeScalabilitySubsystem::SetConsoleVariable(const FString& Name, const FString& Value)
+{
+	IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(*Name);
+	if (!CVar)
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Scalability: unknown console variable %s"), *Name);
+		return;
+	}
+
+	// Stay at the priority the variable already has. SetByCode would outrank scalability and game settings for the rest of the session.
+	const EConsoleVariableFlags SetBy = (EConsoleVariableFlags)(CVar->GetFlags() & ECVF_SetByMask);
+	if (!SavedCVarValues.Contains(Name))
+	{
+		SavedCVarValues.Add(Name, { CVar->GetString(), SetBy });
+	}
+
+	CVar->Set(*Value, SetBy);
+}
+
+void USnakeScalabilitySubsystem::RestoreConsoleVariable(const FString& Name)
+{
+	FSavedConsoleVariable Saved;
+	if (!SavedCVarValues.RemoveAndCopyValue(Name, Saved))
+	{
+		return;
+	}
+
+	if (IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(*Name))
+	{
+		CVar->Set(*Saved.Value, Saved.SetBy);
+	}
+}
+
+bool USnakeScalabilitySubsystem::RunSyntheticFrames(float BaseMilliseconds, float PeakMilliseconds, int32 NumFrames) const
+{
+	const FSnakeFrameBudgetSettings Settings = MakeSettings();
+
+	FSnakeFrameBudgetController SyntheticController;
+	SyntheticController.Reset(Settings, 100.0f);
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Synthetic frames: %d frames, %.1f ms rising to %.1f ms and back, target %.1f ms"),
+		NumFrames, BaseMilliseconds, PeakMilliseconds, Settings.TargetFrameMilliseconds);
+
+	int32 NumChanges = 0;
+	float LowestScreenPercentage = SyntheticController.GetScreenPercentage();
+	TArray<FString> Failures;
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		// Triangle wave from base to peak and back, like the cost of rolling into a busy area and out again.
+		const float Alpha = 1.0f - FMath::Abs(2.0f * Frame / FMath::Max(NumFrames - 1, 1) - 1.0f);
+		const float FrameMilliseconds = FMath::Lerp(BaseMilliseconds, PeakMilliseconds, Alpha);
+
+		if (SyntheticController.AddFrame(FrameMilliseconds))
+		{
+			++NumChanges;
+			UE_LOG(LogHoopSnake, Display, TEXT("Synthetic frames: frame %4d, %.1f ms (%.1f smoothed) -> screen percentage %.0f, %d feature downgrades"),
+				Frame, FrameMilliseconds, SyntheticController.GetSmoothedFrameMilliseconds(), SyntheticController.GetScreenPercentage(), SyntheticController.GetFeatureDowngrades());
+
+			// Resolution stays within its range, and features only go once it's at the bottom of it.
+			if (SyntheticController.GetScreenPercentage() < Settings.MinScreenPercentage || SyntheticController.GetScreenPercentage() > 100.0f)
+			{
+				Failures.Add(FString::Printf(TEXT("screen percentage %.0f out of range at frame %d"), SyntheticController.GetScreenPercentage(), Frame));
+			}
+			if (SyntheticController.GetFeatureDowngrades() > 0 && SyntheticController.GetScreenPercentage() > Settings.MinScreenPercentage)
+			{
+				Failures.Add(FString::Printf(TEXT("features downgraded above the lowest screen percentage at frame %d"), Frame));
+			}
+
+			LowestScreenPercentage = FMath::Min(LowestScreenPercentage, SyntheticController.GetScreenPercentage());
+		}
+	}
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Synthetic frames: %d changes, ended at screen percentage %.0f with %d feature downgrades"),
+		NumChanges, SyntheticController.GetScreenPercentage(), SyntheticController.GetFeatureDowngrades());
+
+	// A peak well over budget for longer than it takes to react has to lower something.
+	if (PeakMilliseconds > Settings.TargetFrameMilliseconds * 1.25f && NumFrames > (Settings.FramesToLower + Settings.CooldownFrames) * 4 && LowestScreenPercentage >= 100.0f)
+	{
+		Failures.Add(TEXT("never lowered the screen percentage while over budget"));
+	}
+
+	// Frames comfortably inside the budget must never change anything.
+	FSnakeFrameBudgetController SteadyController;
+	SteadyController.Reset(Settings, 100.0f);
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		if (SteadyController.AddFrame(Settings.TargetFrameMilliseconds * 0.5f) && SteadyController.IsDowngraded())
+		{
+			Failures.Add(FString::Printf(TEXT("lowered quality at frame %d of a steady run inside the budget"), Frame));
+			break;
+		}
+	}
+
+	for (const FString& Failure : Failures)
+	{
+		UE_LOG(LogHoopSnake, Error, TEXT("Synthetic frames: FAILED, %s"), *Failure);
+	}
+
+	if (Failures.IsEmpty())
+	{
+		UE_LOG(LogHoopSnake, Display, TEXT("Synthetic frames: passed"));
+	}
+
+	return Failures.IsEmpty();
+}
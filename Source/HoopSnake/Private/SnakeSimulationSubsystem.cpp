@@ -0,0 +1,324 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeSimulationSubsystem.h"
+#include "HoopSnakeCharacter.h"
+#include "VictimAIManager.h"
+#include "VictimAIController.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/WorldSettings.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UnrealType.h"
+#include "HoopSnake.h"
+#include "EngineUtils.h"
+
+DECLARE_CYCLE_STAT(TEXT("Snake Simulation"), STAT_SnakeSimulation, STATGROUP_HoopSnake);
+
+USnakeSimulationSubsystem::USnakeSimulationSubsystem()
+{
+	FixedStepSeconds = 1.0f / 60.0f;
+	ExplosionSpeed = 50000.0f;
+	ProgressInterval = 60.0f;
+
+	bSimulating = false;
+	bExitWhenDone = false;
+	SimSeconds = 0.0f;
+	SimElapsed = 0.0;
+	NextProgressTime = 0.0;
+	WallStartTime = 0.0;
+	bSavedUseFixedTimeStep = false;
+	SavedFixedDeltaTime = 0.0;
+	bSavedBenchmarking = false;
+
+	Steps = 0;
+	Ragdolls = 0;
+	Bites = 0;
+	BodySamples = 0;
+	ExplodingBodySamples = 0;
+	InvalidBodySamples = 0;
+	OutOfWorldBodySamples = 0;
+	MaxBodySpeed = 0.0f;
+	TotalAwakeBodies = 0.0;
+}
+
+TStatId USnakeSimulationSubsystem::GetStatId() const
+{
+	return GET_STATID(STAT_SnakeSimulation);
+}
+
+void USnakeSimulationSubsystem::Deinitialize()
+{
+	// The world going away mid run, e.g. for a map change, reports what it has but leaves the game running.
+	bExitWhenDone = false;
+	StopSimulation();
+
+	Super::Deinitialize();
+}
+
+void USnakeSimulationSubsystem::StartSimulation(float InSimSeconds, const FString& InOverrides, bool bInExitWhenDone)
+{
+	StopSimulation();
+
+	// Both cost a lot more than the simulation itself, and can't be turned off once the engine is up.
+	if (FApp::CanEverRender())
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Snake simulation: rendering is on, run with -nullrhi for full speed"));
+	}
+	if (FApp::CanEverRenderAudio())
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Snake simulation: audio is on, run with -nosound for full speed"));
+	}
+
+	SimSeconds = FMath::Max(InSimSeconds, 1.0f);
+	Overrides = InOverrides;
+	bExitWhenDone = bInExitWhenDone;
+
+	SimElapsed = 0.0;
+	NextProgressTime = ProgressInterval;
+	Steps = 0;
+	Ragdolls = 0;
+	Bites = 0;
+	BodySamples = 0;
+	ExplodingBodySamples = 0;
+	InvalidBodySamples = 0;
+	OutOfWorldBodySamples = 0;
+	MaxBodySpeed = 0.0f;
+	TotalAwakeBodies = 0.0;
+	Snakes.Reset();
+
+	// A fixed step with benchmarking on makes the engine tick back to back with no frame rate limit, the same as -benchmark.
+	bSavedUseFixedTimeStep = FApp::UseFixedTimeStep();
+	SavedFixedDeltaTime = FApp::GetFixedDeltaTime();
+	bSavedBenchmarking = FApp::IsBenchmarking();
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(FixedStepSeconds);
+	FApp::SetBenchmarking(true);
+
+	bSimulating = true;
+	WallStartTime = FPlatformTime::Seconds();
+
+	for (TActorIterator<AHoopSnakeCharacter> It(GetWorld()); It; ++It)
+	{
+		TrackSnake(*It);
+	}
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Snake simulation: %.0f s at %.4f s steps, %d snakes, overrides \"%s\""), SimSeconds, FixedStepSeconds, Snakes.Num(), *Overrides);
+}
+
+void USnakeSimulationSubsystem::StopSimulation()
+{
+	if (!bSimulating)
+	{
+		return;
+	}
+
+	bSimulating = false;
+
+	FApp::SetUseFixedTimeStep(bSavedUseFixedTimeStep);
+	FApp::SetFixedDeltaTime(SavedFixedDeltaTime);
+	FApp::SetBenchmarking(bSavedBenchmarking);
+
+	for (const TPair<TWeakObjectPtr<AHoopSnakeCharacter>, bool>& Watched : Snakes)
+	{
+		if (Watched.Key.IsValid())
+		{
+			Watched.Key->OnBite.RemoveAll(this);
+		}
+	}
+
+	Report();
+	Snakes.Reset();
+
+	if (bExitWhenDone)
+	{
+		FPlatformMisc::RequestExit(false, TEXT("SnakeSimulation"));
+	}
+}
+
+void USnakeSimulationSubsystem::TrackSnake(AHoopSnakeCharacter* Snake)
+{
+	if (!Snake || Snakes.Contains(Snake))
+	{
+		return;
+	}
+
+	Snakes.Add(Snake, Snake->GetMesh()->IsSimulatingPhysics());
+	Snake->OnBite.AddUObject(this, &USnakeSimulationSubsystem::OnSnakeBite);
+	ApplyOverrides(Snake);
+}
+
+int32 USnakeSimulationSubsystem::ApplyOverrides(AHoopSnakeCharacter* Snake) const
+{
+	TArray<FString> Pairs;
+	Overrides.ParseIntoArray(Pairs, TEXT(","));
+
+	int32 NumApplied = 0;
+	for (const FString& Pair : Pairs)
+	{
+		FString Name, Value;
+		if (!Pair.Split(TEXT("="), &Name, &Value))
+		{
+			continue;
+		}
+
+		// Tuning values are editable properties, so set them the same way the details panel would.
+		FProperty* Property = Snake->GetClass()->FindPropertyByName(FName(*Name.TrimStartAndEnd()));
+		if (Property && Property->ImportText_InContainer(*Value.TrimStartAndEnd(), Snake, Snake, PPF_None))
+		{
+			++NumApplied;
+		}
+		else
+		{
+			UE_LOG(LogHoopSnake, Warning, TEXT("Snake simulation: couldn't set %s on %s"), *Pair, *Snake->GetName());
+		}
+	}
+
+	return NumApplied;
+}
+
+void USnakeSimulationSubsystem::OnSnakeBite(AHoopSnakeCharacter* Snake, AActor* Victim)
+{
+	++Bites;
+}
+
+void USnakeSimulationSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SnakeSimulation);
+
+	if (!bSimulating)
+	{
+		return;
+	}
+
+	++Steps;
+	SimElapsed += DeltaTime;
+
+	// Snakes spawned during the run, such as by the victim pool's respawns, get the same overrides.
+	for (TActorIterator<AHoopSnakeCharacter> It(GetWorld()); It; ++It)
+	{
+		TrackSnake(*It);
+	}
+
+	// Every attack or forced ragdoll starts with the mesh going from animated to simulated.
+	for (TPair<TWeakObjectPtr<AHoopSnakeCharacter>, bool>& Watched : Snakes)
+	{
+		const AHoopSnakeCharacter* Snake = Watched.Key.Get();
+		if (!Snake)
+		{
+			continue;
+		}
+
+		const bool bRagdolling = Snake->GetMesh()->IsSimulatingPhysics();
+		if (bRagdolling && !Watched.Value)
+		{
+			++Ragdolls;
+		}
+		Watched.Value = bRagdolling;
+
+		SampleStability(Snake->GetMesh());
+	}
+
+	if (const UVictimAIManager* Manager = GetWorld()->GetSubsystem<UVictimAIManager>())
+	{
+		for (const AVictimAIController* Victim : Manager->GetVictims())
+		{
+			const ACharacter* VictimCharacter = Victim ? Victim->GetPawn<ACharacter>() : nullptr;
+			if (VictimCharacter)
+			{
+				SampleStability(VictimCharacter->GetMesh());
+			}
+		}
+	}
+
+	if (SimElapsed >= NextProgressTime)
+	{
+		NextProgressTime += ProgressInterval;
+		UE_LOG(LogHoopSnake, Display, TEXT("Snake simulation: %.0f / %.0f s, %.0f steps/s, %d bites from %d ragdolls"),
+			SimElapsed, SimSeconds, Steps / FMath::Max(FPlatformTime::Seconds() - WallStartTime, 0.001), Bites, Ragdolls);
+	}
+
+	if (SimElapsed >= SimSeconds)
+	{
+		StopSimulation();
+	}
+}
+
+void USnakeSimulationSubsystem::SampleStability(const USkeletalMeshComponent* Mesh)
+{
+	if (!Mesh || !Mesh->IsSimulatingPhysics())
+	{
+		return;
+	}
+
+	const float KillZ = GetWorld()->GetWorldSettings()->KillZ;
+
+	for (const FBodyInstance* Body : Mesh->Bodies)
+	{
+		if (!Body || !Body->IsInstanceSimulatingPhysics())
+		{
+			continue;
+		}
+
+		++BodySamples;
+		TotalAwakeBodies += Body->IsInstanceAwake() ? 1.0 : 0.0;
+
+		const FTransform BodyTransform = Body->GetUnrealWorldTransform();
+		const FVector Velocity = Body->GetUnrealWorldVelocity();
+		if (BodyTransform.ContainsNaN() || Velocity.ContainsNaN())
+		{
+			++InvalidBodySamples;
+			continue;
+		}
+
+		const float Speed = Velocity.Size();
+		MaxBodySpeed = FMath::Max(MaxBodySpeed, Speed);
+		if (Speed > ExplosionSpeed)
+		{
+			++ExplodingBodySamples;
+		}
+
+		// Bodies that have tunnelled through the floor
+		if (BodyTransform.GetLocation().Z < KillZ)
+		{
+			++OutOfWorldBodySamples;
+		}
+	}
+}
+
+void USnakeSimulationSubsystem::Report() const
+{
+	const double WallSeconds = FMath::Max(FPlatformTime::Seconds() - WallStartTime, 0.001);
+	const double StepsPerSecond = Steps / WallSeconds;
+	const double BiteRate = Ragdolls > 0 ? (double)Bites / Ragdolls : 0.0;
+	const double ExplodingRate = BodySamples > 0 ? (double)ExplodingBodySamples / BodySamples : 0.0;
+	const double AwakeRate = BodySamples > 0 ? TotalAwakeBodies / BodySamples : 0.0;
+
+	UE_LOG(LogHoopSnake, Display, TEXT("Snake simulation finished, overrides \"%s\":"), *Overrides);
+	UE_LOG(LogHoopSnake, Display, TEXT("  %lld steps, %.0f simulated s in %.1f wall s, %.0f steps/s (%.1fx real time)"), Steps, SimElapsed, WallSeconds, StepsPerSecond, SimElapsed / WallSeconds);
+	UE_LOG(LogHoopSnake, Display, TEXT("  %d bites from %d ragdolls, %.1f%% success"), Bites, Ragdolls, BiteRate * 100.0);
+	UE_LOG(LogHoopSnake, Display, TEXT("  max body speed %.0f cm/s, exploding %.4f%% of body samples, %lld invalid, %lld below kill Z, %.1f%% awake"),
+		MaxBodySpeed, ExplodingRate * 100.0, InvalidBodySamples, OutOfWorldBodySamples, AwakeRate * 100.0);
+
+	// One line per run, so a sweep's runs end up side by side.
+	const FString ReportPath = FPaths::ProfilingDir() / TEXT("SnakeSim.csv");
+	FString Line;
+	if (!FPaths::FileExists(ReportPath))
+	{
+		Line += TEXT("Overrides,Steps,SimSeconds,WallSeconds,StepsPerSecond,Ragdolls,Bites,BiteRate,MaxBodySpeed,ExplodingRate,InvalidBodySamples,OutOfWorldBodySamples,AwakeRate\n");
+	}
+	Line += FString::Printf(TEXT("\"%s\",%lld,%.1f,%.2f,%.1f,%d,%d,%.4f,%.1f,%.6f,%lld,%lld,%.4f\n"), *Overrides, Steps, SimElapsed, WallSeconds, StepsPerSecond,
+		Ragdolls, Bites, BiteRate, MaxBodySpeed, ExplodingRate, InvalidBodySamples, OutOfWorldBodySamples, AwakeRate);
+
+	if (FFileHelper::SaveStringToFile(Line, *ReportPath, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append))
+	{
+		UE_LOG(LogHoopSnake, Display, TEXT("Snake simulation results added to %s"), *ReportPath);
+	}
+	else
+	{
+		UE_LOG(LogHoopSnake, Warning, TEXT("Failed to write snake simulation results to %s"), *ReportPath);
+	}
+}
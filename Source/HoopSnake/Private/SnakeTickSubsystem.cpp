@@ -0,0 +1,326 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SnakeTickSubsystem.h"
+#include "HoopSnakeCharacter.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/Controller.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "HoopSnake.h"
+
+DECLARE_CYCLE_STAT(TEXT("Snake Batch Tick"), STAT_SnakeBatchTick, STATGROUP_HoopSnake);
+DECLARE_CYCLE_STAT(TEXT("Snake Batch Gather"), STAT_SnakeBatchGather, STATGROUP_HoopSnake);
+DECLARE_CYCLE_STAT(TEXT("Snake Batch Compute"), STAT_SnakeBatchCompute, STATGROUP_HoopSnake);
+DECLARE_CYCLE_STAT(TEXT("Snake Batch Apply"), STAT_SnakeBatchApply, STATGROUP_HoopSnake);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Snakes Batched"), STAT_SnakesBatched, STATGROUP_HoopSnake);
+
+static TAutoConsoleVariable<bool> CVarSnakeBatchedTick(
+	TEXT("hoopsnake.BatchedTick"),
+	true,
+	TEXT("Update every snake in one batched pass instead of one actor tick each."));
+
+static TAutoConsoleVariable<int32> CVarSnakeBatchParallelThreshold(
+	TEXT("hoopsnake.BatchedTick.ParallelThreshold"),
+	16,
+	TEXT("Number of batched snakes needed before the update maths is spread across worker threads."));
+
+void FSnakeTickState::Compute()
+{
+	/* Dot product of previous and current forwards would tell us when we're turning, but not which direction.
+	 * So we use cross product of previous forward and up vector against the current forward so that direction can be determined from the dot product.
+	 * When it is 0, we are moving straight forward. When it is less than 0, we are turning right. When it is more than 0, we are turning left. */
+	const float TurningDotProduct = FVector::DotProduct(FVector::CrossProduct(PreviousForward, FVector::UpVector), Forward);
+
+	if (bHoopModeEnabled)
+	{
+		// Multiply dot product by modifier to get tilt amount. Modifier is negated to ensure it tilts in the correct direction.
+		DesiredTilt = TurningDotProduct * -TiltModifier;
+
+		// Interpolate towards the desired tilt
+		CurrentTilt = FMath::FInterpTo(CurrentTilt, DesiredTilt, DeltaTime, TiltInterpSpeed);
+	}
+	else
+	{
+		// No tilt when not in hoop mode.
+		CurrentTilt = 0.0f;
+	}
+
+	RotateRate = TurningDotProduct;
+
+	// If rotate rate is roughly zero, we are not rotating. Otherwise we are rotating.
+	bIsRotating = !FMath::IsNearlyEqual(RotateRate, 0.0f, 1.e-6f);
+
+	const FVector NormalizedVelocity = Velocity.GetSafeNormal(1.e-4f);
+
+	// Compare velocity and forward vector to determine if we're moving forward.
+	const bool bIsMovingForward = FVector::DotProduct(Forward, NormalizedVelocity) > 0.1f;
+
+	// Compare velocity and cross of forward vector to determine if we're moving right.
+	const bool bIsMovingRight = FVector::DotProduct(FVector::CrossProduct(Forward, FVector::UpVector), NormalizedVelocity) * -1.0f > 0.1f;
+
+	// Reverse slither animation when not moving forward or right.
+	bReverseSlither = !(bIsMovingForward || bIsMovingRight);
+
+	// Only make a noise if moving. Volume is determined by speed. 0 speed = no noise. Travelling at full speed in hoop mode = max noise.
+	bMakeNoise = Speed > 10.0f;
+	NoiseVolume = FMath::GetMappedRangeValueClamped(FVector2f(0.0f, HoopSpeed), FVector2f(0.0f, 1.0f), Speed);
+
+	// Speed lines only show in hoop mode, as strong as the snake is fast and as visible as it is significant.
+	SpeedLineIntensity = bHoopModeEnabled ? NoiseVolume * SpeedLineSignificance : 0.0f;
+
+	if (bUpdateCamera)
+	{
+		CameraState.Interpolate(CameraTargets, DeltaTime, CameraInterpSpeed, CameraTolerance);
+	}
+}
+
+void FSnakeBatchTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Target && TickType != LEVELTICK_ViewportsOnly)
+	{
+		Target->TickSnakes(DeltaTime);
+	}
+}
+
+FString FSnakeBatchTickFunction::DiagnosticMessage()
+{
+	return TEXT("FSnakeBatchTickFunction");
+}
+
+USnakeTickSubsystem::USnakeTickSubsystem()
+{
+	bBatching = false;
+	ActorTickStartTime = 0.0;
+	LastActorTickSeconds = 0.0;
+
+	BatchTickFunction.TickGroup = TG_PrePhysics;
+	BatchTickFunction.bCanEverTick = true;
+	BatchTickFunction.bStartWithTickEnabled = true;
+}
+
+void USnakeTickSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	BatchTickFunction.Target = this;
+	BatchTickFunction.RegisterTickFunction(InWorld.PersistentLevel);
+
+	bBatching = CVarSnakeBatchedTick.GetValueOnGameThread();
+
+	PreActorTickHandle = FWorldDelegates::OnWorldPreActorTick.AddUObject(this, &USnakeTickSubsystem::OnWorldPreActorTick);
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &USnakeTickSubsystem::OnWorldPostActorTick);
+}
+
+void USnakeTickSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldPreActorTick.Remove(PreActorTickHandle);
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+
+	if (BatchTickFunction.IsTickFunctionRegistered())
+	{
+		BatchTickFunction.UnRegisterTickFunction();
+	}
+	BatchTickFunction.Target = nullptr;
+
+	Snakes.Empty();
+	States.Empty();
+	ControllerPrerequisites.Empty();
+
+	Super::Deinitialize();
+}
+
+bool USnakeTickSubsystem::CanBatchSnake(const AHoopSnakeCharacter* Snake) const
+{
+	// ReceiveTick is protected on AActor, so it's looked up by name.
+	static const FName ReceiveTickName(TEXT("ReceiveTick"));
+	return Snake && !Snake->GetClass()->IsFunctionImplementedInScript(ReceiveTickName);
+}
+
+void USnakeTickSubsystem::RegisterSnake(AHoopSnakeCharacter* Snake)
+{
+	if (!CanBatchSnake(Snake) || Snakes.Contains(Snake))
+	{
+		return;
+	}
+
+	Snakes.Add(Snake);
+	AddComponentPrerequisites(Snake);
+	AddControllerPrerequisite(Snake->GetController());
+
+	if (bBatching)
+	{
+		Snake->SetActorTickEnabled(false);
+	}
+}
+
+void USnakeTickSubsystem::UnregisterSnake(AHoopSnakeCharacter* Snake)
+{
+	if (Snakes.RemoveSingleSwap(Snake) == 0)
+	{
+		return;
+	}
+
+	RemoveComponentPrerequisites(Snake);
+	RemoveControllerPrerequisite(Snake->GetController());
+
+	if (bBatching)
+	{
+		Snake->SetActorTickEnabled(true);
+	}
+}
+
+void USnakeTickSubsystem::SetSnakeController(AHoopSnakeCharacter* Snake, AController* OldController, AController* NewController)
+{
+	if (OldController == NewController || !Snakes.Contains(Snake))
+	{
+		return;
+	}
+
+	RemoveControllerPrerequisite(OldController);
+	AddControllerPrerequisite(NewController);
+}
+
+void USnakeTickSubsystem::AddControllerPrerequisite(AController* InController)
+{
+	if (!InController)
+	{
+		return;
+	}
+
+	/* A snake ticking itself waits for its controller, which is where the player's input is processed.
+	 * Without the same wait the batch could run first and steer with last frame's input. */
+	int32& Count = ControllerPrerequisites.FindOrAdd(InController);
+	if (Count++ == 0)
+	{
+		BatchTickFunction.AddPrerequisite(InController, InController->PrimaryActorTick);
+	}
+}
+
+void USnakeTickSubsystem::RemoveControllerPrerequisite(AController* InController)
+{
+	int32* Count = InController ? ControllerPrerequisites.Find(InController) : nullptr;
+	if (!Count)
+	{
+		return;
+	}
+
+	if (--(*Count) == 0)
+	{
+		BatchTickFunction.RemovePrerequisite(InController, InController->PrimaryActorTick);
+		ControllerPrerequisites.Remove(InController);
+	}
+}
+
+void USnakeTickSubsystem::AddComponentPrerequisites(AHoopSnakeCharacter* Snake)
+{
+	// Hoop mode adds movement input and tilts the mesh each update, both of which need to land before those components tick.
+	if (UCharacterMovementComponent* Movement = Snake->GetCharacterMovement())
+	{
+		Movement->PrimaryComponentTick.AddPrerequisite(this, BatchTickFunction);
+	}
+
+	if (USkeletalMeshComponent* Mesh = Snake->GetMesh())
+	{
+		Mesh->PrimaryComponentTick.AddPrerequisite(this, BatchTickFunction);
+	}
+}
+
+void USnakeTickSubsystem::RemoveComponentPrerequisites(AHoopSnakeCharacter* Snake)
+{
+	if (UCharacterMovementComponent* Movement = Snake->GetCharacterMovement())
+	{
+		Movement->PrimaryComponentTick.RemovePrerequisite(this, BatchTickFunction);
+	}
+
+	if (USkeletalMeshComponent* Mesh = Snake->GetMesh())
+	{
+		Mesh->PrimaryComponentTick.RemovePrerequisite(this, BatchTickFunction);
+	}
+}
+
+void USnakeTickSubsystem::SetBatching(bool bEnable)
+{
+	bBatching = bEnable;
+
+	for (AHoopSnakeCharacter* Snake : Snakes)
+	{
+		if (IsValid(Snake))
+		{
+			Snake->SetActorTickEnabled(!bBatching);
+		}
+	}
+
+	UE_LOG(LogHoopSnake, Log, TEXT("Snake tick: %s for %d snakes"), bBatching ? TEXT("batched") : TEXT("per actor"), Snakes.Num());
+}
+
+void USnakeTickSubsystem::TickSnakes(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SnakeBatchTick);
+
+	// Follow the console variable, so the two paths can be compared without restarting.
+	const bool bWantBatching = CVarSnakeBatchedTick.GetValueOnGameThread();
+	if (bWantBatching != bBatching)
+	{
+		SetBatching(bWantBatching);
+	}
+
+	if (!bBatching)
+	{
+		return;
+	}
+
+	States.Reset();
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_SnakeBatchGather);
+
+		for (AHoopSnakeCharacter* Snake : Snakes)
+		{
+			if (IsValid(Snake) && Snake->HasActorBegunPlay())
+			{
+				Snake->GatherTickState(States.AddDefaulted_GetRef(), DeltaTime);
+			}
+		}
+	}
+
+	SET_DWORD_STAT(STAT_SnakesBatched, States.Num());
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_SnakeBatchCompute);
+
+		// Spreading a handful of snakes over worker threads costs more than it saves.
+		const EParallelForFlags Flags = States.Num() < CVarSnakeBatchParallelThreshold.GetValueOnGameThread() ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None;
+		ParallelFor(States.Num(), [this](int32 Index)
+		{
+			States[Index].Compute();
+		}, Flags);
+	}
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_SnakeBatchApply);
+
+		for (const FSnakeTickState& State : States)
+		{
+			State.Snake->ApplyTickState(State);
+		}
+	}
+}
+
+void USnakeTickSubsystem::OnWorldPreActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaTime)
+{
+	if (InWorld == GetWorld())
+	{
+		ActorTickStartTime = FPlatformTime::Seconds();
+	}
+}
+
+void USnakeTickSubsystem::OnWorldPostActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaTime)
+{
+	if (InWorld == GetWorld() && ActorTickStartTime > 0.0)
+	{
+		LastActorTickSeconds = FPlatformTime::Seconds() - ActorTickStartTime;
+	}
+}
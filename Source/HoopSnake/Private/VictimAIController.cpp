@@ -0,0 +1,221 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VictimAIController.h"
+#include "VictimBehaviorTreeComponent.h"
+#include "VictimAIManager.h"
+#include "ProximityGridSubsystem.h"
+#include "HoopSnakeCharacter.h"
+#include "BehaviorTree/BehaviorTree.h"
+#include "BehaviorTree/BlackboardComponent.h"
+#include "Perception/AIPerceptionComponent.h"
+#include "Perception/AISenseConfig_Hearing.h"
+#include "Components/WidgetComponent.h"
+#include "GameFramework/GameModeBase.h"
+#include "SnakeHUD.h"
+
+AVictimAIController::AVictimAIController(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	// RunBehaviorTree uses whatever brain component is already set, so this makes the tree time sliced.
+	VictimBehavior = CreateDefaultSubobject<UVictimBehaviorTreeComponent>(TEXT("VictimBehavior"));
+	BrainComponent = VictimBehavior;
+
+	// Hearing is event driven and only costs anything when a snake makes noise. Sight is left out, the manager's shared query replaces it.
+	HearingConfig = CreateDefaultSubobject<UAISenseConfig_Hearing>(TEXT("HearingConfig"));
+	HearingConfig->HearingRange = 1500.0f;
+	HearingConfig->DetectionByAffiliation.bDetectEnemies = true;
+	HearingConfig->DetectionByAffiliation.bDetectNeutrals = true;
+	HearingConfig->DetectionByAffiliation.bDetectFriendlies = true;
+
+	UAIPerceptionComponent* Perception = CreateDefaultSubobject<UAIPerceptionComponent>(TEXT("Perception"));
+	Perception->ConfigureSense(*HearingConfig);
+	Perception->SetDominantSense(HearingConfig->GetSenseImplementation());
+	SetPerceptionComponent(*Perception);
+
+	VictimBehaviorTree = nullptr;
+	SnakeKeyName = "Snake";
+	AlertStateKeyName = "AlertState";
+	AlertMemoryDuration = 5.0f;
+	AlertWidgetComponentName = "AlertWidget";
+	AlertWidgetClassName = "WBP_AlertIcon_C";
+	AlertState = EVictimAlertState::Calm;
+	LastHeardSnakeTime = 0.0;
+	RagdollSettledTime = 0.0f;
+	bPooled = false;
+}
+
+void AVictimAIController::OnPossess(APawn* InPawn)
+{
+	Super::OnPossess(InPawn);
+
+	HomeTransform = InPawn->GetActorTransform();
+
+	// The HUD draws every victim's alert icon in one overlay, so the pawn's own alert widget would show a second icon.
+	// Its widget is released rather than the component destroyed, so the pawn blueprint's casts on it just fail quietly.
+	// A game mode using some other HUD has no overlay, and the pawn keeps its own icon.
+	const AGameModeBase* GameMode = GetWorld()->GetAuthGameMode();
+	const bool bHUDDrawsAlerts = GameMode && GameMode->HUDClass && GameMode->HUDClass->IsChildOf(ASnakeHUD::StaticClass());
+
+	TInlineComponentArray<UWidgetComponent*> WidgetComponents(InPawn);
+	for (UWidgetComponent* WidgetComponent : WidgetComponents)
+	{
+		const UClass* WidgetClass = WidgetComponent->GetWidgetClass();
+		if (!bHUDDrawsAlerts || WidgetComponent->GetFName() != AlertWidgetComponentName && !(WidgetClass && WidgetClass->GetFName() == AlertWidgetClassName))
+		{
+			continue;
+		}
+
+		WidgetComponent->SetWidgetClass(nullptr);
+		WidgetComponent->SetWidget(nullptr);
+		WidgetComponent->SetVisibility(false);
+		WidgetComponent->SetComponentTickEnabled(false);
+	}
+
+	GetPerceptionComponent()->OnTargetPerceptionUpdated.AddUniqueDynamic(this, &AVictimAIController::OnTargetPerceptionUpdated);
+
+	if (VictimBehaviorTree)
+	{
+		RunBehaviorTree(VictimBehaviorTree);
+	}
+
+	if (UVictimAIManager* Manager = GetWorld()->GetSubsystem<UVictimAIManager>())
+	{
+		Manager->RegisterVictim(this);
+	}
+
+	if (UProximityGridSubsystem* ProximityGrid = GetWorld()->GetSubsystem<UProximityGridSubsystem>())
+	{
+		ProximityGrid->Register(InPawn, EProximityKind::Victim);
+	}
+}
+
+void AVictimAIController::SetPooled(bool bInPooled)
+{
+	if (bPooled == bInPooled || !GetPawn())
+	{
+		return;
+	}
+
+	bPooled = bInPooled;
+	RagdollSettledTime = 0.0f;
+
+	UVictimAIManager* Manager = GetWorld()->GetSubsystem<UVictimAIManager>();
+	UProximityGridSubsystem* ProximityGrid = GetWorld()->GetSubsystem<UProximityGridSubsystem>();
+
+	if (bPooled)
+	{
+		StopMovement();
+
+		if (BrainComponent)
+		{
+			BrainComponent->PauseLogic(TEXT("Pooled"));
+		}
+
+		if (Manager)
+		{
+			Manager->UnregisterVictim(this);
+		}
+
+		if (ProximityGrid)
+		{
+			ProximityGrid->Unregister(GetPawn());
+		}
+	}
+	else
+	{
+		// Forget about snakes from its previous life.
+		HeardSnake.Reset();
+		AlertState = EVictimAlertState::Calm;
+		UpdateBlackboard(nullptr);
+
+		if (BrainComponent)
+		{
+			BrainComponent->ResumeLogic(TEXT("Pooled"));
+		}
+
+		if (Manager)
+		{
+			Manager->RegisterVictim(this);
+		}
+
+		if (ProximityGrid)
+		{
+			ProximityGrid->Register(GetPawn(), EProximityKind::Victim);
+		}
+	}
+}
+
+void AVictimAIController::ResetAwareness()
+{
+	HeardSnake.Reset();
+	AlertState = EVictimAlertState::Calm;
+	RagdollSettledTime = 0.0f;
+	UpdateBlackboard(nullptr);
+
+	// Start from the top of the tree, rather than carrying on with whatever it was fleeing from.
+	if (BrainComponent && !bPooled)
+	{
+		BrainComponent->RestartLogic();
+	}
+}
+
+void AVictimAIController::OnUnPossess()
+{
+	if (UVictimAIManager* Manager = GetWorld()->GetSubsystem<UVictimAIManager>())
+	{
+		Manager->UnregisterVictim(this);
+	}
+
+	if (UProximityGridSubsystem* ProximityGrid = GetWorld()->GetSubsystem<UProximityGridSubsystem>())
+	{
+		ProximityGrid->Unregister(GetPawn());
+	}
+
+	Super::OnUnPossess();
+}
+
+void AVictimAIController::OnTargetPerceptionUpdated(AActor* Actor, FAIStimulus Stimulus)
+{
+	AHoopSnakeCharacter* Snake = Cast<AHoopSnakeCharacter>(Actor);
+	if (Snake && Stimulus.WasSuccessfullySensed())
+	{
+		HeardSnake = Snake;
+		LastHeardSnakeTime = GetWorld()->GetTimeSeconds();
+	}
+}
+
+void AVictimAIController::UpdateSnakeAwareness(AHoopSnakeCharacter* NearestSnake, float DistanceToSnake, float PanicRadius)
+{
+	const bool bRecentlyHeard = HeardSnake.IsValid() && GetWorld()->GetTimeSeconds() - LastHeardSnakeTime <= AlertMemoryDuration;
+
+	// A snake that is close by beats one that was only heard.
+	if (NearestSnake && DistanceToSnake <= PanicRadius)
+	{
+		AlertState = EVictimAlertState::Panicked;
+	}
+	else if (NearestSnake || bRecentlyHeard)
+	{
+		AlertState = EVictimAlertState::Alert;
+	}
+	else
+	{
+		AlertState = EVictimAlertState::Calm;
+	}
+
+	UpdateBlackboard(NearestSnake ? NearestSnake : (bRecentlyHeard ? HeardSnake.Get() : nullptr));
+}
+
+void AVictimAIController::GrantTimeSlice()
+{
+	VictimBehavior->GrantTimeSlice();
+}
+
+void AVictimAIController::UpdateBlackboard(AHoopSnakeCharacter* Snake)
+{
+	if (UBlackboardComponent* BlackboardComp = GetBlackboardComponent())
+	{
+		BlackboardComp->SetValueAsObject(SnakeKeyName, Snake);
+		BlackboardComp->SetValueAsEnum(AlertStateKeyName, static_cast<uint8>(AlertState));
+	}
+}
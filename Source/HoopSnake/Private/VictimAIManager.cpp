@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VictimAIManager.h"
+#include "VictimAIController.h"
+#include "HoopSnakeCharacter.h"
+#include "ProximityGridSubsystem.h"
+#include "HoopSnake.h"
+
+DECLARE_CYCLE_STAT(TEXT("Victim AI Manager"), STAT_VictimAIManager, STATGROUP_HoopSnake);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Victims Managed"), STAT_VictimsManaged, STATGROUP_HoopSnake);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Victims Updated"), STAT_VictimsUpdated, STATGROUP_HoopSnake);
+
+UVictimAIManager::UVictimAIManager()
+{
+	VictimsPerFrame = 8;
+	SnakeSenseRadius = 1500.0f;
+	PanicRadius = 500.0f;
+	NextVictimIndex = 0;
+	AverageTickSeconds = 0.0;
+}
+
+TStatId UVictimAIManager::GetStatId() const
+{
+	return GET_STATID(STAT_VictimAIManager);
+}
+
+void UVictimAIManager::RegisterVictim(AVictimAIController* Victim)
+{
+	Victims.AddUnique(Victim);
+}
+
+void UVictimAIManager::UnregisterVictim(AVictimAIController* Victim)
+{
+	Victims.RemoveSingleSwap(Victim);
+}
+
+void UVictimAIManager::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_VictimAIManager);
+	SET_DWORD_STAT(STAT_VictimsManaged, Victims.Num());
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	const UProximityGridSubsystem* ProximityGrid = GetWorld()->GetSubsystem<UProximityGridSubsystem>();
+
+	if (!Victims.IsEmpty() && ProximityGrid)
+	{
+		// Work through the next slice of victims, wrapping around the list.
+		const int32 NumToUpdate = FMath::Min(VictimsPerFrame, Victims.Num());
+		for (int32 Count = 0; Count < NumToUpdate; ++Count)
+		{
+			NextVictimIndex = NextVictimIndex % Victims.Num();
+			AVictimAIController* Victim = Victims[NextVictimIndex++];
+
+			const APawn* VictimPawn = Victim ? Victim->GetPawn() : nullptr;
+			if (!VictimPawn)
+			{
+				continue;
+			}
+
+			float Distance = 0.0f;
+			AHoopSnakeCharacter* NearestSnake = Cast<AHoopSnakeCharacter>(ProximityGrid->FindNearest(VictimPawn->GetActorLocation(), SnakeSenseRadius, EProximityKind::Snake, &Distance));
+
+			Victim->UpdateSnakeAwareness(NearestSnake, Distance, PanicRadius);
+			Victim->GrantTimeSlice();
+		}
+
+		SET_DWORD_STAT(STAT_VictimsUpdated, NumToUpdate);
+	}
+
+	// Smooth over roughly a second's worth of frames so the value is readable.
+	AverageTickSeconds = FMath::Lerp(AverageTickSeconds, FPlatformTime::Seconds() - StartTime, 0.02);
+}
@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VictimBehaviorTreeComponent.h"
+#include "HoopSnake.h"
+
+DECLARE_CYCLE_STAT(TEXT("Victim Behavior Tree"), STAT_VictimBehaviorTree, STATGROUP_HoopSnake);
+
+UVictimBehaviorTreeComponent::UVictimBehaviorTreeComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	bTimeSliced = true;
+	bHasTimeSlice = false;
+	PendingDeltaTime = 0.0f;
+}
+
+void UVictimBehaviorTreeComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	PendingDeltaTime += DeltaTime;
+
+	if (bTimeSliced && !bHasTimeSlice)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_VictimBehaviorTree);
+
+	// Run with all the time since the tree last ran, so timers and waits in the tree still see real time.
+	const float SliceDeltaTime = PendingDeltaTime;
+	PendingDeltaTime = 0.0f;
+	bHasTimeSlice = false;
+
+	Super::TickComponent(SliceDeltaTime, TickType, ThisTickFunction);
+}
@@ -9,6 +9,34 @@
 
 #include "CustomBlueprintFunctionLibrary.generated.h"
 
+/** Changes to make to a group of physics bodies in one go. Only the parts that are switched on are changed. */
+USTRUCT(BlueprintType)
+struct FPhysicsBodyChanges
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Physics, meta = (InlineEditConditionToggle))
+	bool bChangeCollision = false;
+
+	/** Collision for every shape of each body */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Physics, meta = (EditCondition = "bChangeCollision"))
+	TEnumAsByte<ECollisionEnabled::Type> Collision = ECollisionEnabled::QueryAndPhysics;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Physics, meta = (InlineEditConditionToggle))
+	bool bChangeSimulatePhysics = false;
+
+	/** Whether each body simulates */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Physics, meta = (EditCondition = "bChangeSimulatePhysics"))
+	bool bSimulatePhysics = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Physics, meta = (InlineEditConditionToggle))
+	bool bChangePhysicsBlendWeight = false;
+
+	/** How much each bone follows its body rather than the animation */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Physics, meta = (EditCondition = "bChangePhysicsBlendWeight", ClampMin = "0.0", ClampMax = "1.0"))
+	float PhysicsBlendWeight = 1.0f;
+};
+
 /**
  * 
  */
@@ -19,10 +47,29 @@ class HOOPSNAKE_API UCustomBlueprintFunctionLibrary : public UBlueprintFunctionL
 
 public:
 
+	/** Change the collision of the first shape on one bone's body. Prefer ChangeCollisionOnPhysicsBodies when changing several bones. */
 	UFUNCTION(BlueprintCallable)
 	static void ChangeCollisionOnPhysicsBody(USkeletalMeshComponent* skeletalMesh, FName boneName, ECollisionEnabled::Type CollisionType);
 
+	/** Change the collision of every shape on the given bones' bodies, with the physics scene locked once for all of them */
+	UFUNCTION(BlueprintCallable, Category = "Physics|Components|SkeletalMesh")
+	static int32 ChangeCollisionOnPhysicsBodies(USkeletalMeshComponent* SkeletalMesh, const TArray<FName>& BoneNames, ECollisionEnabled::Type CollisionType);
+
+	/**
+	 * Apply changes to the given bones' bodies, with the physics scene locked once for all of them. Returns the number of bodies found.
+	 * Turning simulation on here doesn't register the mesh's end of physics update, so the mesh should already be simulating or be switched over afterwards.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Physics|Components|SkeletalMesh")
+	static int32 ChangePhysicsBodies(USkeletalMeshComponent* SkeletalMesh, const TArray<FName>& BoneNames, const FPhysicsBodyChanges& Changes);
+
+	/** Apply changes to every body below a bone, with the physics scene locked once for all of them. Returns the number of bodies found. */
+	UFUNCTION(BlueprintCallable, Category = "Physics|Components|SkeletalMesh")
+	static int32 ChangePhysicsBodiesBelow(USkeletalMeshComponent* SkeletalMesh, FName BoneName, const FPhysicsBodyChanges& Changes, bool bIncludeSelf = true);
+
 	UFUNCTION(BlueprintCallable, Category = "Physics|Components|PhysicsConstraint")
 	static FVector GetConstraintReferencePosition(EConstraintFrame::Type Frame, UPhysicsConstraintComponent* Constraint);
 
+	/** Time changing collision on every body of a mesh one bone at a time against the batched version, and log the results. Collision is put back afterwards. */
+	static void BenchmarkPhysicsBodyChanges(USkeletalMeshComponent* SkeletalMesh, int32 Iterations);
+
 };
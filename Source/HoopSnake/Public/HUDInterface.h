@@ -36,4 +36,8 @@ public:
 
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = HUD)
 	void PopAllWidgets();
+
+	/** Create any widgets the HUD pushes during play up front, so the first push doesn't hitch */
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = HUD)
+	void PrewarmWidgets();
 };
@@ -5,18 +5,47 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
 #include "CharacterAnimationInterface.h"
+#include "SnakeCameraBoomComponent.h"
 
 #include "HoopSnakeCharacter.generated.h"
 
 class USpringArmComponent;
 class UCameraComponent;
 class UCameraShakeSourceComponent;
-class UInputMappingContext;
-class UInputAction;
-class USoundCue;
 class UNiagaraComponent;
+class UNiagaraSystem;
+class USnakeJawComponent;
+class USnakeMeshComponent;
 class APhysicsConstraintActor;
+class USnakeArchetype;
+class USoundCue;
+class AHUD;
 struct FInputActionValue;
+struct FStreamableHandle;
+struct FSnakeTickState;
+
+/** Memory held by one snake, in bytes. Shared assets such as meshes and sounds aren't included. */
+struct FSnakeMemoryFootprint
+{
+	/** Component objects and their properties, counted the way obj list counts them */
+	SIZE_T Components = 0;
+	int32 NumComponents = 0;
+
+	/** The mesh's anim instance object */
+	SIZE_T AnimInstance = 0;
+
+	/** Body and constraint instances of the snake's skeletal meshes, including their physics shapes */
+	SIZE_T PhysicsBodies = 0;
+	int32 NumBodies = 0;
+
+	/** Pose snapshots saved in the anim instance */
+	SIZE_T PoseSnapshots = 0;
+
+	SIZE_T GetTotal() const { return Components + AnimInstance + PhysicsBodies + PoseSnapshots; }
+};
+
+/** Broadcast when a snake's bite latches onto a victim */
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnSnakeBite, AHoopSnakeCharacter* /* Snake */, AActor* /* Victim */);
 
 UCLASS()
 class HOOPSNAKE_API AHoopSnakeCharacter : public ACharacter, public ICharacterAnimationInterface
@@ -25,49 +54,25 @@ class HOOPSNAKE_API AHoopSnakeCharacter : public ACharacter, public ICharacterAn
 
 public:
 	/** Sets default values for this character's properties */
-	AHoopSnakeCharacter();
+	AHoopSnakeCharacter(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
 
-	/** Use static meshes for snake head since I couldn't find a free snake model that was rigged correctly */
+	/** Use static meshes for snake head since I couldn't find a free snake model that was rigged correctly.
+	 * Each half is a single instance jaw component, which opens by moving its instance rather than its attachment. */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Default, meta = (AllowPrivateAccess = "true"))
-	UStaticMeshComponent* UpperJaw;
+	USnakeJawComponent* UpperJaw;
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Default, meta = (AllowPrivateAccess = "true"))
-	UStaticMeshComponent* LowerJaw;
-	/***/
+	USnakeJawComponent* LowerJaw;
 
 	/** Camera boom positioning the camera behind the character */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
-	USpringArmComponent* CameraBoom;
+	USnakeCameraBoomComponent* CameraBoom;
 
 	/** Follow camera */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	UCameraComponent* FollowCamera;
 
 	// *** INPUT *** //
-	/** MappingContext */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Input, meta = (AllowPrivateAccess = "true"))
-	UInputMappingContext* DefaultMappingContext;
-
-	/** Move Input Action */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Input, meta = (AllowPrivateAccess = "true"))
-	UInputAction* MoveAction;
-
-	/** Look Input Action */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Input, meta = (AllowPrivateAccess = "true"))
-	UInputAction* LookAction;
-
-	/** Hoop Toggle Input Action */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Input, meta = (AllowPrivateAccess = "true"))
-	UInputAction* HoopAction;
-
-	/** Reset Snake Input Action */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Input, meta = (AllowPrivateAccess = "true"))
-	UInputAction* ResetAction;
-
-	/** Pause Input Action */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Input, meta = (AllowPrivateAccess = "true"))
-	UInputAction* PauseAction;
-
 	/** Current state of hoop toggle input */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Input, meta = (AllowPrivateAccess = "true"))
 	bool bHoopToggle;
@@ -85,33 +90,20 @@ public:
 	float DefaultSpeed;
 	// ************* //
 
-	// *** SOUND *** //
-	/** Whoosh Sound Effect - used when ragdolling */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Sound, meta = (AllowPrivateAccess = "true"))
-	USoundCue* WhooshSound;
-
-	/** Hiss Sound Effect - used when attacking */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Sound, meta = (AllowPrivateAccess = "true"))
-	USoundCue* HissSound;
+	/** Archetype holding the input, sounds, effects and meshes this snake uses. Loaded asynchronously through the asset manager. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Default, meta = (AllowedTypes = "SnakeArchetype", AllowPrivateAccess = "true"))
+	FPrimaryAssetId ArchetypeId;
 
-	/** Hiss Sound Effect - used when colliding */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Sound, meta = (AllowPrivateAccess = "true"))
-	USoundCue* ImpactSound;
-
-	/** Bite sound effect */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Sound, meta = (AllowPrivateAccess = "true"))
-	USoundCue* BiteSound;
-	// ************* //
-
-	/** Bite physics constraint class. Must be set in blueprint. */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Default, meta = (AllowPrivateAccess = "true"))
-	TSubclassOf<APhysicsConstraintActor> BiteConstraintClass;
+	/** The loaded archetype. Null until its core bundle has finished loading. */
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Default, meta = (AllowPrivateAccess = "true"))
+	USnakeArchetype* Archetype;
 
 	/** Basically a camera shake emitter. */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	UCameraShakeSourceComponent* CameraShakeComponent;
 
-	/** Line emitter to convey speed in hoop mode. */
+	/** Line emitter to convey speed in hoop mode. Started once, then paused and hidden outside hoop mode, so entering hoop mode never rebuilds it.
+	 * The system comes from the archetype. */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Default, meta = (AllowPrivateAccess = "true"))
 	UNiagaraComponent* SpeedLineEffect;
 
@@ -119,28 +111,20 @@ protected:
 	/** Called when the game starts or when spawned */
 	virtual void BeginPlay() override;
 
+	/** Called when the snake is removed from play */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	/** Movement function for ragdoll mode. Applies force in a direction instead of using the movement component. */
 	void RagdollMovement(FVector ForwardDirection, FVector RightDirection, FVector2D MovementVector);
 
 	/** Sets a timer as a cooldown between ragdoll hops */
 	void TriggerRagdollMovementCooldown();
 
-	/** Update the camera properties depending on the state of the character */
-	void UpdateCamera(float DeltaTime);
-
-	/** Constantly apply forward movement when in hoop mode */
-	void ApplyHoopMovement(float DeltaTime);
-
-	/** Updates certain properties that are accessed by the animation blueprint. */
-	void UpdateAnimationProperties();
-
-	/** Force the snake into a ragdoll state */
-	UFUNCTION(BlueprintCallable, Category = Ragdoll)
-	void ForceRagdoll();
+	/** Returns the camera values the snake wants for its current state */
+	FSnakeCameraTargets GetCameraTargets() const;
 
-	/** Returns the dot product of the character's forward vector between ticks.
-	 * When dot product is 0, we are moving straight forward. When it is less than 0, we are turning right. When it is more than 0, we are turning left. */
-	float TurningDotProduct();
+	/** Read the head's transforms once per tick for everything that follows the ragdolling head */
+	void CacheHeadTransforms();
 
 	/** Hoop Mode State */
 	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = HoopMode)
@@ -248,6 +232,33 @@ protected:
 	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = HoopMode)
 	float TiltInterpSpeed;
 
+	/** User parameter on the speed line system that scales its spawn rate and intensity. Fed with hoop speed from 0 to 1. */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = HoopMode)
+	FName SpeedLineIntensityParameter;
+
+	/** Other players' snakes closer than this to a player's camera get full speed lines */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = HoopMode)
+	float SpeedLineFullSignificanceDistance;
+
+	/** Other players' snakes further than this from every player's camera get no speed lines */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = HoopMode)
+	float SpeedLineCullDistance;
+
+	/** Speed line intensity last written to the effect */
+	float AppliedSpeedLineIntensity;
+
+	/** Whether the speed lines are unpaused and visible */
+	bool bSpeedLinesShown;
+
+	/** Show and unpause the speed lines on entering hoop mode, or pause and hide them on leaving it */
+	void SetSpeedLinesActive(bool bActive);
+
+	/** Activate the speed line system instance if it hasn't been yet, leaving it paused */
+	void StartSpeedLineInstance();
+
+	/** Returns how much the speed lines matter, 1 for a player's own snake, falling off with distance from the players' cameras for the rest */
+	float GetSpeedLineSignificance() const;
+
 	/** Whether the snake's slither animation should be reversed */
 	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = Animation)
 	bool bReverseSlither;
@@ -264,10 +275,95 @@ protected:
 	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = Default)
 	FVector MeshOffset;
 
+	/** Transform of the mesh's head socket, read once at the start of each tick */
+	FTransform CachedHeadSocketTransform;
+
+	/** Location of the head bone, read once at the start of each tick */
+	FVector CachedHeadBoneLocation;
+
+	/** Handles keeping the archetype's core and combat bundles loaded */
+	TSharedPtr<FStreamableHandle> ArchetypeCoreHandle;
+	TSharedPtr<FStreamableHandle> ArchetypeCombatHandle;
+
+	/** Time the core bundle was requested, used to report how long it took to load */
+	double ArchetypeRequestTime;
+
+	/** Whether input actions have been bound. Needs both the input component and the archetype's core bundle. */
+	bool bInputBound;
+
+	/** Set when the archetype asset couldn't be found, so the archetype class defaults are streamed in its place */
+	bool bUsingDefaultArchetype;
+
+	/** Whether the combat bundle has been requested, and whether it has finished loading */
+	bool bCombatRequested;
+	bool bCombatLoaded;
+
+	/** Start loading the archetype's core bundle */
+	void LoadArchetype();
+
+	/** Called once the archetype's core bundle has loaded, applies its meshes and effects and binds input */
+	void OnArchetypeCoreLoaded();
+
+	/** Start loading the archetype's combat bundle if it isn't already loaded or loading */
+	void LoadArchetypeCombat();
+
+	/** Stream one of the class default archetype's bundles, calling back the same way as the asset manager would for an archetype asset */
+	TSharedPtr<FStreamableHandle> LoadDefaultArchetypeBundle(FName Bundle);
+
+	/** Called once the archetype's combat bundle has loaded */
+	void OnArchetypeCombatLoaded();
+
+	/** Add the archetype's mapping context and bind its actions, once both are available */
+	void BindInputActions();
+
+	/** Returns a sound from the archetype's combat bundle, or null if it hasn't loaded yet */
+	USoundCue* GetCombatSound(TSoftObjectPtr<USoundCue> USnakeArchetype::* Sound) const;
+
+	/** Play one of the archetype's combat sounds at a location, or without one */
+	void PlayCombatSound(TSoftObjectPtr<USoundCue> USnakeArchetype::* Sound, const FVector& Location) const;
+	void PlayCombatSound2D(TSoftObjectPtr<USoundCue> USnakeArchetype::* Sound) const;
+
+	/** Returns the bite constraint class from the combat bundle, which is requested as soon as the core bundle arrives. Never loads synchronously. */
+	TSubclassOf<APhysicsConstraintActor> GetBiteConstraintClass() const;
+
+	/** Input component given to SetupPlayerInputComponent, kept so actions can be bound after the archetype loads */
+	UPROPERTY(Transient)
+	UInputComponent* BoundInputComponent;
+
+	/** Whether prewarming has been asked for. It can't happen until the archetype's core bundle has loaded. */
+	bool bPrewarmRequested;
+
+	/** Whether the assets used by mode transitions have already been prewarmed */
+	bool bAssetsPrewarmed;
+
+	/** Name of the mode transition currently being timed, NAME_None when not timing */
+	FName TimedTransition;
+
+	/** Number of frames left to watch after a mode transition */
+	int32 TransitionFramesToWatch;
+
+	/** Worst frame time seen since the timed transition started, in seconds */
+	float WorstTransitionFrameTime;
+
+	/** Start watching the next few frames for hitches caused by a mode transition */
+	void BeginTransitionTiming(FName TransitionName);
+
+	/** Track the worst frame time after a transition, and log it once the watch window is over */
+	void UpdateTransitionTiming();
+
 public:	
 	/** Called every frame */
 	virtual void Tick(float DeltaTime) override;
 
+	/** Keeps the tick batch waiting on whichever controller possesses the snake */
+	virtual void NotifyControllerChanged() override;
+
+	/** Read everything the per frame update needs into State. Game thread only. */
+	void GatherTickState(FSnakeTickState& State, float DeltaTime);
+
+	/** Write the results of the per frame update back to the snake and its components. Game thread only. */
+	void ApplyTickState(const FSnakeTickState& State);
+
 	/** Called to bind functionality to input */
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
@@ -280,21 +376,36 @@ public:
 	/** Toggles hoop mode, with an attack being queued when toggled off */
 	void ToggleHoop(const FInputActionValue& Value);
 
+	/** Hoop action bindings. In low latency input mode the action is taken as soon as it starts, otherwise once it triggers. */
+	void HoopActionStarted(const FInputActionValue& Value);
+	void HoopActionTriggered(const FInputActionValue& Value);
+
+	/** Returns whether this snake's player wants the low latency input mode */
+	bool IsLowLatencyInput() const;
+
+	/** Tell the input latency tracker that one of the player's actions has been handled or taken effect. Steering is axis input, the rest are presses. */
+	void MarkInputHandled(FName Action, bool bAxisInput = false) const;
+	void MarkInputEffect(FName Action) const;
+
+	/** Whether a steering look input is waiting to show up in the hoop's tilt or heading, and the control rotation from when it arrived */
+	bool bSteerInputPending;
+	FRotator SteerControlRotation;
+
 	/** Reset the snake from ragdoll mode */
 	void Reset();
 
 	/** Finish the reset process, should be called through a timer */
 	void FinishReset();
 
+	/** Set the angle both halves of the jaw open to when the animation isn't driving them */
+	void SetJawOpenAngle(float Angle);
+
 	/** Interface function override for triggering attacks based on animation state */
 	void TriggerAttack_Implementation() override;
 
 	/** Removes all HUD elements from the screen */
 	void ClearHUD();
 
-	/** Make noise when snake is moving to alert AI controlled characters */
-	void MovementNoise();
-
 	/** Pause the game */
 	void Pause();
 
@@ -305,9 +416,53 @@ public:
 	/** Attempt to attach to a victim */
 	void AttemptBite(const FHitResult& Hit);
 
+	/** Load and initialise everything that hoop mode and attacks use for the first time, so the first transition doesn't hitch. */
+	void PrewarmAssets();
+
+	/** Returns the player controller possessing this snake, or null if it is AI controlled or unpossessed */
+	APlayerController* GetSnakePlayerController() const;
+
+	/** Returns the HUD of the player controlling this snake if it implements the HUD interface, otherwise null */
+	AHUD* GetSnakeHUD() const;
+
 public:
 	/** Returns CameraBoom subobject **/
 	FORCEINLINE class USpringArmComponent* GetCameraBoom() const { return CameraBoom; }
+	/** Returns Mesh subobject as the snake's own mesh component **/
+	USnakeMeshComponent* GetSnakeMesh() const;
 	/** Returns FollowCamera subobject **/
 	FORCEINLINE class UCameraComponent* GetFollowCamera() const { return FollowCamera; }
+	/** Returns whether the snake's input actions have been bound **/
+	FORCEINLINE bool IsInputBound() const { return bInputBound; }
+	/** Returns whether the snake is in hoop mode **/
+	FORCEINLINE bool IsHoopModeEnabled() const { return bHoopModeEnabled; }
+	/** Returns whether an attack is waiting for the animation to trigger it **/
+	FORCEINLINE bool IsAttackQueued() const { return bAttackQueued; }
+	/** Returns the name of the bone at the snake's head **/
+	FORCEINLINE FName GetHeadBoneName() const { return HeadBoneName; }
+	/** Returns whether the snake is biting something **/
+	FORCEINLINE bool IsBiting() const { return bIsBiting; }
+	/** Returns UpperJaw subobject **/
+	FORCEINLINE USnakeJawComponent* GetUpperJaw() const { return UpperJaw; }
+	/** Returns LowerJaw subobject **/
+	FORCEINLINE USnakeJawComponent* GetLowerJaw() const { return LowerJaw; }
+
+	/** Called when a bite latches onto a victim */
+	FOnSnakeBite OnBite;
+
+	/** Force the snake into a ragdoll state, keeping the velocity it was moving with */
+	UFUNCTION(BlueprintCallable, Category = Ragdoll)
+	void ForceRagdoll();
+
+	/** Force the snake into a ragdoll state with every body moving at the given velocity. Does nothing if it has already been forced. */
+	void ForceRagdollWithVelocity(const FVector& Velocity);
+
+	/** Put the snake straight back to its starting state at the given transform: out of hoop mode and ragdoll, with no bite and nothing on its HUD */
+	void RestoreToTransform(const FTransform& Transform);
+
+	/** Work out how much memory this snake is holding on to */
+	FSnakeMemoryFootprint GetMemoryFootprint() const;
+
+	/** Name of the pose snapshot saved when resetting out of ragdoll */
+	static const FName RagdollPoseName;
 };
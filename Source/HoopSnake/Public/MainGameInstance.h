@@ -4,14 +4,124 @@
 
 #include "CoreMinimal.h"
 #include "Engine/GameInstance.h"
+#include "Containers/Ticker.h"
 #include "MainGameInstance.generated.h"
 
+/** A console variable that is held at a cheaper value while booting, and restored once the map has streamed in */
+USTRUCT()
+struct FDeferredConsoleVariable
+{
+	GENERATED_BODY()
+
+	/** Name of the console variable */
+	UPROPERTY(Config)
+	FString Name;
+
+	/** Value used until the map has streamed in */
+	UPROPERTY(Config)
+	FString BootValue;
+};
+
 /**
  * 
  */
-UCLASS()
+UCLASS(Config = Game)
 class HOOPSNAKE_API UMainGameInstance : public UGameInstance
 {
 	GENERATED_BODY()
-	
+
+public:
+	/** Sets default values for this game instance's properties */
+	UMainGameInstance();
+
+	virtual void Init() override;
+	virtual void Shutdown() override;
+
+	/** Record a startup milestone, timestamped from process start. Only the first time each milestone is reached is kept. */
+	UFUNCTION(BlueprintCallable, Category = Startup)
+	void MarkStartupMilestone(FName Milestone);
+
+	/** Write the recorded milestones to Saved/Profiling/StartupReport.csv */
+	UFUNCTION(BlueprintCallable, Category = Startup)
+	void WriteStartupReport();
+
+	/** Whether the game has reached its first frame with a controllable snake */
+	bool HasReachedFirstPlayableFrame() const { return bReachedFirstPlayableFrame; }
+
+	/** Reload the current map, logging how long it takes to load, finish streaming and become playable again */
+	void ReloadLevelTimed();
+
+protected:
+	/** Called after each map load */
+	void OnPostLoadMap(UWorld* LoadedWorld);
+
+	/** Watches for startup milestones that can only be polled for. Removes itself once the game is playable. */
+	bool TickStartup(float DeltaTime);
+
+	/** Watches a timed reload until the reloaded map is playable */
+	bool TickReload(float DeltaTime);
+
+	/** Returns whether the world has streamed in and its local player's snake has input bound */
+	bool IsWorldPlayable(UWorld* World, bool& bOutStreamingComplete) const;
+
+	/** Hold the deferred console variables at their boot values */
+	void ApplyFastBoot();
+
+	/** Put the deferred console variables back to what they were before booting */
+	void RestoreDeferredSubsystems();
+
+	/** On the first launch, benchmark the machine and pick scalability levels from the result */
+	void AutoDetectScalability();
+
+	/** Whether to write the startup report once the game is playable */
+	UPROPERTY(Config)
+	bool bWriteStartupReport;
+
+	/** Whether to defer non-essential subsystems until after the first playable frame */
+	UPROPERTY(Config)
+	bool bFastBoot;
+
+	/** Whether to pick scalability levels from a hardware benchmark the first time the game is run */
+	UPROPERTY(Config)
+	bool bAutoDetectScalability;
+
+	/** Console variables to hold at a cheaper value while booting when fast boot is on, e.g. HLOD and reverb */
+	UPROPERTY(Config)
+	TArray<FDeferredConsoleVariable> FastBootDeferredCVars;
+
+	/** Seconds after init to restore the deferred console variables even if nothing ever becomes playable, e.g. AI only maps or headless runs */
+	UPROPERTY(Config)
+	float FastBootRestoreTimeout;
+
+	/** Seconds a timed reload waits for the map to load and become playable before giving up */
+	UPROPERTY(Config)
+	float ReloadTimeout;
+
+	/** A milestone and the time it was reached, in seconds since process start */
+	struct FStartupMilestone
+	{
+		FName Name;
+		double Seconds;
+	};
+
+	/** Milestones in the order they were reached */
+	TArray<FStartupMilestone> Milestones;
+
+	/** Values the deferred console variables had before fast boot changed them */
+	TMap<FString, FString> SavedCVarValues;
+
+	/** When fast boot was applied, in seconds */
+	double FastBootStartTime;
+
+	FTSTicker::FDelegateHandle StartupTickHandle;
+	FTSTicker::FDelegateHandle ReloadTickHandle;
+
+	/** When the timed reload started, and when its map finished loading and streaming, in seconds. Zero when not reached. */
+	double ReloadStartTime;
+	double ReloadMapLoadedTime;
+	double ReloadStreamedTime;
+	FDelegateHandle PostLoadMapHandle;
+
+	bool bReachedFirstPlayableFrame;
+	bool bStartupReportWritten;
 };
@@ -4,14 +4,292 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/GameMode.h"
+#include "Containers/Ticker.h"
 #include "MainGameMode.generated.h"
 
+class AHoopSnakeCharacter;
+class AVictimAIController;
+class UPhysicsConstraintComponent;
+class ULevel;
+
+/** Where an actor was when the world snapshot was taken, and whether its physics was asleep */
+struct FSnakeActorSnapshot
+{
+	TWeakObjectPtr<AActor> Actor;
+	FTransform Transform;
+	bool bAsleep = false;
+};
+
+/** A constraint placed in the level, and whether it had already broken when the snapshot was taken */
+struct FSnakeConstraintSnapshot
+{
+	TWeakObjectPtr<UPhysicsConstraintComponent> Constraint;
+	bool bBroken = false;
+};
+
 /**
  * 
  */
-UCLASS()
+UCLASS(Config = Game)
 class HOOPSNAKE_API AMainGameMode : public AGameMode
 {
 	GENERATED_BODY()
-	
+
+public:
+	/** Sets default values for this game mode's properties */
+	AMainGameMode();
+
+	/** Prewarms the snake and HUD once a player has been given their pawn */
+	virtual void FinishRestartPlayer(AController* NewPlayer, const FRotator& StartRotation) override;
+
+	/** Spawn a number of victims around the first player, for stress testing AI */
+	UFUNCTION(Exec)
+	void SpawnVictims(int32 Count);
+
+	/** Log how many victims the AI manager has and what its tick costs */
+	UFUNCTION(Exec)
+	void VictimAIStats();
+
+	/** Log the victim pool's size and hit rate, and how many ragdoll bodies are simulating */
+	UFUNCTION(Exec)
+	void VictimPoolStats();
+
+	/** Returns a victim placed at the given transform, taken from the pool if possible and spawned otherwise */
+	ACharacter* AcquireVictim(const FTransform& SpawnTransform);
+
+	/** Take a knocked out victim out of play and put it in the pool. Another victim is brought back at a spawn point after a delay. */
+	void ReleaseVictim(AVictimAIController* VictimController);
+
+	/** Time proximity grid queries against physics overlaps for the snakes and victims currently in the world */
+	UFUNCTION(Exec)
+	void BenchProximity(int32 NumQueries = 1000, float Radius = 1500.0f);
+
+	/** Record snake physics stats for a preset, or for every preset in turn when none is given, and write them to CSV */
+	UFUNCTION(Exec)
+	void SnakePhysicsProfile(FName Preset = NAME_None, float SecondsPerPreset = 10.0f);
+
+	/** Stop a running snake physics profile and write out what it has so far */
+	UFUNCTION(Exec)
+	void SnakePhysicsProfileStop();
+
+	/** Spawn a number of AI controlled snakes around the first player */
+	UFUNCTION(Exec)
+	void SpawnSnakes(int32 Count);
+
+	/** Spawn AI snakes a step at a time, logging frame times at each snake count. Bench snakes are destroyed at the end. */
+	UFUNCTION(Exec)
+	void BenchSnakes(int32 MaxSnakes = 64, int32 Step = 8, float SecondsPerStep = 5.0f);
+
+	/** Drive the hoop mode frame budget controller with synthetic frame times, log its decisions and check them. Works under -nullrhi. */
+	UFUNCTION(Exec)
+	void SimulateFrameBudget(float BaseMilliseconds = 12.0f, float PeakMilliseconds = 30.0f, int32 NumFrames = 1200);
+
+	/** Play back the last few seconds of the player's snake and the victims around it */
+	UFUNCTION(Exec)
+	void Killcam();
+
+	/** Compare per actor and batched snake ticks at 1, 16 and 128 snakes, logging the average actor tick time of each run */
+	UFUNCTION(Exec)
+	void BenchSnakeTick(int32 FramesPerRun = 300);
+
+	/** Time changing collision on the player snake's bodies one bone at a time against the batched library function */
+	UFUNCTION(Exec)
+	void BenchBodyChanges(int32 Iterations = 100);
+
+	/** Log how long the player's actions take from input to screen, tracked while hoopsnake.InputLatency is on */
+	UFUNCTION(Exec)
+	void InputLatencyStats();
+
+	/** Log the memory each snake is holding on to, split into components, anim instance, physics bodies and pose snapshots */
+	UFUNCTION(Exec)
+	void SnakeMemory();
+
+	/** Log the camera occlusion sweeps issued and the occluders being faded */
+	UFUNCTION(Exec)
+	void OcclusionStats();
+
+	/** Compare obstacles as separate actors against instances, with the level's obstacle count multiplied */
+	UFUNCTION(Exec)
+	void BenchObstacles(int32 Multiplier = 10, int32 FramesPerRun = 300);
+
+	/** Put snakes, victims and physics props back how they were when play started, without reloading the map */
+	UFUNCTION(Exec)
+	void ResetWorld();
+
+	/** Time a number of in place world resets */
+	UFUNCTION(Exec)
+	void BenchReset(int32 Iterations = 10);
+
+	/** Reload the map with OpenLevel, logging how long until it is playable again, to compare against ResetWorld */
+	UFUNCTION(Exec)
+	void BenchReload();
+
+	/** Spawn AI snakes and victims, then step the world at a fixed timestep as fast as possible for the given simulated time and report
+	 * steps per second, bite success and physics stability. Overrides set snake properties, e.g. "AttackForceForward=1500,TiltModifier=2".
+	 * Also started with -SnakeSim=<seconds> [-SimSnakes=N] [-SimVictims=N] [-SimSet=<overrides>], which quits when done. Use with -nullrhi -nosound. */
+	UFUNCTION(Exec)
+	void SnakeSim(float SimSeconds = 600.0f, int32 NumSnakes = 8, int32 NumVictims = 32, const FString& Overrides = TEXT(""));
+
+protected:
+	/** Warns when the HUD class isn't the native snake HUD, which the victims' alert overlay and pooled widgets need */
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+
+	/** Called when play begins, prewarms any snakes that were placed in the level */
+	virtual void StartPlay() override;
+
+	/** Called when play ends, stops any running snake benchmark */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Load and initialise the assets a snake uses on its first hoop toggle and attack */
+	void PrewarmSnake(AHoopSnakeCharacter* Snake);
+
+	/** Look for ragdolled victims that have settled and pool them, and count the ragdoll bodies still simulating */
+	void UpdateVictimPool();
+
+	/** Bring a victim back into play at the given transform, called through a timer after a victim is pooled */
+	void RespawnVictim(FTransform SpawnTransform);
+
+	/** Returns where a victim should come back after being pooled */
+	FTransform PickVictimSpawnTransform(const AVictimAIController* VictimController) const;
+
+	/** Stop a victim ragdolling and put its meshes back in their animated pose */
+	void ResetVictimRagdoll(ACharacter* Victim);
+
+	/** Show or hide a victim, along with its collision, animation and movement */
+	void SetVictimActive(ACharacter* Victim, bool bActive);
+
+	/** Returns whether a snake's bite constraint is holding the victim */
+	bool IsVictimHeld(const ACharacter* Victim) const;
+
+	/** Spawn an AI controlled snake somewhere around the given location */
+	AHoopSnakeCharacter* SpawnAISnake(const FVector& Origin);
+
+	/** Returns where stress test actors should be spawned around */
+	FVector GetStressTestOrigin() const;
+
+	/** Samples frame times for the snake benchmark, and spawns the next step of snakes */
+	bool TickSnakeBenchmark(float DeltaTime);
+
+	/** Samples actor tick times for the snake tick benchmark, and moves on to the next run */
+	bool TickSnakeTickBenchmark(float DeltaTime);
+
+	/** Spawn snakes up to the run's count and switch the tick path the run measures */
+	void BeginSnakeTickRun();
+
+	/** Destroy the benchmark's snakes and stop ticking it */
+	void StopSnakeBenchmark();
+
+	/** Record the actors in a level that ResetWorld puts back. Actors already recorded keep their first snapshot. */
+	void CaptureWorldSnapshot(ULevel* Level);
+
+	/** Start the snake simulation, from the console or the command line */
+	void StartSnakeSim(float SimSeconds, int32 NumSnakes, int32 NumVictims, const FString& Overrides, bool bExitWhenDone);
+
+	/** Snapshot world partition cells as they stream in */
+	void OnLevelAddedToWorld(ULevel* Level, UWorld* InWorld);
+
+	/** Forget the snapshot of cells as they stream out, along with anything else that has been destroyed */
+	void OnLevelRemovedFromWorld(ULevel* Level, UWorld* InWorld);
+
+	/** Put everything recorded back, and remove snakes, victims and bite constraints that weren't there when it was recorded */
+	void RestoreWorldSnapshot();
+
+	/** Whether snakes and HUD widgets should be prewarmed when play starts */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = Startup)
+	bool bPrewarmSnakes;
+
+	/** Victim class spawned by stress tests and the snake simulation. Set in DefaultGame.ini. */
+	UPROPERTY(Config, BlueprintReadWrite, EditDefaultsOnly, Category = Victims)
+	TSubclassOf<ACharacter> VictimClass;
+
+	/** Radius around the player that stress test victims are spawned in */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = Victims)
+	float VictimSpawnRadius;
+
+	/** Whether knocked out victims are recycled through a pool rather than left ragdolling */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = Victims)
+	bool bPoolVictims;
+
+	/** How long a ragdolled victim has to stay at rest before it is pooled */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = Victims)
+	float VictimSettleTime;
+
+	/** Speed below which a ragdolled victim counts as at rest */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = Victims)
+	float VictimSettleSpeed;
+
+	/** Delay between a victim being pooled and one coming back at a spawn point */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = Victims)
+	float VictimRespawnDelay;
+
+	/** How often ragdolled victims are checked */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = Victims)
+	float VictimPoolScanInterval;
+
+	/** Actors with this tag are used as victim spawn points. Without any, victims come back where they started. */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = Victims)
+	FName VictimSpawnPointTag;
+
+	/** Victims waiting to be brought back */
+	UPROPERTY(Transient)
+	TArray<AVictimAIController*> VictimPool;
+
+	/** Tagged victim spawn points found when play started */
+	UPROPERTY(Transient)
+	TArray<AActor*> VictimSpawnPoints;
+
+	/** Victims taken from the pool, and victims that had to be spawned because the pool was empty */
+	int32 VictimPoolHits;
+	int32 VictimPoolMisses;
+
+	/** Ragdolled victims and their simulating bodies, as of the last pool update */
+	int32 RagdolledVictims;
+	int32 LiveVictimBodies;
+
+	/** Timer for checking ragdolled victims */
+	FTimerHandle VictimPoolTimerHandle;
+
+	/** Snake class spawned by stress tests. Falls back to the default pawn class if that is a snake. */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = Snakes)
+	TSubclassOf<AHoopSnakeCharacter> SnakeClass;
+
+	/** Radius around the player that stress test snakes are spawned in */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = Snakes)
+	float SnakeSpawnRadius;
+
+	/** Snakes spawned by the running benchmark */
+	TArray<TWeakObjectPtr<AHoopSnakeCharacter>> BenchSnakeList;
+
+	/** Settings of the running benchmark */
+	int32 BenchMaxSnakes;
+	int32 BenchStep;
+	float BenchSecondsPerStep;
+
+	/** Frame times sampled at the current snake count */
+	double BenchStepTime;
+	double BenchTotalFrameTime;
+	double BenchWorstFrameTime;
+	int32 BenchFrameCount;
+
+	/** Snake tick benchmark run, counting through each snake count once per actor and once batched */
+	int32 BenchTickRun;
+	int32 BenchFramesPerRun;
+
+	/** Batched tick setting from before the snake tick benchmark, restored when it stops */
+	FString BenchSavedBatchedTick;
+
+	/** Handle for the benchmark's ticker, valid while it runs */
+	FTSTicker::FDelegateHandle BenchTickHandle;
+
+	/** Snakes, victims and simulating props as they were when play started */
+	TArray<FSnakeActorSnapshot> SnapshotSnakes;
+	TArray<FSnakeActorSnapshot> SnapshotVictims;
+	TArray<FSnakeActorSnapshot> SnapshotPhysicsActors;
+	TArray<FSnakeConstraintSnapshot> SnapshotConstraints;
+
+	/** Every actor in the snapshot, so ones added since can be found */
+	TSet<TWeakObjectPtr<AActor>> SnapshotActors;
+
+	FDelegateHandle SnapshotLevelAddedHandle;
+	FDelegateHandle SnapshotLevelRemovedHandle;
 };
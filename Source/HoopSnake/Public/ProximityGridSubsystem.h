@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Components/SceneComponent.h"
+#include "ProximityGridSubsystem.generated.h"
+
+/** What kind of actor an entry in the proximity grid is. Used as a mask when querying. */
+UENUM(meta = (Bitflags, UseEnumValuesAsMaskValuesInEditor = "true"))
+enum class EProximityKind : uint8
+{
+	None = 0,
+	Snake = 1 << 0,
+	Victim = 1 << 1,
+	All = Snake | Victim
+};
+ENUM_CLASS_FLAGS(EProximityKind);
+
+/**
+ * Uniform grid of snakes and victims for "who is near here" questions.
+ * Actors register once. Nothing is polled: an entry is updated when its actor's root component moves, and its cell only changes
+ * when the actor crosses into a new one. Actors leave the grid when they end play. Queries walk the overlapping cells and call back
+ * for each match, so they don't allocate.
+ */
+UCLASS(Config = Game)
+class HOOPSNAKE_API UProximityGridSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UProximityGridSubsystem();
+
+	virtual void Deinitialize() override;
+
+	/** Start tracking an actor. Needs a root component to follow. */
+	void Register(AActor* Actor, EProximityKind Kind);
+
+	/** Stop tracking an actor */
+	void Unregister(AActor* Actor);
+
+	/** Calls Func for every tracked actor of the given kinds within Radius of Center */
+	void ForEachInRadius(const FVector& Center, float Radius, EProximityKind KindMask, TFunctionRef<void(AActor* Actor, const FVector& Location, float DistanceSquared)> Func) const;
+
+	/** Calls Func for every tracked actor of the given kinds within Radius of Origin and HalfAngleDegrees of Direction */
+	void ForEachInCone(const FVector& Origin, const FVector& Direction, float Radius, float HalfAngleDegrees, EProximityKind KindMask, TFunctionRef<void(AActor* Actor, const FVector& Location, float DistanceSquared)> Func) const;
+
+	/** Returns the closest tracked actor of the given kinds within Radius of Center, or null */
+	AActor* FindNearest(const FVector& Center, float Radius, EProximityKind KindMask, float* OutDistance = nullptr) const;
+
+	/** Returns the number of tracked actors */
+	int32 GetNumEntries() const { return ActorToEntry.Num(); }
+
+	/** Time radius queries against the grid and against a physics overlap at the same spots, and log the results */
+	void RunBenchmark(int32 NumQueries, float Radius) const;
+
+protected:
+	/** A tracked actor and where the grid thinks it is */
+	struct FEntry
+	{
+		TWeakObjectPtr<AActor> Actor;
+		FVector Location;
+		FIntVector Cell;
+		EProximityKind Kind;
+
+		/** Component whose moves are followed, and the binding to them */
+		TWeakObjectPtr<USceneComponent> Root;
+		FDelegateHandle MovedHandle;
+	};
+
+	/** Returns the cell a location falls in */
+	FIntVector GetCell(const FVector& Location) const;
+
+	/** Remove an entry from its cell's list */
+	void RemoveFromCell(int32 EntryIndex);
+
+	/** Update an entry's location, and its cell if it has crossed into another one */
+	void OnEntryMoved(USceneComponent* Root, EUpdateTransformFlags UpdateFlags, ETeleportType Teleport, int32 EntryIndex);
+
+	/** Drop actors as they're destroyed or streamed out, so the grid never holds stale entries */
+	UFUNCTION()
+	void OnTrackedActorEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason);
+
+	/** Size of each grid cell, in world units. Works best around the radius of the most common query. */
+	UPROPERTY(Config)
+	float CellSize;
+
+	/** Tracked actors. Unused slots are recycled through FreeEntries. */
+	TArray<FEntry> Entries;
+	TArray<int32> FreeEntries;
+
+	/** Lookup from actor to its entry */
+	TMap<TWeakObjectPtr<AActor>, int32> ActorToEntry;
+
+	/** Entries in each occupied cell. Cells are kept once created, so moving back and forth doesn't reallocate. */
+	TMap<FIntVector, TArray<int32>> Cells;
+};
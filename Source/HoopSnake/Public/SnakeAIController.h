@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AIController.h"
+#include "SnakeAIController.generated.h"
+
+class AHoopSnakeCharacter;
+
+/** What an AI snake is currently doing */
+UENUM(BlueprintType)
+enum class ESnakeAIState : uint8
+{
+	Seeking,
+	Rolling,
+	Attacking,
+	Recovering
+};
+
+/**
+ * Controller for snakes that aren't possessed by a player. Goes through the same actions a player would:
+ * finds the nearest victim, rolls at it in hoop mode, attacks when close and resets after the ragdoll settles.
+ * Bites happen on their own when the attacking head hits a victim.
+ */
+UCLASS()
+class HOOPSNAKE_API ASnakeAIController : public AAIController
+{
+	GENERATED_BODY()
+
+public:
+	/** Sets default values for this controller's properties */
+	ASnakeAIController();
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	/** Returns what the snake is currently doing */
+	UFUNCTION(BlueprintCallable, Category = AI)
+	ESnakeAIState GetSnakeState() const { return SnakeState; }
+
+	/** Drop the target and go back to seeking, for when the snake has been put back somewhere else */
+	void ResetState();
+
+protected:
+	virtual void OnPossess(APawn* InPawn) override;
+	virtual void OnUnPossess() override;
+
+	/** Move on to a new state and restart the state timer */
+	void SetSnakeState(ESnakeAIState NewState);
+
+	/** Look for the nearest victim and focus on it */
+	AActor* FindTarget();
+
+	/** How far away victims are looked for */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = AI)
+	float SeekRadius;
+
+	/** Distance to the target at which the snake leaves hoop mode and attacks */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = AI)
+	float AttackRange;
+
+	/** Longest the snake will roll at a target before attacking anyway */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = AI)
+	float MaxRollTime;
+
+	/** How long to wait for the animation to trigger a queued attack before giving up on it */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = AI)
+	float AttackTimeout;
+
+	/** How long to stay ragdolled, or biting, before resetting */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = AI)
+	float RecoverDelay;
+
+	/** Current state */
+	UPROPERTY(BlueprintReadOnly, Category = AI)
+	ESnakeAIState SnakeState;
+
+	/** Time spent in the current state */
+	float StateTime;
+
+	/** Whether a reset has been asked for during this recovery */
+	bool bResetRequested;
+
+	/** Victim being chased */
+	TWeakObjectPtr<AActor> Target;
+
+	/** The possessed snake */
+	UPROPERTY(Transient)
+	AHoopSnakeCharacter* Snake;
+};
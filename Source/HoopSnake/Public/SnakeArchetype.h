@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "SnakeArchetype.generated.h"
+
+class UInputMappingContext;
+class UInputAction;
+class USoundCue;
+class UNiagaraSystem;
+class UStaticMesh;
+class APhysicsConstraintActor;
+
+/**
+ * Everything a snake needs from content, held as soft references so the pawn blueprint doesn't drag it all in with it.
+ * Loaded through the asset manager in two bundles: "Core" when the snake spawns and "Combat" before its first attack.
+ * The class defaults point at the game's own snake content, so a new archetype asset starts out as a working snake.
+ */
+UCLASS(BlueprintType)
+class HOOPSNAKE_API USnakeArchetype : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	/** Primary asset type used for all snake archetypes */
+	static const FPrimaryAssetType PrimaryAssetType;
+
+	/** Bundle loaded when the snake spawns */
+	static const FName CoreBundle;
+
+	/** Bundle loaded before the snake's first attack */
+	static const FName CombatBundle;
+
+	USnakeArchetype();
+
+	virtual FPrimaryAssetId GetPrimaryAssetId() const override;
+
+	/** Returns every asset in one of the bundles, for streaming an archetype that isn't registered with the asset manager, such as the class defaults */
+	void GetBundleAssets(FName Bundle, TArray<FSoftObjectPath>& OutAssets) const;
+
+	// *** INPUT *** //
+	/** MappingContext */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Input, meta = (AssetBundles = "Core"))
+	TSoftObjectPtr<UInputMappingContext> DefaultMappingContext;
+
+	/** Move Input Action */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Input, meta = (AssetBundles = "Core"))
+	TSoftObjectPtr<UInputAction> MoveAction;
+
+	/** Look Input Action */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Input, meta = (AssetBundles = "Core"))
+	TSoftObjectPtr<UInputAction> LookAction;
+
+	/** Hoop Toggle Input Action */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Input, meta = (AssetBundles = "Core"))
+	TSoftObjectPtr<UInputAction> HoopAction;
+
+	/** Reset Snake Input Action */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Input, meta = (AssetBundles = "Core"))
+	TSoftObjectPtr<UInputAction> ResetAction;
+
+	/** Pause Input Action */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Input, meta = (AssetBundles = "Core"))
+	TSoftObjectPtr<UInputAction> PauseAction;
+	// ************* //
+
+	// *** VISUALS *** //
+	/** Upper half of the snake's head */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Visuals, meta = (AssetBundles = "Core"))
+	TSoftObjectPtr<UStaticMesh> UpperJawMesh;
+
+	/** Lower half of the snake's head */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Visuals, meta = (AssetBundles = "Core"))
+	TSoftObjectPtr<UStaticMesh> LowerJawMesh;
+
+	/** Line emitter to convey speed in hoop mode */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Visuals, meta = (AssetBundles = "Core"))
+	TSoftObjectPtr<UNiagaraSystem> SpeedLineSystem;
+	// ************* //
+
+	// *** COMBAT *** //
+	/** Whoosh Sound Effect - used when ragdolling */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Sound, meta = (AssetBundles = "Combat"))
+	TSoftObjectPtr<USoundCue> WhooshSound;
+
+	/** Hiss Sound Effect - used when attacking */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Sound, meta = (AssetBundles = "Combat"))
+	TSoftObjectPtr<USoundCue> HissSound;
+
+	/** Impact Sound Effect - used when colliding */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Sound, meta = (AssetBundles = "Combat"))
+	TSoftObjectPtr<USoundCue> ImpactSound;
+
+	/** Bite sound effect */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Sound, meta = (AssetBundles = "Combat"))
+	TSoftObjectPtr<USoundCue> BiteSound;
+
+	/** Bite physics constraint class */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Default, meta = (AssetBundles = "Combat"))
+	TSoftClassPtr<APhysicsConstraintActor> BiteConstraintClass;
+	// ************* //
+};
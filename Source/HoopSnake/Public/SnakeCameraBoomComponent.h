@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/SpringArmComponent.h"
+#include "SnakeCameraBoomComponent.generated.h"
+
+class UCameraComponent;
+
+/** Camera values the snake wants for its current state */
+struct FSnakeCameraTargets
+{
+	float FieldOfView = 90.0f;
+	float ArmLength = 250.0f;
+	FVector SocketOffset = FVector::ZeroVector;
+
+	/** Where the boom should sit. Relative to its parent, or in world space when bBoomLocationIsWorld is set. */
+	FVector BoomLocation = FVector::ZeroVector;
+	bool bBoomLocationIsWorld = false;
+};
+
+/** Interpolated camera values, kept apart from the components so they can be worked out off the game thread */
+struct FSnakeCameraState
+{
+	float FieldOfView = 90.0f;
+	float ArmLength = 250.0f;
+	FVector SocketOffset = FVector::ZeroVector;
+
+	/** Whether every value has reached its target */
+	bool bConverged = false;
+
+	/** Move towards the targets, snapping onto them once within Tolerance. Returns false if nothing changed. */
+	bool Interpolate(const FSnakeCameraTargets& Targets, float DeltaTime, float InterpSpeed, float Tolerance);
+};
+
+/**
+ * Spring arm for the snake's camera. Interpolates the field of view, arm length, socket offset and boom position
+ * towards the snake's targets, stops writing once they've converged, and moves the boom with a single transform update.
+ */
+UCLASS(ClassGroup = Camera, meta = (BlueprintSpawnableComponent))
+class HOOPSNAKE_API USnakeCameraBoomComponent : public USpringArmComponent
+{
+	GENERATED_BODY()
+
+public:
+	USnakeCameraBoomComponent();
+
+	/** Interpolate towards the targets and apply the result. ParentSocketTransform is needed for world space boom locations. */
+	void UpdateCamera(const FSnakeCameraTargets& Targets, float DeltaTime, float InterpSpeed, UCameraComponent* Camera, const FTransform& ParentSocketTransform);
+
+	/** Apply a state that has already been interpolated, writing only what changed */
+	void ApplyCameraState(const FSnakeCameraState& NewState, const FSnakeCameraTargets& Targets, UCameraComponent* Camera, const FTransform& ParentSocketTransform);
+
+	/** Returns the current interpolated state, initialising it from the components the first time */
+	const FSnakeCameraState& GetCameraState(const UCameraComponent* Camera);
+
+	/** How close interpolated values need to be to their targets before they snap and stop updating */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Camera)
+	float ConvergenceTolerance;
+
+protected:
+	/** Move the boom to its target location if it isn't already there */
+	void ApplyBoomLocation(const FSnakeCameraTargets& Targets, const FTransform& ParentSocketTransform);
+
+	/** Current interpolated values */
+	FSnakeCameraState CameraState;
+
+	/** Whether CameraState has been read from the components yet */
+	bool bCameraStateInitialised;
+};
@@ -0,0 +1,145 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/HUD.h"
+#include "HUDInterface.h"
+#include "Styling/SlateBrush.h"
+#include "SnakeHUD.generated.h"
+
+class UCommonActivatableWidget;
+class UCommonActivatableWidgetContainerBase;
+class UTexture2D;
+class SVictimAlertOverlay;
+
+/**
+ * Native HUD for the snake. Widgets are pushed onto the CommonUI activatable widget stack in the UI base layout,
+ * which keeps every widget it has made in a pool and hands a popped instance back out on the next push of that class.
+ * Prewarming pushes and pops each widget once, so hoop toggles, resets and pausing don't create any widgets afterwards.
+ * Victim alert icons are drawn by one viewport overlay for every victim, rather than a widget component on each.
+ */
+UCLASS(Config = Game)
+class HOOPSNAKE_API ASnakeHUD : public AHUD, public IHUDInterface
+{
+	GENERATED_BODY()
+
+public:
+	ASnakeHUD();
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void DrawHUD() override;
+
+	virtual void PushCrosshair_Implementation() override;
+	virtual void PushFadeToBlack_Implementation() override;
+	virtual void PushPauseMenu_Implementation() override;
+	virtual void PopWidget_Implementation() override;
+	virtual void PopAllWidgets_Implementation() override;
+	virtual void PrewarmWidgets_Implementation() override;
+
+	/** Returns the number of widgets made since prewarming, which should stay at zero */
+	int32 GetWidgetsCreatedSincePrewarm() const { return WidgetsCreatedSincePrewarm; }
+
+protected:
+	/** Create the layout and add it to the viewport, if it hasn't been already */
+	void CreateLayout();
+
+	/** Push a widget onto the stack, reusing a pooled instance if there is one */
+	UCommonActivatableWidget* PushWidget(UClass* WidgetClass);
+
+	/** Add the victim alert overlay to the player's viewport */
+	void CreateAlertOverlay();
+
+	/** Hand the overlay this frame's alerted victims and camera */
+	void UpdateAlertOverlay();
+
+	/** Layout holding the widget stack */
+	UPROPERTY(Config)
+	FSoftClassPath LayoutClass;
+
+	/** Name of the activatable widget stack in the layout */
+	UPROPERTY(Config)
+	FName StackName;
+
+	/** Widget classes pushed through the HUD interface */
+	UPROPERTY(Config)
+	FSoftClassPath CrosshairClass;
+
+	UPROPERTY(Config)
+	FSoftClassPath FadeToBlackClass;
+
+	UPROPERTY(Config)
+	FSoftClassPath PauseMenuClass;
+
+	/** Wrap the layout in an invalidation box, so the crosshair and pause menu are only repainted when they change */
+	UPROPERTY(Config)
+	bool bCacheLayout;
+
+	/** Whether victim alert icons are drawn */
+	UPROPERTY(Config)
+	bool bShowVictimAlerts;
+
+	/** Icons for alert and panicked victims */
+	UPROPERTY(Config)
+	FSoftObjectPath AlertIconTexture;
+
+	UPROPERTY(Config)
+	FSoftObjectPath PanicIconTexture;
+
+	/** Size of an alert icon on screen */
+	UPROPERTY(Config)
+	float AlertIconSize;
+
+	/** How far above the victim's origin the icon sits */
+	UPROPERTY(Config)
+	float AlertIconHeight;
+
+	/** Icons start fading out at this distance from the camera, and are gone by the max distance */
+	UPROPERTY(Config)
+	float AlertFadeStartDistance;
+
+	UPROPERTY(Config)
+	float AlertMaxDistance;
+
+	/** Loaded alert icon textures */
+	UPROPERTY(Transient)
+	UTexture2D* LoadedAlertIcon;
+
+	UPROPERTY(Transient)
+	UTexture2D* LoadedPanicIcon;
+
+	/** Brushes the overlay draws the icons with, owned here so they live as long as the overlay */
+	UPROPERTY(Transient)
+	FSlateBrush AlertBrush;
+
+	UPROPERTY(Transient)
+	FSlateBrush PanicBrush;
+
+	/** Overlay drawing every victim's alert icon */
+	TSharedPtr<SVictimAlertOverlay> AlertOverlay;
+
+	/** Layout widget, made once for the HUD's lifetime */
+	UPROPERTY(Transient)
+	UCommonActivatableWidget* Layout;
+
+	/** Widget stack in the layout, which owns the widget pool */
+	UPROPERTY(Transient)
+	UCommonActivatableWidgetContainerBase* Stack;
+
+	/** Loaded widget classes */
+	UPROPERTY(Transient)
+	UClass* LoadedCrosshairClass;
+
+	UPROPERTY(Transient)
+	UClass* LoadedFadeToBlackClass;
+
+	UPROPERTY(Transient)
+	UClass* LoadedPauseMenuClass;
+
+	/** Every widget instance the stack has handed out, to spot new ones being made */
+	TSet<TWeakObjectPtr<UCommonActivatableWidget>> KnownWidgets;
+
+	bool bPrewarmed;
+	int32 WidgetsCreatedSincePrewarm;
+};
@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "RHIFwd.h"
+#include "SnakeInputLatencyTracker.generated.h"
+
+class FSnakeInputLatencyProcessor;
+class SWindow;
+
+/** One player action followed from the input that caused it to the frame that shows it */
+struct FSnakeInputLatencySample
+{
+	FName Action;
+
+	/** When Slate received the input, or when the action was handled if it came in before this frame */
+	double InputTime = 0.0;
+
+	/** When the input binding ran */
+	double HandledTime = 0.0;
+
+	/** When the gameplay change happened, and on which frame */
+	double EffectTime = 0.0;
+	uint32 EffectFrame = 0;
+};
+
+/** Running totals for one action, in seconds */
+struct FSnakeInputLatencyTotals
+{
+	int32 Count = 0;
+	double InputToHandled = 0.0;
+	double HandledToEffect = 0.0;
+	double EffectToPresent = 0.0;
+	double InputToPresent = 0.0;
+	double WorstInputToPresent = 0.0;
+};
+
+/**
+ * Times the player's actions in stages: input received by Slate, input binding run, gameplay effect applied
+ * (impulse added, mode switched) and the frame carrying that effect handed over to be presented. Shows whether
+ * delay comes from input processing, from gameplay waiting on something such as the attack's animation window,
+ * or from the render pipeline. Turned on with hoopsnake.InputLatency.
+ */
+UCLASS()
+class HOOPSNAKE_API USnakeInputLatencyTracker : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	USnakeInputLatencyTracker();
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Returns whether actions are being timed */
+	static bool IsTracking();
+
+	/** An input binding for the action has run. Ignored while the action already has a sample in flight.
+	 * Axis actions, such as steering, are timed from the last mouse move or stick input, the rest from the last key or button press. */
+	void MarkHandled(FName Action, bool bAxisInput = false);
+
+	/** The action's gameplay change has happened. Ignored if the action wasn't handled first. */
+	void MarkEffect(FName Action);
+
+	/** Log the average and worst time of each stage for every action, then start the totals over */
+	void LogStats();
+
+	/** Note that Slate has received some input, either a press or axis movement. Called by the input processor. */
+	void OnInputReceived(bool bAxisInput) { (bAxisInput ? LastAxisInputTime : LastButtonInputTime) = FPlatformTime::Seconds(); }
+
+protected:
+	/** Render thread callback for a window's back buffer about to be presented */
+	void OnBackBufferReadyToPresent(SWindow& Window, const FTextureRHIRef& BackBuffer);
+
+	/** Add a finished sample to its action's totals */
+	void CompleteSample(const FSnakeInputLatencySample& Sample, double PresentTime);
+
+	/** Samples handled but not yet on screen, at most one per action */
+	TArray<FSnakeInputLatencySample> Pending;
+
+	/** Totals for each action since they were last logged */
+	TMap<FName, FSnakeInputLatencyTotals> Totals;
+
+	/** Frames handed over to be presented since the last tick, as game frame number and time. Written on the render thread. */
+	TArray<TPair<uint32, double>> PresentedFrames;
+	FCriticalSection PresentedFramesLock;
+
+	/** Slate preprocessor that notes when input arrives */
+	TSharedPtr<FSnakeInputLatencyProcessor> InputProcessor;
+
+	FDelegateHandle BackBufferHandle;
+
+	/** When Slate last received a key or button press, and axis input, and when this subsystem last ticked */
+	double LastButtonInputTime;
+	double LastAxisInputTime;
+	double LastTickTime;
+
+	/** Whether presented frames can be seen. Without a renderer samples finish at their effect. */
+	bool bCanSeePresent;
+};
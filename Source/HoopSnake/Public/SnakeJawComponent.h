@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "SnakeJawComponent.generated.h"
+
+class UAnimInstance;
+
+/**
+ * One half of the snake's head, as a single instance ISM. The upper and lower jaws are different meshes, so each has its own.
+ * Opening and closing the jaw moves the instance instead of rotating the component, and only when the angle changes,
+ * so the attachment to the head socket never has its relative transform dirtied.
+ * The angle comes from an animation curve when the snake's anim blueprint provides one, otherwise from gameplay.
+ */
+UCLASS(ClassGroup = Rendering, meta = (BlueprintSpawnableComponent))
+class HOOPSNAKE_API USnakeJawComponent : public UInstancedStaticMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	USnakeJawComponent(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	virtual void OnRegister() override;
+
+	/** Set the angle gameplay wants the jaw open at. Used whenever the animation isn't driving the jaw. */
+	UFUNCTION(BlueprintCallable, Category = Jaw)
+	void SetJawOpenAngle(float Angle);
+
+	/** Read the jaw curve from the animation, if it has one, and move the jaw instance if the angle changed */
+	void UpdateJaw(const UAnimInstance* AnimInstance);
+
+	/** Returns the angle the jaw is currently posed at */
+	float GetAppliedOpenAngle() const { return AppliedOpenAngle; }
+
+	/** Name of the animation curve that opens the jaw. 0 is closed, 1 is fully open. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Jaw)
+	FName JawOpenCurveName;
+
+	/** Jaw angle when the animation curve is at 1 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Jaw)
+	float MaxOpenAngle;
+
+	/** Whether this is the lower jaw, which pitches down as it opens. The upper jaw pitches up. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Jaw)
+	bool bLowerJaw;
+
+protected:
+	/** Make sure there is exactly one instance, posed at the current angle */
+	void EnsureJawInstance();
+
+	/** Move the instance to the given jaw angle */
+	void ApplyJawAngle(float Angle);
+
+	/** Angle requested by gameplay */
+	float GameplayOpenAngle;
+
+	/** Angle the instance is currently posed at */
+	float AppliedOpenAngle;
+};
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "SnakeKillcamActor.generated.h"
+
+class UCameraComponent;
+class UPoseableMeshComponent;
+class USnakeJawComponent;
+class USnakeKillcamRecorder;
+
+/**
+ * Plays a killcam recording back. Each recorded track gets a poseable mesh posed straight from the recorder's snapshots,
+ * with no animation or physics of its own, and the snake's ghost gets a copy of its jaw. The camera trails the snake.
+ */
+UCLASS(NotPlaceable, Transient)
+class HOOPSNAKE_API ASnakeKillcamActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ASnakeKillcamActor();
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	/** Create a ghost mesh for each track and start playing from StartTime. JawTemplates are the live snake's jaws, copied onto its ghost.
+	 * The camera looks along ViewRotation's yaw, so the killcam is seen from roughly where the player was looking. */
+	void StartPlayback(USnakeKillcamRecorder* InRecorder, const TArray<const USnakeJawComponent*>& JawTemplates, double StartTime, double InEndTime, float InPlaybackRate, const FRotator& ViewRotation);
+
+	/** How far behind the snake the camera trails */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Killcam)
+	float CameraDistance;
+
+	/** How far above the snake the camera sits */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Killcam)
+	float CameraHeight;
+
+	/** How quickly the camera catches up with the snake */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Killcam)
+	float CameraInterpSpeed;
+
+protected:
+	/** Write a component space pose into a ghost mesh */
+	void ApplyPose(UPoseableMeshComponent* Mesh, const TArray<FTransform>& ComponentSpacePose);
+
+	/** Move the camera towards its spot behind the snake's ghost, looking at it */
+	void UpdateCamera(const FVector& TargetLocation, float DeltaSeconds, bool bSnap);
+
+	/** Camera the player views the killcam through */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Killcam)
+	UCameraComponent* Camera;
+
+	/** Ghost mesh for each recorded track, null for tracks with nothing recorded */
+	UPROPERTY(Transient)
+	TArray<UPoseableMeshComponent*> Ghosts;
+
+	/** Jaws on the snake's ghost */
+	UPROPERTY(Transient)
+	TArray<USnakeJawComponent*> GhostJaws;
+
+	/** Recorder being played back */
+	UPROPERTY(Transient)
+	USnakeKillcamRecorder* Recorder;
+
+	/** Recorded time being shown, when playback ends, and how fast it plays */
+	double PlaybackTime;
+	double EndTime;
+	float PlaybackRate;
+
+	/** Flat direction from the snake's ghost to the camera */
+	FVector CameraDirection;
+
+	/** Whether the camera has been placed yet */
+	bool bCameraPlaced;
+
+	/** Pose buffer reused between tracks and frames */
+	TArray<FTransform> PoseScratch;
+};
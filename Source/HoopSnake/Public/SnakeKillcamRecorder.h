@@ -0,0 +1,190 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SnakeKillcamRecorder.generated.h"
+
+class AHoopSnakeCharacter;
+class ASnakeKillcamActor;
+class USkeletalMeshComponent;
+class USkinnedAsset;
+class USceneComponent;
+
+/** One bone's component space transform, quantized. Location in steps of KillcamLocationStep, rotation as the xyz of a quaternion with a positive w. */
+struct FKillcamBone
+{
+	int16 Location[3];
+	int16 Rotation[3];
+};
+
+/** Where a recorded mesh was on one frame */
+struct FKillcamTrackFrame
+{
+	FVector3f Location = FVector3f::ZeroVector;
+	FQuat4f Rotation = FQuat4f::Identity;
+	float JawAngle = 0.0f;
+	bool bRecorded = false;
+};
+
+/** Recorded history of one skeletal mesh. Buffers are allocated once for the full ring and reused when the track changes mesh. */
+struct FKillcamTrack
+{
+	/** Mesh being recorded */
+	TWeakObjectPtr<USkeletalMeshComponent> Source;
+
+	/** Asset to play the track back with */
+	TWeakObjectPtr<USkinnedAsset> Asset;
+
+	/** Component scale, fixed for the life of the track */
+	FVector Scale = FVector::OneVector;
+
+	/** Number of bones recorded per frame, capped to the recorder's bones per track */
+	int32 NumBones = 0;
+
+	/** One entry per ring buffer frame */
+	TArray<FKillcamTrackFrame> Frames;
+
+	/** Bones for every ring buffer frame, MaxBonesPerTrack per frame */
+	TArray<FKillcamBone> Bones;
+};
+
+/**
+ * Keeps the last few seconds of the player's snake and the victims nearest to it in a fixed size ring buffer,
+ * so a bite can be watched back as a killcam. Snapshots are taken at a reduced rate from the pose the meshes
+ * already have, with bones quantized to 12 bytes each. Playback poses ghost meshes in a killcam actor.
+ */
+UCLASS(Config = Game)
+class HOOPSNAKE_API USnakeKillcamRecorder : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	USnakeKillcamRecorder();
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Play back what has been recorded so far from the player's point of view. Recording pauses until playback ends. */
+	void PlayKillcam();
+
+	/** End playback, returning the player's view to their snake. A killcam waiting to play after a bite is cancelled too. */
+	void StopKillcam();
+
+	/** Returns whether a killcam is playing */
+	bool IsPlaying() const { return KillcamActor != nullptr; }
+
+	/** Returns the number of tracks, whether or not they are recording anything */
+	int32 GetNumTracks() const { return Tracks.Num(); }
+
+	/** Returns the asset a track should be played back with, or null if the track has nothing recorded */
+	USkinnedAsset* GetTrackAsset(int32 TrackIndex) const;
+
+	/** Pose a track at the given time, blending between the snapshots either side. Returns false if the track wasn't recording at that time. */
+	bool SampleTrack(int32 TrackIndex, double Time, FTransform& OutComponentTransform, TArray<FTransform>& OutBones, float& OutJawAngle) const;
+
+	/** Returns the times of the oldest and newest recorded frames */
+	double GetOldestFrameTime() const;
+	double GetNewestFrameTime() const;
+
+	/** Returns the memory the ring buffer holds, in bytes. Fixed once recording starts. */
+	SIZE_T GetBufferBytes() const;
+
+protected:
+	/** Take a snapshot of the snake and nearby victims */
+	void RecordSnapshot();
+
+	/** Point the first track at the player's snake, and listen for its bites */
+	AHoopSnakeCharacter* UpdateRecordedSnake();
+
+	/** Keep tracking victims still in range and give free tracks to the nearest untracked ones */
+	void UpdateVictimTracks(const AHoopSnakeCharacter* Snake);
+
+	/** Start recording a mesh on a track, dropping whatever the track had */
+	void AssignTrack(FKillcamTrack& Track, USkeletalMeshComponent* Mesh);
+
+	/** Write one frame of a track */
+	void RecordTrack(FKillcamTrack& Track, int32 Frame, float JawAngle);
+
+	/** Forget everything recorded */
+	void ClearBuffer();
+
+	/** Hide or show the live meshes being recorded, so the killcam's ghosts don't overlap them */
+	void HideSources(bool bHide);
+
+	/** Returns the ring buffer index of the Nth oldest frame */
+	int32 GetFrameIndex(int32 Age) const { return (NextFrame - NumFrames + Age + MaxFrames) % MaxFrames; }
+
+	/** Plays the killcam shortly after the recorded snake bites, so the bite itself is in the clip */
+	void OnSnakeBite(AHoopSnakeCharacter* Snake, AActor* Victim);
+
+	/** Whether the player's snake is recorded at all */
+	UPROPERTY(Config)
+	bool bRecordKillcam;
+
+	/** Whether a bite by the player's snake plays the killcam. The player can skip it with their reset input. */
+	UPROPERTY(Config)
+	bool bPlayKillcamOnBite;
+
+	/** Seconds of history kept */
+	UPROPERTY(Config)
+	float RecordSeconds;
+
+	/** Snapshots taken per second */
+	UPROPERTY(Config)
+	float SnapshotRate;
+
+	/** Victims recorded alongside the snake */
+	UPROPERTY(Config)
+	int32 MaxRecordedVictims;
+
+	/** Victims further than this from the snake aren't recorded */
+	UPROPERTY(Config)
+	float VictimRecordRadius;
+
+	/** Bones recorded per mesh. Meshes with more only have their first bones recorded, the rest stay in the reference pose on playback. */
+	UPROPERTY(Config)
+	int32 MaxBonesPerTrack;
+
+	/** Seconds to keep recording after a bite before the killcam plays */
+	UPROPERTY(Config)
+	float PostBiteSeconds;
+
+	/** Playback speed of the killcam, below 1 for slow motion */
+	UPROPERTY(Config)
+	float PlaybackRate;
+
+	/** Recorded meshes. The first is the snake. */
+	TArray<FKillcamTrack> Tracks;
+
+	/** World time of each ring buffer frame */
+	TArray<double> FrameTimes;
+
+	/** Ring buffer size, the frame that will be written next, and how many frames hold data */
+	int32 MaxFrames;
+	int32 NextFrame;
+	int32 NumFrames;
+
+	/** Time until the next snapshot */
+	float TimeUntilSnapshot;
+
+	/** Snake being recorded, and its bite binding */
+	TWeakObjectPtr<AHoopSnakeCharacter> RecordedSnake;
+	FDelegateHandle BiteHandle;
+
+	/** Timer for playing the killcam after a bite */
+	FTimerHandle KillcamTimerHandle;
+
+	/** Actor playing the killcam back */
+	UPROPERTY(Transient)
+	ASnakeKillcamActor* KillcamActor;
+
+	/** Live components hidden while the killcam plays */
+	TArray<TWeakObjectPtr<USceneComponent>> HiddenComponents;
+
+	/** Assets already warned about having more bones than a track records, so the warning isn't repeated every time a victim is picked up */
+	TSet<TWeakObjectPtr<USkinnedAsset>> TruncatedAssets;
+};
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "SnakeMeshComponent.generated.h"
+
+class UPhysicsAsset;
+
+/**
+ * Skeletal mesh for the snake with a physics LOD. Snakes nobody is looking at closely ragdoll with a reduced chain:
+ * only every Nth body of the rope is simulated, each carrying the capsules of the bodies it replaced, and the bones
+ * in between are posed by interpolating between the simulated ones. The head body is left as it is, so biting and lunging don't change.
+ */
+UCLASS(ClassGroup = Rendering, meta = (BlueprintSpawnableComponent))
+class HOOPSNAKE_API USnakeMeshComponent : public USkeletalMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	USnakeMeshComponent(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	/** Switch between the reduced and full physics chains depending on how close the nearest player's camera is.
+	 * Hero snakes always get the full chain. Only switches while not simulating, the ragdoll isn't rebuilt mid-flight. */
+	void UpdatePhysicsLOD(bool bIsHero, float DeltaTime);
+
+	/** Swap to the reduced chain, or back to the full one */
+	UFUNCTION(BlueprintCallable, Category = PhysicsLOD)
+	void SetReducedPhysics(bool bReduced);
+
+	/** Returns whether the reduced chain is in use */
+	UFUNCTION(BlueprintCallable, Category = PhysicsLOD)
+	bool IsPhysicsReduced() const { return bPhysicsReduced; }
+
+	/** Returns how much to scale impulses spread over every body, so the total matches the full chain */
+	float GetBodyImpulseScale() const;
+
+	/** Whether this snake is allowed to use the reduced chain at all */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = PhysicsLOD)
+	bool bAllowReducedPhysics;
+
+	/** Keep one body out of this many along the rope */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = PhysicsLOD, meta = (ClampMin = "2"))
+	int32 ReducedBodyStride;
+
+	/** Snakes closer than this to a player's camera keep the full chain */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = PhysicsLOD)
+	float FullFidelityDistance;
+
+	/** How often the camera distance is checked */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = PhysicsLOD)
+	float PhysicsLODCheckInterval;
+
+	/** Body that is never merged into, or away. Set to the snake's head bone. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = PhysicsLOD)
+	FName PreservedBoneName;
+
+protected:
+	virtual void FinalizeBoneTransform() override;
+
+	/** Returns the reduced version of a physics asset, building it the first time it is asked for */
+	UPhysicsAsset* GetReducedPhysicsAsset(UPhysicsAsset* FullAsset) const;
+
+	/** Build a copy of the physics asset that keeps every Nth body, with the rest's shapes merged into the kept body above them in the chain */
+	UPhysicsAsset* BuildReducedPhysicsAsset(UPhysicsAsset* FullAsset) const;
+
+	/** Work out which bones sit between simulated bodies, and how to pose them from those bodies */
+	void BuildInterpolatedBones();
+
+	/** A bone without a body in the reduced chain, posed from the simulated bodies either side of it */
+	struct FInterpolatedBone
+	{
+		int32 BoneIndex;
+		int32 ParentKeyIndex;
+		int32 ChildKeyIndex;
+		float Alpha;
+		FTransform FromParentKey;
+		FTransform FromChildKey;
+	};
+
+	/** Bones posed by interpolation, in bone order */
+	TArray<FInterpolatedBone> InterpolatedBones;
+
+	/** Whether the reduced chain is in use */
+	bool bPhysicsReduced;
+
+	/** Physics asset to go back to when leaving the reduced chain */
+	UPROPERTY(Transient)
+	UPhysicsAsset* FullPhysicsAsset;
+
+	/** Number of bodies in the full chain */
+	int32 FullBodyCount;
+
+	/** Time until the next camera distance check */
+	float TimeUntilLODCheck;
+};
@@ -0,0 +1,39 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "SnakeMovementComponent.generated.h"
+
+/**
+ * Character movement for the snake. In hoop mode every walking substep first sweeps the capsule along the distance it is
+ * about to travel, so a wall or obstacle in the way is found on the step the snake reaches it rather than after the move
+ * has slid along it. The snake is moved up to the contact and ragdolled there, keeping the velocity it hit with.
+ */
+UCLASS()
+class HOOPSNAKE_API USnakeMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	USnakeMovementComponent(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	/** Whether hoop mode impacts are predicted at all */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = HoopImpact)
+	bool bPredictHoopImpacts;
+
+	/** How much bigger than the capsule the look-ahead sweep is, to cover the hoop mesh where it sticks out past the capsule */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = HoopImpact, meta = (ClampMin = "0.0"))
+	float HoopImpactInflation;
+
+	/** How head-on a hit has to be to end hoop mode, as the cosine of the angle between the velocity and the surface normal. Glancing hits slide as before. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = HoopImpact, meta = (ClampMin = "0.0", ClampMax = "1.0"))
+	float HoopImpactMinApproach;
+
+protected:
+	virtual void MoveAlongFloor(const FVector& InVelocity, float DeltaSeconds, FStepDownResult* OutStepDownResult = nullptr) override;
+
+	/** Sweep ahead over this substep's move. Returns true with the hit if the snake is about to run into something that should stop the hoop. */
+	bool PredictHoopImpact(const FVector& Delta, FHitResult& OutHit) const;
+};
@@ -0,0 +1,160 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Containers/Ticker.h"
+#include "SnakeObstacleSubsystem.generated.h"
+
+class AHoopSnakeCharacter;
+class UHierarchicalInstancedStaticMeshComponent;
+class UStaticMeshComponent;
+class ULevel;
+
+/** Broadcast when a snake runs into an obstacle instance */
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnObstacleInstanceHit, UHierarchicalInstancedStaticMeshComponent* /* Instances */, int32 /* InstanceIndex */, AHoopSnakeCharacter* /* Snake */);
+
+/** An obstacle actor that has been collapsed into instances, with enough kept to spawn it again */
+struct FSnakeCollapsedObstacle
+{
+	TSubclassOf<AActor> Class;
+	FTransform ActorTransform;
+
+	/** Level the actor came from, so its instances go when the level streams out */
+	TWeakObjectPtr<ULevel> Level;
+
+	/** Instance group and world transform of each of its meshes */
+	TArray<TPair<int32, FTransform>> Meshes;
+
+	/** Added by the benchmark, removed again when it finishes */
+	bool bBenchCopy = false;
+};
+
+/** Frame stats gathered over one benchmark run */
+struct FSnakeObstacleBenchRun
+{
+	int32 Frames = 0;
+	double FrameMilliseconds = 0.0;
+	int64 DrawCalls = 0;
+	int64 Primitives = 0;
+	int32 Actors = 0;
+	int32 TickingObstacles = 0;
+};
+
+/**
+ * Replaces obstacle actors with hierarchical instanced static meshes, one component per mesh and material set.
+ * Every instance keeps its own collision body, and a snake in hoop mode running into any of them is ragdolled,
+ * the same as the obstacle blueprint's hit event did. Obstacles in streamed levels are collapsed as they load.
+ */
+UCLASS(Config = Game)
+class HOOPSNAKE_API USnakeObstacleSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	USnakeObstacleSubsystem();
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	/** Compare obstacles as actors against instances with the obstacle count multiplied, logging draw calls, actor count, ticking obstacles and frame time */
+	void RunBenchmark(int32 Multiplier, int32 FramesPerRun);
+
+	/** Returns the number of obstacles collapsed into instances */
+	int32 GetNumObstacles() const { return Obstacles.Num(); }
+
+	/** Called when a snake runs into an obstacle instance, after hoop mode has been handled */
+	FOnObstacleInstanceHit OnObstacleInstanceHit;
+
+protected:
+	/** Returns whether an actor is an obstacle that can be collapsed. Only actors made of nothing but static meshes can be. */
+	bool IsCollapsibleObstacle(const AActor* Actor) const;
+
+	/** Collapse every obstacle in a level into instances */
+	void CollapseLevel(ULevel* Level);
+
+	/** Record an obstacle's meshes and destroy the actor. Instances aren't updated until AddObstacleInstances. */
+	void CollapseActor(AActor* Actor);
+
+	/** Returns the instance group for a mesh component's mesh, materials, collision and visibility, making it if needed.
+	 * Hidden meshes go in groups that are never drawn, so collision-only meshes keep their collision. */
+	int32 FindOrAddGroup(const UStaticMeshComponent* MeshComponent, bool bVisible);
+
+	/** Returns a key covering every collision setting copied onto an instance group */
+	static FString GetCollisionKey(const UStaticMeshComponent* MeshComponent);
+
+	/** Add instances for every recorded obstacle from FirstObstacle on */
+	void AddObstacleInstances(int32 FirstObstacle);
+
+	/** Remove a level's obstacles and only their instances. A null level removes everything. */
+	void RemoveLevelObstacles(ULevel* Level);
+
+	/** Clear every instance group and add the recorded obstacles back */
+	void RebuildInstances();
+
+	/** Spawn every recorded obstacle back as an actor and clear the instances */
+	void ExpandObstacles();
+
+	/** Collapse obstacles when a streamed level arrives, and drop their instances when it leaves */
+	void OnLevelAdded(ULevel* Level, UWorld* InWorld);
+	void OnLevelRemoved(ULevel* Level, UWorld* InWorld);
+
+	/** Ragdoll snakes that run into an instance in hoop mode */
+	UFUNCTION()
+	void OnObstacleHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
+
+	/** Benchmark frame sampling */
+	bool TickBenchmark(float DeltaTime);
+	void StopBenchmark();
+
+	/** Whether obstacles are collapsed at all */
+	UPROPERTY(Config)
+	bool bCollapseObstacles;
+
+	/** Obstacle classes to collapse */
+	UPROPERTY(Config)
+	TArray<FSoftClassPath> ObstacleClasses;
+
+	/** Actors with this tag are collapsed too */
+	UPROPERTY(Config)
+	FName ObstacleTag;
+
+	/** How far benchmark copies are scattered from the obstacle they copy */
+	UPROPERTY(Config)
+	float BenchSpreadRadius;
+
+	/** Obstacle classes, loaded when play starts */
+	UPROPERTY(Transient)
+	TArray<UClass*> LoadedObstacleClasses;
+
+	/** Actor owning the instance components */
+	UPROPERTY(Transient)
+	AActor* InstanceOwner;
+
+	/** One component per distinct mesh, materials and collision */
+	UPROPERTY(Transient)
+	TArray<UHierarchicalInstancedStaticMeshComponent*> Groups;
+
+	/** Group index by mesh, materials and collision setup */
+	TMap<FString, int32> GroupKeys;
+
+	/** For each group, the obstacle each instance belongs to, kept in step with the component's instance order */
+	TArray<TArray<int32>> InstanceObstacles;
+
+	/** Every collapsed obstacle */
+	TArray<FSnakeCollapsedObstacle> Obstacles;
+
+	/** Actors spawned back by the benchmark's actor run */
+	TArray<TWeakObjectPtr<AActor>> ExpandedActors;
+
+	/** Benchmark state. The actor run comes first, then the instanced run. */
+	FTSTicker::FDelegateHandle BenchHandle;
+	int32 BenchFramesPerRun;
+	int32 BenchRun;
+	double BenchSettleTime;
+	FSnakeObstacleBenchRun BenchResults[2];
+
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+};
@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "SnakeOcclusionSubsystem.generated.h"
+
+class AHoopSnakeCharacter;
+class UPrimitiveComponent;
+
+/** An occluder being faded out, or back in */
+struct FSnakeOccluderFade
+{
+	/** Components whose custom primitive data carries the opacity */
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> Components;
+
+	/** Current opacity, and the last value written to the components */
+	float Opacity = 1.0f;
+	float AppliedOpacity = 1.0f;
+
+	/** Whether the latest sweep found it between a camera and its snake */
+	bool bOccluding = false;
+};
+
+/**
+ * Fades level geometry that comes between a player's camera and their snake's head. One async sweep per local
+ * player is issued each frame and read back the next, and occluders are faded through a custom primitive data
+ * float that their material reads, so no dynamic material instances are made.
+ */
+UCLASS(Config = Game)
+class HOOPSNAKE_API USnakeOcclusionSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	USnakeOcclusionSubsystem();
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+	/** Log the sweeps issued, occluders faded and dynamic material instances found on faded occluders */
+	void LogStats() const;
+
+protected:
+	/** Load OccluderClass the first time it is needed */
+	void ResolveOccluderClass();
+
+	/** Write full opacity to every primitive on an occluder */
+	void InitOccluderOpacity(AActor* Actor) const;
+
+	/** Returns whether an actor hit by the sweep should be faded */
+	bool IsOccluder(const AActor* Actor) const;
+
+	/** Read the results of last frame's sweeps */
+	void CollectSweeps();
+
+	/** Start this frame's sweep from a player's camera to their snake's head */
+	void IssueSweep(const AHoopSnakeCharacter* Snake);
+
+	/** Move each occluder's opacity towards its target and write it to the components if it changed */
+	void UpdateFades(float DeltaTime);
+
+	/** Whether occluders are faded at all. Off until the level's occluders are tagged and use a material that reads the opacity. */
+	UPROPERTY(Config)
+	bool bFadeOccluders;
+
+	/** Actors with this tag are faded */
+	UPROPERTY(Config)
+	FName OccluderTag;
+
+	/** Actors of this class are faded too. Optional, tagging actors is enough. */
+	UPROPERTY(Config)
+	FSoftClassPath OccluderClass;
+
+	/** Custom primitive data index the occluder material reads its opacity from */
+	UPROPERTY(Config)
+	int32 OpacityDataIndex;
+
+	/** Opacity of an occluder while it is in the way */
+	UPROPERTY(Config)
+	float OccludedOpacity;
+
+	/** How fast opacity changes, in full fades per second */
+	UPROPERTY(Config)
+	float FadeSpeed;
+
+	/** Radius of the swept sphere. A little more than the camera boom's probe, so occluders fade before the boom has to pull in. */
+	UPROPERTY(Config)
+	float SweepRadius;
+
+	/** Occluder class, loaded when first needed */
+	UPROPERTY(Transient)
+	UClass* LoadedOccluderClass;
+
+	/** Whether loading the occluder class has been tried, so a bad path is only tried and reported once */
+	bool bOccluderClassResolved;
+
+	/** Sweeps issued this frame, read back next frame */
+	TArray<FTraceHandle> PendingSweeps;
+
+	/** Occluders being faded */
+	TMap<TWeakObjectPtr<AActor>, FSnakeOccluderFade> Fades;
+
+	/** Total sweeps issued, for stats */
+	int32 NumSweeps;
+};
@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SnakePhysicsLODSubsystem.generated.h"
+
+class UPhysicsAsset;
+
+/**
+ * Keeps the reduced physics assets built by snake meshes for their physics LOD, so every snake in the world using the same
+ * full asset and stride shares one. Per world, so PIE sessions and reloaded maps don't hand each other their assets.
+ */
+UCLASS()
+class HOOPSNAKE_API USnakePhysicsLODSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Returns the reduced version of a physics asset already built for this stride, or null if there isn't one */
+	UPhysicsAsset* FindReducedAsset(UPhysicsAsset* FullAsset, int32 Stride) const;
+
+	/** Remember a reduced physics asset for the snakes that ask for it after this one */
+	void AddReducedAsset(UPhysicsAsset* FullAsset, int32 Stride, UPhysicsAsset* ReducedAsset);
+
+protected:
+	/** Drop entries whose full or reduced asset has been garbage collected */
+	void PruneStaleAssets();
+
+	/** Reduced assets by full asset and stride. Weak, so they go away once no snake uses them. */
+	TMap<TPair<TWeakObjectPtr<UPhysicsAsset>, int32>, TWeakObjectPtr<UPhysicsAsset>> ReducedAssets;
+};
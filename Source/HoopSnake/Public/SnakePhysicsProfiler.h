@@ -0,0 +1,160 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/EngineTypes.h"
+#include "HAL/IConsoleManager.h"
+#include "SnakePhysicsProfiler.generated.h"
+
+class AHoopSnakeCharacter;
+class UPhysicsAsset;
+class UPrimitiveComponent;
+
+/** A console variable set while a physics preset is being profiled */
+USTRUCT()
+struct FSnakePhysicsConsoleVariable
+{
+	GENERATED_BODY()
+
+	/** Name of the console variable */
+	UPROPERTY(Config)
+	FString Name;
+
+	/** Value used while the preset is active */
+	UPROPERTY(Config)
+	FString Value;
+};
+
+/** A set of physics tuning changes applied to every snake, so it can be profiled against the others */
+USTRUCT()
+struct FSnakePhysicsPreset
+{
+	GENERATED_BODY()
+
+	/** Name used for the preset's CSV file and in the summary */
+	UPROPERTY(Config)
+	FName Name;
+
+	/** Solver settings, such as iteration counts, to override while the preset is active */
+	UPROPERTY(Config)
+	TArray<FSnakePhysicsConsoleVariable> ConsoleVariables;
+
+	/** Physics asset to swap the snake onto, usually one with fewer bodies. Left empty to keep the snake's own. */
+	UPROPERTY(Config)
+	FSoftObjectPath PhysicsAsset;
+
+	/** Channels every body but the head stops responding to, cutting down the collision pairs the rope generates */
+	UPROPERTY(Config)
+	TArray<TEnumAsByte<ECollisionChannel>> IgnoredChannels;
+};
+
+/** Solver stats for one snake, and whatever it is biting, over one frame */
+struct FSnakePhysicsSample
+{
+	uint64 Frame = 0;
+	float DeltaMilliseconds = 0.0f;
+	FString SnakeName;
+	int32 IslandBodies = 0;
+	int32 SimulatedBodies = 0;
+	int32 AwakeBodies = 0;
+	int32 Constraints = 0;
+	int32 BiteConstraints = 0;
+	int32 HitEvents = 0;
+	int32 PositionIterations = 0;
+	int32 VelocityIterations = 0;
+	int32 ProjectionIterations = 0;
+};
+
+/**
+ * Debug mode that records per frame physics stats for each snake and the victims its bite constraint holds, then writes them to CSV.
+ * Runs each configured preset in turn so their costs can be compared head to head. Numbers come from the game thread's view of the bodies:
+ * an island is the snake plus anything constrained to it, and hit events are the collisions reported to the snake's mesh.
+ */
+UCLASS(Config = Game)
+class HOOPSNAKE_API USnakePhysicsProfiler : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	USnakePhysicsProfiler();
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+	/** Profile one preset by name, or every preset in turn when no name is given. Each preset is recorded for the given number of seconds. */
+	void StartProfiling(FName PresetName, float InSecondsPerPreset);
+
+	/** Stop profiling, writing out whatever has been recorded and restoring the snakes' physics */
+	void StopProfiling();
+
+	/** Returns whether a profile is running */
+	bool IsProfiling() const { return ActivePresetIndex != INDEX_NONE; }
+
+protected:
+	/** A snake the active preset has been applied to, and the physics settings it had before the preset */
+	struct FProfiledSnake
+	{
+		TWeakObjectPtr<AHoopSnakeCharacter> Snake;
+		TWeakObjectPtr<UPhysicsAsset> OriginalPhysicsAsset;
+		bool bOriginalNotifyRigidBodyCollision;
+	};
+
+	/** Apply a preset to the snakes and start recording it */
+	void BeginPreset(int32 PresetIndex);
+
+	/** Write the preset's samples to CSV, add it to the summary and put the snakes' physics back */
+	void EndPreset();
+
+	/** Write one line per finished preset to the summary CSV */
+	void WriteSummary();
+
+	/** Apply or remove the active preset's changes on one snake */
+	void ApplyPresetToSnake(AHoopSnakeCharacter* Snake, const FSnakePhysicsPreset& Preset);
+	void RestoreSnake(const FProfiledSnake& Profiled);
+
+	/** Record a sample for one snake */
+	void SampleSnake(AHoopSnakeCharacter* Snake, float DeltaTime);
+
+	/** Counts collisions reported to snake meshes */
+	UFUNCTION()
+	void OnSnakeMeshHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
+
+	/** Presets to compare */
+	UPROPERTY(Config)
+	TArray<FSnakePhysicsPreset> Presets;
+
+	/** Presets queued for the running profile, as indices into Presets */
+	TArray<int32> PresetQueue;
+
+	/** Index of the preset being recorded, INDEX_NONE when not profiling */
+	int32 ActivePresetIndex;
+
+	/** How long each preset is recorded for, and how long the active one has been recorded */
+	float SecondsPerPreset;
+	float PresetElapsed;
+
+	/** Samples recorded for the active preset */
+	TArray<FSnakePhysicsSample> Samples;
+
+	/** One line per finished preset, written out when the profile ends */
+	TArray<FString> SummaryLines;
+
+	/** A console variable's value before the active preset changed it, and the priority it had been set at */
+	struct FSavedConsoleVariable
+	{
+		FString Value;
+		EConsoleVariableFlags SetBy;
+	};
+
+	/** Console variable values from before the active preset changed them */
+	TMap<FString, FSavedConsoleVariable> SavedCVarValues;
+
+	/** Snakes the active preset has been applied to. Held weakly, a snake can be destroyed partway through a preset. */
+	TArray<FProfiledSnake> ProfiledSnakes;
+
+	/** Collisions reported to each snake's mesh since its last sample */
+	TMap<TWeakObjectPtr<UPrimitiveComponent>, int32> HitEventCounts;
+};
@@ -0,0 +1,196 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "HAL/IConsoleManager.h"
+#include "SnakeScalabilitySubsystem.generated.h"
+
+/** A console variable set by a feature downgrade */
+USTRUCT()
+struct FSnakeScalabilityConsoleVariable
+{
+	GENERATED_BODY()
+
+	/** Name of the console variable */
+	UPROPERTY(Config)
+	FString Name;
+
+	/** Value used while the downgrade is applied */
+	UPROPERTY(Config)
+	FString Value;
+};
+
+/** One step of rendering features turned down when lowering the resolution isn't enough */
+USTRUCT()
+struct FSnakeFeatureDowngrade
+{
+	GENERATED_BODY()
+
+	/** Name used in the log */
+	UPROPERTY(Config)
+	FName Name;
+
+	/** Console variables to change. Each should only appear in one step, so undoing a step puts back the original value. */
+	UPROPERTY(Config)
+	TArray<FSnakeScalabilityConsoleVariable> ConsoleVariables;
+};
+
+/** Tuning for the frame budget controller */
+struct FSnakeFrameBudgetSettings
+{
+	/** Frame time to stay under */
+	float TargetFrameMilliseconds = 1000.0f / 60.0f;
+
+	/** Quality is only raised again once frames are this fraction of the target or less */
+	float RaiseThreshold = 0.8f;
+
+	/** Lowest screen percentage the controller will go to, and how much it changes per step */
+	float MinScreenPercentage = 50.0f;
+	float ScreenPercentageStep = 10.0f;
+
+	/** Number of feature downgrade steps available once the resolution is at its lowest */
+	int32 MaxFeatureDowngrades = 0;
+
+	/** Consecutive frames over budget before lowering quality, and under the raise threshold before raising it */
+	int32 FramesToLower = 15;
+	int32 FramesToRaise = 90;
+
+	/** Frames to wait after a change before judging its effect */
+	int32 CooldownFrames = 30;
+
+	/** How much each new frame moves the smoothed frame time */
+	float SmoothingFactor = 0.1f;
+};
+
+/**
+ * Decides screen percentage and feature downgrades from frame times. Plain maths with no engine state,
+ * so it can be driven with synthetic frame times under -nullrhi. Lowers resolution first since it is the
+ * least noticeable, then steps features down. Raises features back first, then resolution.
+ */
+class HOOPSNAKE_API FSnakeFrameBudgetController
+{
+public:
+	/** Start over with full quality. MaxScreenPercentage is the resolution the controller works down from. */
+	void Reset(const FSnakeFrameBudgetSettings& InSettings, float InMaxScreenPercentage);
+
+	/** Add a frame time. Returns true if the screen percentage or feature downgrades changed. */
+	bool AddFrame(float FrameMilliseconds);
+
+	float GetScreenPercentage() const { return ScreenPercentage; }
+	int32 GetFeatureDowngrades() const { return FeatureDowngrades; }
+	float GetSmoothedFrameMilliseconds() const { return SmoothedFrameMilliseconds; }
+
+	/** Returns whether anything is below full quality */
+	bool IsDowngraded() const { return FeatureDowngrades > 0 || ScreenPercentage < MaxScreenPercentage; }
+
+private:
+	/** Step quality down or up. Return false if there is nothing left to change. */
+	bool Lower();
+	bool Raise();
+
+	FSnakeFrameBudgetSettings Settings;
+	float MaxScreenPercentage = 100.0f;
+	float ScreenPercentage = 100.0f;
+	int32 FeatureDowngrades = 0;
+	float SmoothedFrameMilliseconds = 0.0f;
+	int32 FramesOverBudget = 0;
+	int32 FramesUnderThreshold = 0;
+	int32 CooldownFramesLeft = 0;
+	bool bHasFrame = false;
+};
+
+/**
+ * Keeps the player's snake at its target frame rate in hoop mode, where the wide FOV raises the rendering cost.
+ * Frame times go through a frame budget controller, and its decisions are applied as screen percentage and
+ * configured feature downgrades. Everything goes back to the scalability settings when hoop mode ends.
+ * Console variables are changed at the priority they already have, so scalability and game settings still own them afterwards.
+ */
+UCLASS(Config = Game)
+class HOOPSNAKE_API USnakeScalabilitySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	USnakeScalabilitySubsystem();
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+	/** Run a separate controller over synthetic frame times that ramp from BaseMilliseconds up to PeakMilliseconds and back,
+	 * logging every decision. Nothing is applied to the renderer, so this works under -nullrhi.
+	 * Returns false, with an error logged, if the controller broke any of its rules along the way. */
+	bool RunSyntheticFrames(float BaseMilliseconds, float PeakMilliseconds, int32 NumFrames) const;
+
+protected:
+	/** Returns the controller tuning from config */
+	FSnakeFrameBudgetSettings MakeSettings() const;
+
+	/** Apply the controller's current screen percentage and feature downgrades */
+	void ApplyDecision();
+
+	/** Put every console variable the controller changed back, and stop adapting */
+	void RestoreAll();
+
+	/** Set a console variable, remembering its value from before the first change */
+	void SetConsoleVariable(const FString& Name, const FString& Value);
+
+	/** Put a console variable back to its value from before the first change */
+	void RestoreConsoleVariable(const FString& Name);
+
+	/** Whether frame times are adapted to in hoop mode at all */
+	UPROPERTY(Config)
+	bool bAdaptInHoopMode;
+
+	/** Frame rate to hold in hoop mode */
+	UPROPERTY(Config)
+	float TargetFrameRate;
+
+	/** Quality is only raised again once frames are this fraction of the target or less */
+	UPROPERTY(Config)
+	float RaiseThreshold;
+
+	/** Lowest screen percentage to go to, and how much it changes per step */
+	UPROPERTY(Config)
+	float MinScreenPercentage;
+
+	UPROPERTY(Config)
+	float ScreenPercentageStep;
+
+	/** Consecutive frames over budget before lowering quality, and under the raise threshold before raising it */
+	UPROPERTY(Config)
+	int32 FramesToLower;
+
+	UPROPERTY(Config)
+	int32 FramesToRaise;
+
+	/** Frames to wait after a change before judging its effect */
+	UPROPERTY(Config)
+	int32 CooldownFrames;
+
+	/** Feature steps taken in order once the screen percentage is at its lowest. Avoid anything that rebuilds caches or pipeline states
+	 * when it changes, such as virtual shadow maps or the reflection method, since hoop mode is entered and left all the time. */
+	UPROPERTY(Config)
+	TArray<FSnakeFeatureDowngrade> FeatureDowngrades;
+
+	/** Controller fed with real frame times while the player's snake is in hoop mode */
+	FSnakeFrameBudgetController Controller;
+
+	/** Whether the controller is running */
+	bool bAdapting;
+
+	/** Feature downgrade steps currently applied */
+	int32 AppliedFeatureDowngrades;
+
+	/** A console variable's value before the controller changed it, and the priority it had been set at */
+	struct FSavedConsoleVariable
+	{
+		FString Value;
+		EConsoleVariableFlags SetBy;
+	};
+
+	/** Console variable values from before the controller changed them */
+	TMap<FString, FSavedConsoleVariable> SavedCVarValues;
+};
@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SnakeSimulationSubsystem.generated.h"
+
+class AHoopSnakeCharacter;
+class USkeletalMeshComponent;
+
+/**
+ * Headless simulation for tuning and soak tests. Steps the world at a fixed timestep as fast as the CPU allows while AI snakes
+ * run their hoop, attack and bite cycles, then reports steps per second, bite success and physics stability.
+ * Meant to run under -nullrhi -nosound, started from the command line with -SnakeSim or with the SnakeSim console command.
+ * Snake properties can be overridden for the run, e.g. "AttackForceForward=1500,TiltModifier=2", so sweeps are one run per value.
+ */
+UCLASS(Config = Game)
+class HOOPSNAKE_API USnakeSimulationSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	USnakeSimulationSubsystem();
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+	/** Start simulating for the given number of simulated seconds, with snake property overrides applied to every snake */
+	void StartSimulation(float InSimSeconds, const FString& InOverrides, bool bInExitWhenDone);
+
+	/** Stop simulating, report the results and put the engine's timestep back */
+	void StopSimulation();
+
+	/** Returns whether a simulation is running */
+	bool IsSimulating() const { return bSimulating; }
+
+protected:
+	/** Bind to a snake seen for the first time and apply the run's overrides to it */
+	void TrackSnake(AHoopSnakeCharacter* Snake);
+
+	/** Apply "Name=Value" property overrides to a snake. Returns the number applied. */
+	int32 ApplyOverrides(AHoopSnakeCharacter* Snake) const;
+
+	/** Check every simulating body on a mesh for runaway speeds, invalid transforms and falling out of the world */
+	void SampleStability(const USkeletalMeshComponent* Mesh);
+
+	/** Counts bites */
+	void OnSnakeBite(AHoopSnakeCharacter* Snake, AActor* Victim);
+
+	/** Log the results and add a line to Saved/Profiling/SnakeSim.csv */
+	void Report() const;
+
+	/** Length of each simulated step, in seconds */
+	UPROPERTY(Config)
+	float FixedStepSeconds;
+
+	/** Bodies moving faster than this are counted as exploding, in cm/s */
+	UPROPERTY(Config)
+	float ExplosionSpeed;
+
+	/** How often progress is logged, in simulated seconds */
+	UPROPERTY(Config)
+	float ProgressInterval;
+
+	/** Whether a simulation is running */
+	bool bSimulating;
+
+	/** Whether to quit once the simulation finishes, for command line runs */
+	bool bExitWhenDone;
+
+	/** Simulated seconds to run for, and run so far */
+	float SimSeconds;
+	double SimElapsed;
+	double NextProgressTime;
+
+	/** Property overrides applied to every snake */
+	FString Overrides;
+
+	/** Wall clock time the run started */
+	double WallStartTime;
+
+	/** Engine timestep settings from before the run */
+	bool bSavedUseFixedTimeStep;
+	double SavedFixedDeltaTime;
+	bool bSavedBenchmarking;
+
+	/** Snakes being watched, and whether each was ragdolling last step */
+	TMap<TWeakObjectPtr<AHoopSnakeCharacter>, bool> Snakes;
+
+	/** Results */
+	int64 Steps;
+	int32 Ragdolls;
+	int32 Bites;
+	int64 BodySamples;
+	int64 ExplodingBodySamples;
+	int64 InvalidBodySamples;
+	int64 OutOfWorldBodySamples;
+	float MaxBodySpeed;
+	double TotalAwakeBodies;
+};
@@ -0,0 +1,158 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/EngineBaseTypes.h"
+#include "SnakeCameraBoomComponent.h"
+#include "SnakeTickSubsystem.generated.h"
+
+class AHoopSnakeCharacter;
+class AController;
+class USnakeTickSubsystem;
+
+/**
+ * Everything one snake's per frame update reads and writes. Gathered from the snake on the game thread,
+ * worked out by Compute without touching any UObject, then applied back to the snake on the game thread.
+ */
+struct FSnakeTickState
+{
+	AHoopSnakeCharacter* Snake = nullptr;
+	float DeltaTime = 0.0f;
+
+	/** Inputs */
+	bool bHoopModeEnabled = false;
+	bool bSimulatingPhysics = false;
+	bool bUpdateCamera = false;
+	FVector Forward = FVector::ForwardVector;
+	FVector PreviousForward = FVector::ForwardVector;
+	FVector Velocity = FVector::ZeroVector;
+	float Speed = 0.0f;
+	float HoopSpeed = 0.0f;
+	float TiltModifier = 0.0f;
+	float TiltInterpSpeed = 0.0f;
+	float CameraInterpSpeed = 0.0f;
+	float CameraTolerance = 0.0f;
+	float SpeedLineSignificance = 0.0f;
+	FSnakeCameraTargets CameraTargets;
+
+	/** Read on the way in and updated by Compute */
+	float DesiredTilt = 0.0f;
+	float CurrentTilt = 0.0f;
+	FSnakeCameraState CameraState;
+
+	/** Outputs */
+	float RotateRate = 0.0f;
+	bool bIsRotating = false;
+	bool bReverseSlither = false;
+	float NoiseVolume = 0.0f;
+	bool bMakeNoise = false;
+	float SpeedLineIntensity = 0.0f;
+
+	/** Work out tilt, turn rate, animation flags, noise, speed lines and camera values from the inputs. Safe to run off the game thread. */
+	void Compute();
+};
+
+/** Tick function that runs every registered snake's update in one go */
+USTRUCT()
+struct FSnakeBatchTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	/** Subsystem that owns the snakes */
+	USnakeTickSubsystem* Target = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FSnakeBatchTickFunction> : public TStructOpsTypeTraitsBase2<FSnakeBatchTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+/**
+ * Updates every snake in one pass instead of one actor tick each. Snake state is gathered into a contiguous array,
+ * the maths runs across it in a ParallelFor, and the results are written back to the components on the game thread.
+ * The batch ticks in the same group as the snakes would have, ahead of their movement and mesh components.
+ * Toggled with hoopsnake.BatchedTick, snakes go back to ticking themselves when it is off.
+ */
+UCLASS()
+class HOOPSNAKE_API USnakeTickSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	USnakeTickSubsystem();
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	/** Add a snake to the batch. Snakes with a blueprint tick are left to tick themselves. */
+	void RegisterSnake(AHoopSnakeCharacter* Snake);
+
+	/** Remove a snake from the batch, handing its tick back to it */
+	void UnregisterSnake(AHoopSnakeCharacter* Snake);
+
+	/** Move the batch's wait from a snake's old controller to its new one, so input and AI decisions made this frame are seen this frame */
+	void SetSnakeController(AHoopSnakeCharacter* Snake, AController* OldController, AController* NewController);
+
+	/** Update every batched snake. Called by the batch tick function. */
+	void TickSnakes(float DeltaTime);
+
+	/** Returns whether snakes are being updated in a batch */
+	bool IsBatching() const { return bBatching; }
+
+	/** Returns the number of snakes in the batch */
+	int32 GetNumSnakes() const { return Snakes.Num(); }
+
+	/** Returns how long the world's actor tick took last frame, in milliseconds. Covers every tick group, batched or not. */
+	double GetLastActorTickMilliseconds() const { return LastActorTickSeconds * 1000.0; }
+
+protected:
+	/** Switch every registered snake between the batch and its own actor tick */
+	void SetBatching(bool bEnable);
+
+	/** Returns whether a snake can be batched. Snakes with a blueprint tick keep their own actor tick, since it has to run alongside the update. */
+	bool CanBatchSnake(const AHoopSnakeCharacter* Snake) const;
+
+	/** Make a snake's components wait for the batch, so they see the same inputs they would after the snake's own tick */
+	void AddComponentPrerequisites(AHoopSnakeCharacter* Snake);
+	void RemoveComponentPrerequisites(AHoopSnakeCharacter* Snake);
+
+	/** Make the batch wait for a controller's tick, the same as a pawn does for its own controller. Counted, since a controller can possess more than one snake over time. */
+	void AddControllerPrerequisite(AController* InController);
+	void RemoveControllerPrerequisite(AController* InController);
+
+	/** Time the actor tick phase of each frame */
+	void OnWorldPreActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaTime);
+	void OnWorldPostActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaTime);
+
+	/** Snakes in the batch */
+	UPROPERTY(Transient)
+	TArray<AHoopSnakeCharacter*> Snakes;
+
+	/** Controllers the batch waits for, with the number of batched snakes each one possesses */
+	TMap<TWeakObjectPtr<AController>, int32> ControllerPrerequisites;
+
+	/** Per snake state for the current frame, reused between frames */
+	TArray<FSnakeTickState> States;
+
+	/** Tick function for the batch */
+	FSnakeBatchTickFunction BatchTickFunction;
+
+	/** Whether registered snakes are currently batched */
+	bool bBatching;
+
+	/** Time the actor tick phase started this frame, and how long it took last frame */
+	double ActorTickStartTime;
+	double LastActorTickSeconds;
+
+	FDelegateHandle PreActorTickHandle;
+	FDelegateHandle PostActorTickHandle;
+};
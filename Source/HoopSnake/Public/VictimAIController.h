@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AIController.h"
+#include "Perception/AIPerceptionTypes.h"
+#include "VictimAIController.generated.h"
+
+class AHoopSnakeCharacter;
+class UBehaviorTree;
+class UAISenseConfig_Hearing;
+class UVictimBehaviorTreeComponent;
+
+/** How aware a victim is of nearby snakes */
+UENUM(BlueprintType)
+enum class EVictimAlertState : uint8
+{
+	Calm,
+	Alert,
+	Panicked
+};
+
+/**
+ * Controller for victims. Hears snakes through AI perception, but finds out whether a snake is close by through the
+ * victim AI manager's shared query rather than sensing on its own. Its behavior tree only runs when the manager gives it a time slice.
+ */
+UCLASS()
+class HOOPSNAKE_API AVictimAIController : public AAIController
+{
+	GENERATED_BODY()
+
+public:
+	/** Sets default values for this controller's properties */
+	AVictimAIController(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	/** Called by the victim AI manager during this victim's time slice, with the closest snake in sensing range (or null) */
+	void UpdateSnakeAwareness(AHoopSnakeCharacter* NearestSnake, float DistanceToSnake, float PanicRadius);
+
+	/** Let the behavior tree run on its next tick */
+	void GrantTimeSlice();
+
+	/** Returns how aware this victim is of nearby snakes */
+	UFUNCTION(BlueprintCallable, Category = AI)
+	EVictimAlertState GetAlertState() const { return AlertState; }
+
+	/** Take the victim out of play while it waits in the game mode's pool, or put it back in.
+	 * Pooled victims are left out of the AI manager and proximity grid, and their behavior tree is paused. */
+	void SetPooled(bool bInPooled);
+
+	/** Returns whether the victim is waiting in the pool */
+	bool IsPooled() const { return bPooled; }
+
+	/** Forget any snakes the victim knows about and start its behavior tree again */
+	void ResetAwareness();
+
+	/** Returns where the victim was first possessed, used as its spawn point when there are no others */
+	const FTransform& GetHomeTransform() const { return HomeTransform; }
+
+	/** How long the victim's ragdoll has been at rest, tracked by the game mode's pool */
+	float RagdollSettledTime;
+
+protected:
+	virtual void OnPossess(APawn* InPawn) override;
+	virtual void OnUnPossess() override;
+
+	/** Remembers snakes that were heard, they make the victim alert for a while */
+	UFUNCTION()
+	void OnTargetPerceptionUpdated(AActor* Actor, FAIStimulus Stimulus);
+
+	/** Write the current snake and alert state to the blackboard */
+	void UpdateBlackboard(AHoopSnakeCharacter* Snake);
+
+	/** Hearing sense used to pick up snake movement noise */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = AI)
+	UAISenseConfig_Hearing* HearingConfig;
+
+	/** Time sliced behavior tree component */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = AI)
+	UVictimBehaviorTreeComponent* VictimBehavior;
+
+	/** Behavior tree run when a victim is possessed */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = AI)
+	UBehaviorTree* VictimBehaviorTree;
+
+	/** Blackboard key the snake the victim knows about is written to */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = AI)
+	FName SnakeKeyName;
+
+	/** Blackboard key the alert state is written to, as an enum */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = AI)
+	FName AlertStateKeyName;
+
+	/** How long a victim stays alert after hearing a snake */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = AI)
+	float AlertMemoryDuration;
+
+	/** Name of the victim pawn's alert widget component, which the HUD's alert overlay replaces. Other widget components are left alone. */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = AI)
+	FName AlertWidgetComponentName;
+
+	/** Widget class of the alert icon, for pawns whose alert widget component has a different name */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = AI)
+	FName AlertWidgetClassName;
+
+	/** Current alert state */
+	UPROPERTY(BlueprintReadOnly, Category = AI)
+	EVictimAlertState AlertState;
+
+	/** Whether the victim is waiting in the pool */
+	bool bPooled;
+
+	/** Transform of the pawn when it was first possessed */
+	FTransform HomeTransform;
+
+	/** Snake that was last heard, and when */
+	TWeakObjectPtr<AHoopSnakeCharacter> HeardSnake;
+	double LastHeardSnakeTime;
+};
@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "VictimAIManager.generated.h"
+
+class AVictimAIController;
+class AHoopSnakeCharacter;
+
+/**
+ * Spreads victim AI over frames. Each frame a fixed number of victims get their "is a snake nearby" answer from
+ * the shared proximity grid and a time slice for their behavior tree.
+ * Cost per frame depends on the slice size rather than the number of victims.
+ */
+UCLASS(Config = Game)
+class HOOPSNAKE_API UVictimAIManager : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UVictimAIManager();
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Add a victim to the time slicing rotation */
+	void RegisterVictim(AVictimAIController* Victim);
+
+	/** Remove a victim from the time slicing rotation */
+	void UnregisterVictim(AVictimAIController* Victim);
+
+	/** Returns the number of victims being managed */
+	int32 GetNumVictims() const { return Victims.Num(); }
+
+	/** Returns the managed victims */
+	const TArray<AVictimAIController*>& GetVictims() const { return Victims; }
+
+	/** Returns the average time the manager's own tick takes, in milliseconds */
+	double GetAverageTickMilliseconds() const { return AverageTickSeconds * 1000.0; }
+
+protected:
+	/** Number of victims updated each frame */
+	UPROPERTY(Config)
+	int32 VictimsPerFrame;
+
+	/** Distance at which a victim notices a snake */
+	UPROPERTY(Config)
+	float SnakeSenseRadius;
+
+	/** Distance at which a victim panics */
+	UPROPERTY(Config)
+	float PanicRadius;
+
+	/** Victims in the rotation */
+	UPROPERTY(Transient)
+	TArray<AVictimAIController*> Victims;
+
+	/** Index of the next victim to update */
+	int32 NextVictimIndex;
+
+	/** Smoothed cost of the manager's tick */
+	double AverageTickSeconds;
+};
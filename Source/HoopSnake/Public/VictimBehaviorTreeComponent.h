@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BehaviorTree/BehaviorTreeComponent.h"
+#include "VictimBehaviorTreeComponent.generated.h"
+
+/**
+ * Behavior tree component that only runs when the victim AI manager hands it a time slice.
+ * Ticks in between are skipped and their time is carried over to the next slice.
+ */
+UCLASS()
+class HOOPSNAKE_API UVictimBehaviorTreeComponent : public UBehaviorTreeComponent
+{
+	GENERATED_BODY()
+
+public:
+	UVictimBehaviorTreeComponent(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/** Let the next tick run the tree */
+	void GrantTimeSlice() { bHasTimeSlice = true; }
+
+	/** Whether ticks should wait for a time slice. When false the tree ticks normally. */
+	bool bTimeSliced;
+
+protected:
+	/** Whether the tree may run on its next tick */
+	bool bHasTimeSlice;
+
+	/** Time that has passed over skipped ticks */
+	float PendingDeltaTime;
+};